@@ -0,0 +1,12 @@
+# SPDX-License-Identifier: Unlicense
+
+# Tools for measuring QQtPatcher, not needed for building or using it.
+# qbpbench generates synthetic Qt trees, relocates them using a built QQtPatcher and reports the throughput.
+# kernelbench runs the rewriting and searching done by the patchers on in-memory input using QBENCHMARK.
+
+TEMPLATE = subdirs
+
+SUBDIRS = \
+        fakeqmake \
+        kernels \
+        qbpbench
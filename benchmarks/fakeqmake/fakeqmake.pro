@@ -0,0 +1,12 @@
+# SPDX-License-Identifier: Unlicense
+
+QT -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+TARGET = fakeqmake
+
+DEFINES += QT_DEPRECATED_WARNINGS QT_DISABLE_DEPRECATED_BEFORE=0x070000 QT_NO_CAST_FROM_ASCII
+
+SOURCES += \
+        main.cpp
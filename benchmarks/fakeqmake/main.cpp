@@ -0,0 +1,31 @@
+// SPDX-License-Identifier: Unlicense
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+
+#include <cstdio>
+
+// Stands for qmake in the trees generated by qbpbench, which copies it to bin/qmake and appends the qt_prfxpath= block to it.
+// "qmake -query" prints bin/qmake.query, which is written by qbpbench as well.
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    if (!QCoreApplication::arguments().contains(QStringLiteral("-query"))) {
+        ::fprintf(stderr, "This is a fake qmake made for benchmarking QQtPatcher, it only answers \"-query\".\n");
+        return 1;
+    }
+
+    QFile f(QCoreApplication::applicationDirPath() + QStringLiteral("/qmake.query"));
+    if (!f.open(QIODevice::ReadOnly)) {
+        ::fprintf(stderr, "Unable to open %s.\n", f.fileName().toLocal8Bit().constData());
+        return 1;
+    }
+
+    QByteArray content = f.readAll();
+    ::fwrite(content.constData(), 1, static_cast<size_t>(content.size()), stdout);
+    ::fflush(stdout);
+    return 0;
+}
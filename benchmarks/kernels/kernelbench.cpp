@@ -0,0 +1,251 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "argument.h"
+#include "patchcontext.h"
+#include "patchers/kernels.h"
+#include "patternmatcher.h"
+#include "textlines.h"
+#include <QtTest>
+
+// Runs the hot parts of patching on in-memory input, so that changes to the lexer, path matching and searching can be measured without the file system.
+// Run "kernelbench -help" for the QtTest options, e.g. "-iterations" or "-callgrind".
+
+namespace {
+
+const char oldPrefix[] = "/home/builder/build/Qt-5.12.12-static";
+const char oldPrefix4[] = "/home/builder/build/Qt-4.8.7";
+const char newPrefix[] = "/opt/Qt/5.12.12/gcc_64";
+
+PatchContext makeContext(const QString &crossMkspec, const QString &qtVersion, const QString &oldDir)
+{
+    ArgumentsAndSettings::setQtDir(QString::fromUtf8(newPrefix));
+    ArgumentsAndSettings::setNewDir(QString::fromUtf8(newPrefix));
+    ArgumentsAndSettings::setOldDir(oldDir);
+    ArgumentsAndSettings::setCrossMkspec(crossMkspec);
+    ArgumentsAndSettings::setHostMkspec(crossMkspec);
+    ArgumentsAndSettings::setQtVersion(qtVersion);
+    return PatchContext::fromSettings();
+}
+
+// about what a static QtQuick plugin links to: old lib dir entries, system libs and known Windows libs mixed
+QByteArray longLibs(const QByteArray &prefix, bool win32)
+{
+    QByteArray r = "-L" + prefix + "/lib";
+    for (int i = 0; i < 40; ++i) {
+        r += " " + prefix + "/lib/libQt5Module" + QByteArray::number(i) + ".a";
+        r += " -L" + prefix + "/plugins/platforms";
+        r += " -lqtfreetype -lqtlibpng -lz";
+        if (win32)
+            r += " C:/msys64/mingw64/x86_64-w64-mingw32/lib/libd3d11.a \"C:/Program Files/Windows Kits/10/Lib/dwrite.lib\"";
+        else
+            r += " /usr/lib/x86_64-linux-gnu/libfontconfig.so -lpthread";
+    }
+    return r;
+}
+
+QByteArray prlFile(const QByteArray &prefix, bool win32)
+{
+    return "QMAKE_PRL_BUILD_DIR = " + prefix + "/../qtdeclarative/src/quick\n"
+           "QMAKE_PRO_INPUT = quick.pro\n"
+           "QMAKE_PRL_TARGET = libQt5Quick.a\n"
+           "QMAKE_PRL_CONFIG = lex yacc depend_includepath testcase_targets import_plugins import_qpa_plugin qt_build_extra file_copies qmake_use qt warn_on release link_prl incremental optimize_full release static\n"
+           "QMAKE_PRL_LIBS = "
+        + longLibs(prefix, win32)
+        + "\n"
+          "QMAKE_PRL_VERSION = 5.12.12\n";
+}
+
+QByteArray pcFile(const QByteArray &prefix, bool qt4)
+{
+    QByteArray r = "prefix=" + prefix + "\n"
+                                        "exec_prefix=${prefix}\n"
+                                        "libdir=${prefix}/lib\n"
+                                        "includedir=${prefix}/include/QtGui\n"
+                                        "qt_config=lex yacc warn_on uic resources qt warn_on release incremental link_prl\n"
+                                        "moc_location=${prefix}/bin/moc\n"
+                                        "uic_location=${prefix}/bin/uic\n"
+                                        "rcc_location=${prefix}/bin/rcc\n"
+                                        "lupdate_location=${prefix}/bin/lupdate\n"
+                                        "lrelease_location=${prefix}/bin/lrelease\n"
+                                        "\n"
+                                        "Name: QtGui\n"
+                                        "Description: QtGui Library\n"
+                                        "Version: 5.12.12\n"
+                                        "Libs: -L${libdir} -lQtGui\n";
+    if (qt4)
+        r += "Libs.private: " + longLibs(prefix, false) + "\n"
+                                                          "Cflags: -DQT_SHARED -I"
+            + prefix + "/include -I" + prefix + "/include/QtGui\n";
+    else
+        r += "Libs.private: -lQt5Core -lpthread\n"
+             "Cflags: -I${includedir}/QtGui -I${includedir}\n";
+    return r + "Requires: QtCore\n";
+}
+
+QByteArray laFile(const QByteArray &prefix)
+{
+    return "# libQt5Gui.la - a libtool library file\n"
+           "dlname=''\n"
+           "library_names=''\n"
+           "old_library='libQt5Gui.a'\n"
+           "dependency_libs=' "
+        + longLibs(prefix, false)
+        + "'\n"
+          "current=5\n"
+          "installed=yes\n"
+          "libdir='"
+        + prefix + "/lib'\n";
+}
+
+}
+
+class KernelBench : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void prl_data();
+    void prl();
+    void pc_data();
+    void pc();
+    void la();
+    void tokenize();
+    void matchLibDir();
+    void binarySearch_data();
+    void binarySearch();
+};
+
+void KernelBench::prl_data()
+{
+    QTest::addColumn<QString>("crossMkspec");
+    QTest::addColumn<QString>("qtVersion");
+    QTest::addColumn<QByteArray>("content");
+
+    QTest::newRow("qt5 linux-g++") << QStringLiteral("linux-g++") << QStringLiteral("5.12.12") << prlFile(oldPrefix, false);
+    // also looks up the known Windows libs
+    QTest::newRow("qt5 win32-g++") << QStringLiteral("win32-g++") << QStringLiteral("5.12.12") << prlFile(oldPrefix, true);
+    QTest::newRow("qt4 linux-g++") << QStringLiteral("linux-g++") << QStringLiteral("4.8.7") << prlFile(oldPrefix4, false);
+}
+
+void KernelBench::prl()
+{
+    QFETCH(QString, crossMkspec);
+    QFETCH(QString, qtVersion);
+    QFETCH(QByteArray, content);
+
+    PatchContext context = makeContext(crossMkspec, qtVersion, QString::fromUtf8(qtVersion.startsWith(QLatin1Char('4')) ? oldPrefix4 : oldPrefix));
+    QVERIFY(PatcherKernels::patchPrl(context, content) != content);
+
+    QBENCHMARK {
+        PatcherKernels::patchPrl(context, content);
+    }
+}
+
+void KernelBench::pc_data()
+{
+    QTest::addColumn<QString>("crossMkspec");
+    QTest::addColumn<QString>("qtVersion");
+    QTest::addColumn<QByteArray>("content");
+
+    QTest::newRow("qt5 linux-g++") << QStringLiteral("linux-g++") << QStringLiteral("5.12.12") << pcFile(oldPrefix, false);
+    QTest::newRow("qt4 linux-g++") << QStringLiteral("linux-g++") << QStringLiteral("4.8.7") << pcFile(oldPrefix4, true);
+    QTest::newRow("qt4 win32-g++") << QStringLiteral("win32-g++") << QStringLiteral("4.8.7") << pcFile(oldPrefix4, true);
+}
+
+void KernelBench::pc()
+{
+    QFETCH(QString, crossMkspec);
+    QFETCH(QString, qtVersion);
+    QFETCH(QByteArray, content);
+
+    PatchContext context = makeContext(crossMkspec, qtVersion, QString::fromUtf8(qtVersion.startsWith(QLatin1Char('4')) ? oldPrefix4 : oldPrefix));
+    QString fileName = QStringLiteral("QtGui.pc");
+    QVERIFY(PatcherKernels::patchPc(context, fileName, content) != content);
+
+    QBENCHMARK {
+        PatcherKernels::patchPc(context, fileName, content);
+    }
+}
+
+void KernelBench::la()
+{
+    PatchContext context = makeContext(QStringLiteral("linux-g++"), QStringLiteral("5.12.12"), QString::fromUtf8(oldPrefix));
+    QByteArray content = laFile(oldPrefix);
+    QVERIFY(PatcherKernels::patchLa(context, content) != content);
+
+    QBENCHMARK {
+        PatcherKernels::patchLa(context, content);
+    }
+}
+
+void KernelBench::tokenize()
+{
+    QByteArray value = longLibs(oldPrefix, true);
+
+    QBENCHMARK {
+        TextLines::tokenize(value);
+    }
+}
+
+void KernelBench::matchLibDir()
+{
+    PatchContext context = makeContext(QStringLiteral("linux-g++"), QStringLiteral("5.12.12"), QString::fromUtf8(oldPrefix));
+    QVector<TextLines::ValueToken> tokens = TextLines::tokenize(longLibs(oldPrefix, false));
+    QStringList dirs;
+    foreach (const TextLines::ValueToken &token, tokens)
+        dirs << QFileInfo(TextLines::tokenPath(token, token.text.startsWith("-L") ? 2 : 0)).path();
+
+    QBENCHMARK {
+        int matched = 0;
+        foreach (const QString &dir, dirs) {
+            if (context.isOldLibDir(dir))
+                ++matched;
+        }
+        Q_UNUSED(matched);
+    }
+}
+
+void KernelBench::binarySearch_data()
+{
+    QTest::addColumn<QList<QByteArray>>("keys");
+    QTest::addColumn<int>("blocks");
+
+    // the keys of BinaryPatcher
+    QList<QByteArray> keys5 {"qt_epfxpath=", "qt_prfxpath=", "qt_hpfxpath="};
+    QList<QByteArray> keys4 {"qt_prfxpath=", "qt_datapath=", "qt_docspath=", "qt_hdrspath=", "qt_libspath=", "qt_binspath=",
+                             "qt_plugpath=", "qt_impspath=", "qt_trnspath=", "qt_xmplpath=", "qt_demopath="};
+
+    QTest::newRow("qt5 keys") << keys5 << 3;
+    QTest::newRow("qt4 keys") << keys4 << 11;
+}
+
+void KernelBench::binarySearch()
+{
+    QFETCH(QList<QByteArray>, keys);
+    QFETCH(int, blocks);
+
+    // a 64 MiB QtCore with the blocks spread over it, and many near misses as "qt_" is common in symbol names
+    QByteArray data(64 * 1024 * 1024, Qt::Uninitialized);
+    quint32 seed = 0x5eed;
+    for (int i = 0; i < data.size(); ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        data[i] = static_cast<char>(seed >> 24);
+    }
+    for (int i = 0; i + 16 < data.size(); i += 4096)
+        ::memcpy(data.data() + i, "qt_metacall\0qt_", 16);
+    for (int i = 0; i < blocks; ++i) {
+        QByteArray block = keys.at(i % keys.size()) + oldPrefix;
+        ::memcpy(data.data() + data.size() / (blocks + 1) * (i + 1), block.constData(), static_cast<size_t>(block.size()) + 1);
+    }
+
+    PatternMatcher matcher(keys);
+    QVERIFY(matcher.findAll(data.constData(), data.size()).size() >= blocks);
+
+    QBENCHMARK {
+        matcher.findAll(data.constData(), data.size());
+    }
+}
+
+QTEST_GUILESS_MAIN(KernelBench)
+
+#include "kernelbench.moc"
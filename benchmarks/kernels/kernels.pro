@@ -0,0 +1,15 @@
+# SPDX-License-Identifier: Unlicense
+
+QT -= gui
+QT += testlib
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+TARGET = kernelbench
+
+DEFINES += QT_DEPRECATED_WARNINGS QT_DISABLE_DEPRECATED_BEFORE=0x070000 VERSION=\\\"kernelbench\\\" QT_NO_CAST_FROM_ASCII
+
+SOURCES += \
+        kernelbench.cpp
+
+include(../../src/qqtpatcher.pri)
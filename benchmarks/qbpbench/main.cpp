@@ -0,0 +1,171 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "treegenerator.h"
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QProcess>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QVector>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+// Relocates synthetic Qt trees using a built QQtPatcher and reports the throughput, so it can be compared across commits.
+// Each run patches a freshly generated tree. Only the QQtPatcher process is timed, generating the tree is not.
+
+namespace {
+
+// the largest peak resident set size of the child processes waited for so far in KiB, -1 if unknown
+qint64 childrenPeakRss()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (::getrusage(RUSAGE_CHILDREN, &usage) != 0)
+        return -1;
+#ifdef Q_OS_DARWIN
+    // bytes on macOS
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+int intValue(const QCommandLineParser &parser, const QString &name, int minimum)
+{
+    bool ok = false;
+    int r = parser.value(name).toInt(&ok);
+    if (!ok || r < minimum) {
+        ::fprintf(stderr, "Invalid value of --%s: %s\n", name.toLocal8Bit().constData(), parser.value(name).toLocal8Bit().constData());
+        ::exit(2);
+    }
+    return r;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Benchmark of QQtPatcher using synthetic Qt trees.\n"
+                                                    "Arguments after \"--\" are passed to QQtPatcher."));
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("patcher"), QStringLiteral("The QQtPatcher executable to benchmark."), QStringLiteral("path")));
+    parser.addOption(QCommandLineOption(QStringLiteral("fake-qmake"),
+                                        QStringLiteral("The fakeqmake executable copied to bin/qmake of the trees. Defaults to the one built next to qbpbench."),
+                                        QStringLiteral("path")));
+    parser.addOption(QCommandLineOption(QStringLiteral("qt"), QStringLiteral("Major version of the generated Qt, 4 or 5."), QStringLiteral("version"), QStringLiteral("5")));
+    parser.addOption(QCommandLineOption(QStringLiteral("prl"), QStringLiteral("Number of .prl files in plugins/ and qml/."), QStringLiteral("N"), QStringLiteral("2000")));
+    parser.addOption(
+        QCommandLineOption(QStringLiteral("modules"), QStringLiteral("Number of modules, each having a .prl, a .pc and a .la file."), QStringLiteral("N"), QStringLiteral("60")));
+    parser.addOption(QCommandLineOption(QStringLiteral("core-size"), QStringLiteral("Size of the fake QtCore library in MiB."), QStringLiteral("MiB"), QStringLiteral("256")));
+    parser.addOption(QCommandLineOption(QStringLiteral("runs"), QStringLiteral("Number of timed runs."), QStringLiteral("N"), QStringLiteral("3")));
+    parser.addOption(QCommandLineOption(QStringLiteral("work-dir"),
+                                        QStringLiteral("Where the trees are generated. Defaults to a temporary dir, which is removed afterwards."),
+                                        QStringLiteral("path")));
+    parser.addOption(QCommandLineOption(QStringLiteral("generate-only"), QStringLiteral("Generate one tree in \"path\" and exit, e.g. for profiling by hand."), QStringLiteral("path")));
+    parser.process(a);
+
+    TreeOptions options;
+    options.qtMajorVersion = intValue(parser, QStringLiteral("qt"), 4);
+    if (options.qtMajorVersion != 4 && options.qtMajorVersion != 5) {
+        ::fprintf(stderr, "Only Qt 4 and Qt 5 trees can be generated.\n");
+        return 2;
+    }
+    options.prlFiles = intValue(parser, QStringLiteral("prl"), 0);
+    options.modules = intValue(parser, QStringLiteral("modules"), 0);
+    options.coreSize = static_cast<qint64>(intValue(parser, QStringLiteral("core-size"), 0)) * 1024 * 1024;
+    // never exists, so it is never mistaken for the new dir
+    options.prefix = (options.qtMajorVersion == 5) ? QStringLiteral("/opt/qbpbench/Qt-5.12.12") : QStringLiteral("/opt/qbpbench/Qt-4.8.7");
+    options.fakeQmake = parser.value(QStringLiteral("fake-qmake"));
+    if (options.fakeQmake.isEmpty()) {
+        QDir d(QCoreApplication::applicationDirPath());
+        foreach (const QString &candidate, QStringList {QStringLiteral("fakeqmake"), QStringLiteral("fakeqmake.exe"), QStringLiteral("../fakeqmake/fakeqmake"),
+                                                        QStringLiteral("../fakeqmake/fakeqmake.exe"), QStringLiteral("../fakeqmake/release/fakeqmake.exe")}) {
+            if (d.exists(candidate)) {
+                options.fakeQmake = d.absoluteFilePath(candidate);
+                break;
+            }
+        }
+    }
+    if (options.fakeQmake.isEmpty()) {
+        ::fprintf(stderr, "fakeqmake is not found, specify it using --fake-qmake.\n");
+        return 2;
+    }
+
+    if (parser.isSet(QStringLiteral("generate-only"))) {
+        TreeStats stats;
+        if (!generateTree(parser.value(QStringLiteral("generate-only")), options, &stats))
+            return 1;
+        ::printf("Generated %d files, %lld bytes.\n", stats.files, static_cast<long long>(stats.bytes));
+        return 0;
+    }
+
+    QString patcher = parser.value(QStringLiteral("patcher"));
+    if (patcher.isEmpty() || !QFileInfo(patcher).isExecutable()) {
+        ::fprintf(stderr, "Specify the QQtPatcher executable to benchmark using --patcher.\n");
+        return 2;
+    }
+
+    int runs = intValue(parser, QStringLiteral("runs"), 1);
+
+    QTemporaryDir temporaryDir;
+    QDir workDir(parser.isSet(QStringLiteral("work-dir")) ? parser.value(QStringLiteral("work-dir")) : temporaryDir.path());
+    workDir.mkpath(QStringLiteral("."));
+
+    QVector<qint64> elapsed;
+    TreeStats stats;
+    for (int run = 0; run < runs; ++run) {
+        QString treeDir = workDir.absoluteFilePath(QString(QStringLiteral("qt%1-run%2")).arg(options.qtMajorVersion).arg(run));
+        QDir(treeDir).removeRecursively();
+        if (!generateTree(treeDir, options, &stats))
+            return 1;
+
+        QProcess process;
+        process.setProgram(patcher);
+        process.setArguments(QStringList {QStringLiteral("--qt-dir"), treeDir, QStringLiteral("--new-dir"), treeDir} + parser.positionalArguments());
+        process.setProcessChannelMode(QProcess::ForwardedChannels);
+
+        QElapsedTimer timer;
+        timer.start();
+        process.start();
+        if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+            ::fprintf(stderr, "QQtPatcher failed in run %d, exit code %d.\n", run + 1, process.exitCode());
+            return 1;
+        }
+        qint64 ms = qMax<qint64>(timer.elapsed(), 1);
+        elapsed << ms;
+
+        ::printf("run %d: %lld ms, %.1f files/s, %.1f MiB/s\n", run + 1, static_cast<long long>(ms), stats.files * 1000.0 / ms,
+                 stats.bytes / 1048576.0 * 1000.0 / ms);
+        ::fflush(stdout);
+
+        if (!parser.isSet(QStringLiteral("work-dir")))
+            QDir(treeDir).removeRecursively();
+    }
+
+    std::sort(elapsed.begin(), elapsed.end());
+    qint64 median = elapsed.at(elapsed.size() / 2);
+    qint64 peakRss = childrenPeakRss();
+
+    // one line, so results of different commits are easy to collect and compare
+    ::printf("qt=%d files=%d bytes=%lld runs=%d median_ms=%lld min_ms=%lld files_per_s=%.1f mib_per_s=%.1f peak_rss_kib=%lld\n", options.qtMajorVersion, stats.files,
+             static_cast<long long>(stats.bytes), runs, static_cast<long long>(median), static_cast<long long>(elapsed.first()), stats.files * 1000.0 / median,
+             stats.bytes / 1048576.0 * 1000.0 / median, static_cast<long long>(peakRss));
+
+    return 0;
+}
@@ -0,0 +1,16 @@
+# SPDX-License-Identifier: Unlicense
+
+QT -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+TARGET = qbpbench
+
+DEFINES += QT_DEPRECATED_WARNINGS QT_DISABLE_DEPRECATED_BEFORE=0x070000 QT_NO_CAST_FROM_ASCII
+
+SOURCES += \
+        main.cpp \
+        treegenerator.cpp
+
+HEADERS += \
+        treegenerator.h
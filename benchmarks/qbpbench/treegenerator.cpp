@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "treegenerator.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QList>
+
+#include <cstdio>
+
+namespace {
+
+const char qt5Version[] = "5.12.12";
+const char qt4Version[] = "4.8.7";
+
+// as compiled into qmake and QtCore: the key, the path and NULs up to a fixed size
+const int pathBlockSize = 512 + 12;
+
+class TreeWriter
+{
+public:
+    TreeWriter(const QString &dir, TreeStats *stats)
+        : root(dir)
+        , stats(stats)
+        , ok(true)
+    {
+    }
+
+    void writeFile(const QString &path, const QByteArray &content)
+    {
+        QFile f(prepare(path));
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(content) != content.size())
+            fail(f.fileName());
+        count(content.size());
+    }
+
+    // pseudo random bytes with the blocks inserted at even intervals, written in chunks so the size is not limited by memory
+    void writeBinary(const QString &path, const QByteArray &head, qint64 size, const QList<QByteArray> &blocks)
+    {
+        QFile f(prepare(path));
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            fail(f.fileName());
+            return;
+        }
+
+        static const QByteArray chunk = randomChunk(1024 * 1024);
+
+        qint64 written = 0;
+        auto write = [&](const char *data, qint64 length) {
+            if (f.write(data, length) != length)
+                fail(f.fileName());
+            written += length;
+        };
+
+        write(head.constData(), head.size());
+        size = qMax(size, written + blocks.length() * pathBlockSize);
+        for (int i = 0; i <= blocks.length(); ++i) {
+            qint64 blockOffset = (i < blocks.length()) ? (size / (blocks.length() + 1) * (i + 1)) : size;
+            while (written < blockOffset)
+                write(chunk.constData(), qMin<qint64>(chunk.size(), blockOffset - written));
+            if (i < blocks.length())
+                write(blocks.at(i).constData(), blocks.at(i).size());
+        }
+
+        count(written);
+    }
+
+    bool isOk() const
+    {
+        return ok;
+    }
+
+private:
+    QString prepare(const QString &path)
+    {
+        root.mkpath(QFileInfo(path).path());
+        return root.absoluteFilePath(path);
+    }
+
+    void count(qint64 bytes)
+    {
+        ++stats->files;
+        stats->bytes += bytes;
+    }
+
+    void fail(const QString &fileName)
+    {
+        if (ok)
+            ::fprintf(stderr, "Unable to write %s.\n", QDir::toNativeSeparators(fileName).toLocal8Bit().constData());
+        ok = false;
+    }
+
+    static QByteArray randomChunk(int size)
+    {
+        // no NUL and no '=', so no key can be formed by chance
+        QByteArray r(size, Qt::Uninitialized);
+        quint32 seed = 0x5eed;
+        for (int i = 0; i < size; ++i) {
+            seed = seed * 1664525u + 1013904223u;
+            char c = static_cast<char>((seed >> 24) | 1);
+            r[i] = (c == '=') ? '-' : c;
+        }
+        return r;
+    }
+
+    QDir root;
+    TreeStats *stats;
+    bool ok;
+};
+
+QByteArray pathBlock(const char *key, const QString &path)
+{
+    QByteArray r = QByteArray(key) + path.toUtf8();
+    r.append(QByteArray(qMax(pathBlockSize - r.size(), 1), '\0'));
+    return r;
+}
+
+QString moduleName(int i)
+{
+    return QString(QStringLiteral("Bench%1")).arg(i, 3, 10, QLatin1Char('0'));
+}
+
+QByteArray prlContent(const TreeOptions &options, const QString &target, const QString &buildDir)
+{
+    QString lib = options.prefix + QStringLiteral("/lib");
+    QString core = (options.qtMajorVersion == 5) ? QStringLiteral("Qt5Core") : QStringLiteral("QtCore");
+    QString s = QString(QStringLiteral("QMAKE_PRL_BUILD_DIR = %1\n"
+                                       "QMAKE_PRO_INPUT = %2.pro\n"
+                                       "QMAKE_PRL_TARGET = lib%2.a\n"
+                                       "QMAKE_PRL_CONFIG = lex yacc depend_includepath testcase_targets qt staticlib static\n"
+                                       "QMAKE_PRL_LIBS = -L%3 %3/lib%4.a -lpthread -ldl\n"
+                                       "QMAKE_PRL_VERSION = %5\n"))
+                    .arg(buildDir)
+                    .arg(target)
+                    .arg(lib)
+                    .arg(core)
+                    .arg(QString::fromUtf8(options.qtMajorVersion == 5 ? qt5Version : qt4Version));
+    return s.toUtf8();
+}
+
+QByteArray pcContent(const TreeOptions &options, const QString &module)
+{
+    QString s;
+    if (options.qtMajorVersion == 5)
+        s = QString(QStringLiteral("prefix=%1\n"
+                                   "exec_prefix=${prefix}\n"
+                                   "libdir=${prefix}/lib\n"
+                                   "includedir=${prefix}/include\n"
+                                   "\n"
+                                   "host_bins=${prefix}/bin\n"
+                                   "qt_config=static\n"
+                                   "\n"
+                                   "Name: Qt5 %2\n"
+                                   "Description: Qt %2 module\n"
+                                   "Version: %3\n"
+                                   "Libs: -L${libdir} -lQt5%2\n"
+                                   "Libs.private: -lQt5Core -lpthread\n"
+                                   "Cflags: -DQT_%4_LIB -I${includedir}/Qt%2 -I${includedir}\n"
+                                   "Requires: Qt5Core\n"))
+                .arg(options.prefix)
+                .arg(module)
+                .arg(QString::fromUtf8(qt5Version))
+                .arg(module.toUpper());
+    else
+        s = QString(QStringLiteral("prefix=%1\n"
+                                   "exec_prefix=${prefix}\n"
+                                   "libdir=${prefix}/lib\n"
+                                   "includedir=${prefix}/include/Qt%2\n"
+                                   "qt_config=lex yacc warn_on uic resources qt warn_on release incremental link_prl\n"
+                                   "moc_location=${prefix}/bin/moc\n"
+                                   "uic_location=${prefix}/bin/uic\n"
+                                   "rcc_location=${prefix}/bin/rcc\n"
+                                   "lupdate_location=${prefix}/bin/lupdate\n"
+                                   "lrelease_location=${prefix}/bin/lrelease\n"
+                                   "\n"
+                                   "Name: Qt%2\n"
+                                   "Description: Qt%2 Library\n"
+                                   "Version: %3\n"
+                                   "Libs: -L${libdir} -lQt%2\n"
+                                   "Libs.private: -L%1/lib -lQtCore -lpthread\n"
+                                   "Cflags: -DQT_%4_LIB -I%1/include -I%1/include/Qt%2\n"
+                                   "Requires: QtCore\n"))
+                .arg(options.prefix)
+                .arg(module)
+                .arg(QString::fromUtf8(qt4Version))
+                .arg(module.toUpper());
+    return s.toUtf8();
+}
+
+QByteArray laContent(const TreeOptions &options, const QString &library)
+{
+    QString lib = options.prefix + QStringLiteral("/lib");
+    QString core = (options.qtMajorVersion == 5) ? QStringLiteral("libQt5Core") : QStringLiteral("libQtCore");
+    QString s = QString(QStringLiteral("# %1.la - a libtool library file\n"
+                                       "# Generated by libtool (GNU libtool) 2.4.6\n"
+                                       "\n"
+                                       "dlname=''\n"
+                                       "library_names=''\n"
+                                       "old_library='%1.a'\n"
+                                       "dependency_libs=' -L%2 %2/%3.la -lpthread -ldl'\n"
+                                       "weak_library_names=''\n"
+                                       "current=%4\n"
+                                       "installed=yes\n"
+                                       "shouldnotlink=no\n"
+                                       "libdir='%2'\n"))
+                    .arg(library)
+                    .arg(lib)
+                    .arg(core)
+                    .arg(options.qtMajorVersion);
+    return s.toUtf8();
+}
+
+QByteArray queryContent(const TreeOptions &options)
+{
+    QString version = QString::fromUtf8(options.qtMajorVersion == 5 ? qt5Version : qt4Version);
+    QString s = QString(QStringLiteral("QT_INSTALL_PREFIX:%1\n"
+                                       "QT_INSTALL_DATA:%1\n"
+                                       "QT_INSTALL_HEADERS:%1/include\n"
+                                       "QT_INSTALL_LIBS:%1/lib\n"
+                                       "QT_INSTALL_BINS:%1/bin\n"
+                                       "QT_INSTALL_PLUGINS:%1/plugins\n"
+                                       "QT_VERSION:%2\n"))
+                    .arg(options.prefix)
+                    .arg(version);
+    if (options.qtMajorVersion == 5)
+        s += QStringLiteral("QT_INSTALL_QML:%1/qml\n"
+                            "QMAKE_SPEC:linux-g++\n"
+                            "QMAKE_XSPEC:linux-g++\n")
+                 .arg(options.prefix);
+    return s.toUtf8();
+}
+
+}
+
+bool generateTree(const QString &dir, const TreeOptions &options, TreeStats *stats)
+{
+    *stats = TreeStats();
+    TreeWriter w(dir, stats);
+
+    const bool qt5 = (options.qtMajorVersion == 5);
+
+    // qmake, with the prefix it is detected from
+    QFile fakeQmake(options.fakeQmake);
+    if (!fakeQmake.open(QIODevice::ReadOnly)) {
+        ::fprintf(stderr, "Unable to read %s.\n", QDir::toNativeSeparators(options.fakeQmake).toLocal8Bit().constData());
+        return false;
+    }
+    QByteArray qmake = fakeQmake.readAll() + pathBlock("qt_prfxpath=", options.prefix);
+    w.writeFile(QStringLiteral("bin/qmake"), qmake);
+    QFile::setPermissions(QDir(dir).absoluteFilePath(QStringLiteral("bin/qmake")),
+                          QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner | QFile::ReadGroup | QFile::ExeGroup | QFile::ReadOther | QFile::ExeOther);
+    w.writeFile(QStringLiteral("bin/qmake.query"), queryContent(options));
+
+    // version and mkspec
+    w.writeFile(QStringLiteral("mkspecs/qconfig.pri"),
+                QByteArray("QT_VERSION = ") + (qt5 ? qt5Version : qt4Version) + "\nQT_EDITION = OpenSource\nQT_CONFIG += static\n");
+    w.writeFile(QStringLiteral("mkspecs/linux-g++/qmake.conf"), QByteArray("MAKEFILE_GENERATOR = UNIX\nQMAKE_PLATFORM = linux\nload(qt_config)\n"));
+    if (qt5) {
+        w.writeFile(QStringLiteral("lib/cmake/Qt5Core/Qt5CoreConfigExtrasMkspecDir.cmake"),
+                    QByteArray("\nset(_qt5_corelib_extra_includes \"${_qt5Core_install_prefix}/.//mkspecs/linux-g++\")\n"));
+        w.writeFile(QStringLiteral("mkspecs/modules/qt_lib_gui_private.pri"),
+                    QByteArray("QT.gui_private.VERSION = 5.12.12\nQMAKE_LIBS_OPENGL_ES2 = \nQMAKE_LIBS_EGL = \n"));
+        w.writeFile(QStringLiteral("mkspecs/modules/qt_lib_network_private.pri"),
+                    QByteArray("QT.network_private.VERSION = 5.12.12\nQMAKE_LIBS_NETWORK = \nQMAKE_LIBS_OPENSSL = \n"));
+    } else {
+        w.writeFile(QStringLiteral("mkspecs/default/qmake.conf"),
+                    (QStringLiteral("QMAKESPEC_ORIGINAL = ") + options.prefix + QStringLiteral("/mkspecs/linux-g++\n\ninclude(../linux-g++/qmake.conf)\n")).toUtf8());
+    }
+
+    // QtCore, whose paths are patched in place
+    QList<QByteArray> blocks;
+    if (qt5) {
+        blocks << pathBlock("qt_prfxpath=", options.prefix) << pathBlock("qt_epfxpath=", options.prefix) << pathBlock("qt_hpfxpath=", options.prefix);
+    } else {
+        // the keys of BinaryPatcher, with the suffixes it appends to the new dir
+        // clang-format off
+        static const struct
+        {
+            const char *key;
+            const char *suffix;
+        } qt4Blocks[] = {
+            {"qt_prfxpath=", ""},
+            {"qt_datapath=", ""},
+            {"qt_docspath=", "/doc"},
+            {"qt_hdrspath=", "/include"},
+            {"qt_libspath=", "/lib"},
+            {"qt_binspath=", "/bin"},
+            {"qt_plugpath=", "/plugins"},
+            {"qt_impspath=", "/imports"},
+            {"qt_trnspath=", "/translations"},
+            {"qt_xmplpath=", "/examples"},
+            {"qt_demopath=", "/demos"},
+        };
+        // clang-format on
+        for (size_t i = 0; i < sizeof(qt4Blocks) / sizeof(qt4Blocks[0]); ++i)
+            blocks << pathBlock(qt4Blocks[i].key, options.prefix + QString::fromUtf8(qt4Blocks[i].suffix));
+    }
+    w.writeBinary(qt5 ? QStringLiteral("lib/libQt5Core.a") : QStringLiteral("lib/libQtCore.so.4"), QByteArray("!<arch>\n"), options.coreSize, blocks);
+
+    // modules
+    const QString libPrefix = qt5 ? QStringLiteral("libQt5") : QStringLiteral("libQt");
+    const QString pcPrefix = qt5 ? QStringLiteral("Qt5") : QStringLiteral("Qt");
+    for (int i = 0; i < options.modules; ++i) {
+        QString module = moduleName(i);
+        w.writeFile(QStringLiteral("lib/") + libPrefix + module + QStringLiteral(".prl"),
+                    prlContent(options, (qt5 ? QStringLiteral("Qt5") : QStringLiteral("Qt")) + module, options.prefix + QStringLiteral("/src/") + module));
+        w.writeFile(QStringLiteral("lib/pkgconfig/") + pcPrefix + module + QStringLiteral(".pc"), pcContent(options, module));
+        w.writeFile(QStringLiteral("lib/") + libPrefix + module + QStringLiteral(".la"), laContent(options, libPrefix + module));
+    }
+
+    // plugins and QML imports, 20 in a dir
+    for (int i = 0; i < options.prlFiles; ++i) {
+        bool plugin = (i % 2) == 0;
+        QString target = QString(QStringLiteral("q%1%2")).arg(plugin ? QStringLiteral("plugin") : QStringLiteral("qml")).arg(i, 5, 10, QLatin1Char('0'));
+        QString subDir = QString(QStringLiteral("%1/bench%2")).arg(plugin ? QStringLiteral("plugins") : QStringLiteral("qml")).arg(i / 40, 3, 10, QLatin1Char('0'));
+        w.writeFile(subDir + QStringLiteral("/lib") + target + QStringLiteral(".prl"), prlContent(options, target, options.prefix + QStringLiteral("/src/") + subDir));
+    }
+
+    return w.isOk();
+}
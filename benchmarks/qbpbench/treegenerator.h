@@ -0,0 +1,48 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPTREEGENERATOR_H
+#define QQBPTREEGENERATOR_H
+
+#include <QString>
+
+struct TreeOptions
+{
+    // 4 or 5
+    int qtMajorVersion;
+    // recorded in the generated files as the install prefix, i.e. the old dir QQtPatcher relocates from
+    QString prefix;
+    // split between plugins/ and qml/, in addition to the .prl files of the modules
+    int prlFiles;
+    // number of Qt modules, each one has a .prl, a .pc and a .la file
+    int modules;
+    // size of the fake QtCore library, which contains the qt_xxxxpath= blocks
+    qint64 coreSize;
+    // copied to bin/qmake
+    QString fakeQmake;
+
+    TreeOptions()
+        : qtMajorVersion(5)
+        , prlFiles(0)
+        , modules(0)
+        , coreSize(0)
+    {
+    }
+};
+
+struct TreeStats
+{
+    int files;
+    qint64 bytes;
+
+    TreeStats()
+        : files(0)
+        , bytes(0)
+    {
+    }
+};
+
+// Generates a linux-g++ Qt install tree in dir, containing the files QQtPatcher patches with paths under options.prefix.
+// The Qt version, prefix and mkspec are all detectable from the files, qmake is only run if QQtPatcher is told to.
+bool generateTree(const QString &dir, const TreeOptions &options, TreeStats *stats);
+
+#endif
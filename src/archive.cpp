@@ -0,0 +1,176 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "archive.h"
+#include <QtEndian>
+
+#include <cstring>
+
+namespace {
+
+const char magic[] = "!<arch>\n";
+const qint64 magicSize = 8;
+// struct ar_hdr
+const qint64 headerSize = 60;
+
+// decimal, padded with spaces
+bool readNumber(const char *p, int length, qint64 *value)
+{
+    bool ok = false;
+    *value = QByteArray(p, length).trimmed().toLongLong(&ok);
+    return ok && *value >= 0;
+}
+
+bool isSymbolIndex(const QByteArray &name)
+{
+    return name == "/" || name == "/SYM64/" || name == "__.SYMDEF" || name == "__.SYMDEF SORTED";
+}
+
+quint32 readBig32(const char *p)
+{
+    return qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(p));
+}
+
+quint64 readBig64(const char *p)
+{
+    return qFromBigEndian<quint64>(reinterpret_cast<const uchar *>(p));
+}
+
+quint32 readLittle32(const char *p)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(p));
+}
+
+// NUL separated names following the offsets, in GNU and COFF symbol indexes
+bool readNames(const char *p, const char *end, const QVector<qint64> &offsets, QVector<Archive::Symbol> *symbols)
+{
+    foreach (qint64 offset, offsets) {
+        if (p >= end)
+            return false;
+        int length = static_cast<int>(qstrnlen(p, static_cast<uint>(end - p)));
+        Archive::Symbol s;
+        s.name = QByteArray(p, length);
+        s.member = offset;
+        *symbols << s;
+        p += length + 1;
+    }
+    return true;
+}
+
+}
+
+bool Archive::readMembers(const char *data, qint64 size, QVector<Member> *members)
+{
+    members->clear();
+    if (size < magicSize || ::memcmp(data, magic, magicSize) != 0)
+        return false;
+
+    QByteArray longNames;
+    qint64 header = magicSize;
+    while (header + headerSize <= size) {
+        const char *h = data + header;
+        if (h[58] != '`' || h[59] != '\n')
+            return false;
+
+        Member m;
+        m.header = header;
+        m.offset = header + headerSize;
+        if (!readNumber(h + 48, 10, &m.size) || m.size > size - m.offset)
+            return false;
+
+        QByteArray name = QByteArray(h, 16).trimmed();
+        if (name.startsWith("#1/")) {
+            // BSD, the name is at the start of the content
+            qint64 length = 0;
+            if (!readNumber(h + 3, 13, &length) || length > m.size)
+                return false;
+            name = QByteArray(data + m.offset, static_cast<int>(qstrnlen(data + m.offset, static_cast<uint>(length))));
+            m.offset += length;
+            m.size -= length;
+        } else if (name.length() > 1 && name.at(0) == '/' && name.at(1) >= '0' && name.at(1) <= '9') {
+            // GNU and COFF, offset in the long name table, where names end with "/\n" or '\0'
+            qint64 offset = 0;
+            if (!readNumber(name.constData() + 1, name.length() - 1, &offset) || offset >= longNames.length())
+                return false;
+            int begin = static_cast<int>(offset);
+            int end = begin;
+            while (end < longNames.length() && longNames.at(end) != '\n' && longNames.at(end) != '\0')
+                ++end;
+            name = longNames.mid(begin, end - begin);
+            if (name.endsWith('/'))
+                name.chop(1);
+        } else if (name.length() > 1 && name.endsWith('/') && name != "/SYM64/" && name != "//") {
+            name.chop(1);
+        }
+
+        if (name == "//")
+            longNames = QByteArray::fromRawData(data + m.offset, static_cast<int>(m.size));
+
+        m.name = name;
+        *members << m;
+
+        // content is aligned to 2 bytes
+        header = m.offset + m.size + (m.size % 2);
+    }
+
+    return true;
+}
+
+bool Archive::readSymbols(const char *data, const QVector<Member> &members, QVector<Symbol> *symbols)
+{
+    symbols->clear();
+
+    foreach (const Member &m, members) {
+        if (!isSymbolIndex(m.name))
+            continue;
+
+        const char *p = data + m.offset;
+        const char *end = p + m.size;
+        QVector<qint64> offsets;
+
+        if (m.name == "/") {
+            // GNU, and the first linker member of COFF: big endian count, member offsets, names
+            if (m.size < 4)
+                return false;
+            quint32 count = readBig32(p);
+            if (static_cast<qint64>(count) > (m.size - 4) / 4)
+                return false;
+            for (quint32 i = 0; i < count; ++i)
+                offsets << readBig32(p + 4 + i * 4);
+            return readNames(p + 4 + count * 4, end, offsets, symbols);
+        }
+
+        if (m.name == "/SYM64/") {
+            if (m.size < 8)
+                return false;
+            quint64 count = readBig64(p);
+            if (count > static_cast<quint64>(m.size - 8) / 8)
+                return false;
+            for (quint64 i = 0; i < count; ++i)
+                offsets << static_cast<qint64>(readBig64(p + 8 + i * 8));
+            return readNames(p + 8 + count * 8, end, offsets, symbols);
+        }
+
+        // BSD, as written on little endian hosts: size of the ranlib array, ranlib {name offset, member offset} pairs, size of the names, names
+        if (m.size < 8)
+            return false;
+        quint32 ranlibSize = readLittle32(p);
+        if (ranlibSize % 8 != 0 || static_cast<qint64>(ranlibSize) > m.size - 8)
+            return false;
+        const char *strings = p + 4 + ranlibSize + 4;
+        quint32 stringsSize = readLittle32(p + 4 + ranlibSize);
+        if (stringsSize > static_cast<quint64>(end - strings))
+            return false;
+        for (quint32 i = 0; i < ranlibSize / 8; ++i) {
+            quint32 name = readLittle32(p + 4 + i * 8);
+            if (name >= stringsSize)
+                return false;
+            Symbol s;
+            s.name = QByteArray(strings + name, static_cast<int>(qstrnlen(strings + name, stringsSize - name)));
+            s.member = readLittle32(p + 4 + i * 8 + 4);
+            *symbols << s;
+        }
+        return true;
+    }
+
+    return true;
+}
@@ -0,0 +1,41 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPARCHIVE_H
+#define QQBPARCHIVE_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Reads the member table and symbol index of static libraries: ar archives in GNU and BSD format, and COFF archives (.lib) of MSVC.
+// Only the headers are read, so a large archive is walked without touching the content of its members.
+namespace Archive {
+
+struct Member
+{
+    // long names resolved, without the trailing '/' of GNU and COFF archives
+    QByteArray name;
+    // offset of the member header in the archive, which is what the symbol index refers to
+    qint64 header;
+    // offset and size of the content
+    qint64 offset;
+    qint64 size;
+};
+
+struct Symbol
+{
+    QByteArray name;
+    // header of the member defining the symbol
+    qint64 member;
+};
+
+// Returns false if data is not an archive, or a member is out of bounds.
+// The symbol index and the long name table are returned as members as well, named "/", "/SYM64/", "__.SYMDEF" and "//".
+bool readMembers(const char *data, qint64 size, QVector<Member> *members);
+
+// Reads the first symbol index in members, an archive without one has no symbols.
+// Returns false if the index is out of bounds.
+bool readSymbols(const char *data, const QVector<Member> &members, QVector<Symbol> *symbols);
+
+}
+
+#endif
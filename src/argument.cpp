@@ -9,6 +9,7 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonParseError>
+#include <QThread>
 
 struct AasStorage
 {
@@ -18,10 +19,18 @@ struct AasStorage
     bool verbose;
     QString backupDir;
     QString logfile;
+    QString traceFile;
     bool force;
     QString qtDir;
     QString newDir;
     bool dryRun;
+    int jobs;
+    bool queryQMake;
+    bool rescan;
+    bool verify;
+    bool discoverBinaries;
+    QString undoJournal;
+    QString batchFile;
     QStringList unknownParameters;
 
     // config files
@@ -38,12 +47,32 @@ struct AasStorage
         , verbose(false)
         , force(false)
         , dryRun(false)
+        , jobs(qMax(QThread::idealThreadCount(), 1))
+        , queryQMake(false)
+        , rescan(false)
+        , verify(true)
+        , discoverBinaries(false)
     {
     }
 };
 
 namespace {
 AasStorage s;
+// s right after parsing, restored before each kit in batch mode
+AasStorage parsed;
+
+// keys shared by qbp.json and kits in batch file
+void readConfig(const QJsonObject &ob)
+{
+    if (ob.contains(QStringLiteral("crossMkspec")))
+        s.crossMkspec = ob.value(QStringLiteral("crossMkspec")).toString();
+    if (ob.contains(QStringLiteral("hostMkspec")))
+        s.hostMkspec = ob.value(QStringLiteral("hostMkspec")).toString();
+    if (ob.contains(QStringLiteral("qtVersion")))
+        s.qtVersion = ob.value(QStringLiteral("qtVersion")).toString();
+    if (ob.contains(QStringLiteral("buildDir")))
+        s.buildDir = ob.value(QStringLiteral("buildDir")).toString();
+}
 }
 
 bool ArgumentsAndSettings::parse()
@@ -75,12 +104,18 @@ bool ArgumentsAndSettings::parse()
     parser.addHelpOption();
     parser.addOption(QCommandLineOption({QStringLiteral("V"), QStringLiteral("verbose")}, QStringLiteral("Print extended runtime information.")));
     parser.addOption(QCommandLineOption({QStringLiteral("b"), QStringLiteral("backup")},
-                                        QStringLiteral("If specified, the backup files made during patching will be saved to the specified path."
+                                        QStringLiteral("If specified, the journal and backup files made during patching will be saved to the specified path,"
+                                                       " so the patching can be reverted later using \"--undo\"."
+                                                       " The manifest of the patched files is saved there as well instead of the cache dir of the user."
                                                        " If not, the backup files made during patching will be deleted if succeeded.\n"
                                                        "Note: the backup files will be restored if an error occurs."),
                                         QStringLiteral("path")));
     parser.addOption(
         QCommandLineOption({QStringLiteral("l"), QStringLiteral("logfile")}, QStringLiteral("Duplicate messages into logfile with name \"name\"."), QStringLiteral("name")));
+    parser.addOption(QCommandLineOption(QStringLiteral("trace"),
+                                        QStringLiteral("Record the time spent in each step, patcher, file and external process into \"name\", "
+                                                       "a Chrome trace event file which can be opened in Perfetto or chrome://tracing."),
+                                        QStringLiteral("name")));
     parser.addOption(QCommandLineOption({QStringLiteral("f"), QStringLiteral("force")}, QStringLiteral("Force patching (without old path actuality checking).")));
     parser.addOption(QCommandLineOption({QStringLiteral("q"), QStringLiteral("qt-dir")},
                                         QStringLiteral("Directory, where Qt or qmake is now located (may be relative).\n"
@@ -93,6 +128,32 @@ bool ArgumentsAndSettings::parse()
                                                        "If not specified, current location will be used."),
                                         QStringLiteral("path")));
     parser.addOption(QCommandLineOption({QStringLiteral("d"), QStringLiteral("dry-run")}, QStringLiteral("Output the procedure only, do not really process the jobs.")));
+    parser.addOption(QCommandLineOption({QStringLiteral("j"), QStringLiteral("jobs")},
+                                        QStringLiteral("Number of files to be patched simultaneously.\n"
+                                                       "If not specified, number of processors will be used."),
+                                        QStringLiteral("N")));
+    parser.addOption(QCommandLineOption(QStringLiteral("query-qmake"),
+                                        QStringLiteral("Run \"qmake -query\" to get Qt version, prefix and mkspecs, and verify the ones detected from files of Qt.\n"
+                                                       "If not specified, qmake is only run when they can't be detected from files.")));
+    parser.addOption(QCommandLineOption(QStringLiteral("rescan"),
+                                        QStringLiteral("Search all files to patch, ignoring the manifest saved by last run on the same Qt dir.\n"
+                                                       "If not specified, files which are unchanged since last run are not searched again. "
+                                                       "The manifest is saved in the backup dir if given, otherwise in the cache dir of the user.")));
+    parser.addOption(QCommandLineOption(QStringLiteral("verify"),
+                                        QStringLiteral("Search all files of Qt dir for the old path after patching, and warn about each one left. This is the default.")));
+    parser.addOption(QCommandLineOption(QStringLiteral("no-verify"), QStringLiteral("Do not search for the old path after patching.")));
+    parser.addOption(QCommandLineOption(QStringLiteral("discover-binaries"),
+                                        QStringLiteral("Search all files in bin, lib, libexec and plugins for the paths embedded in QtCore, and patch every file having them.\n"
+                                                       "If not specified, only qmake and QtCore are patched.")));
+    parser.addOption(QCommandLineOption(QStringLiteral("batch"),
+                                        QStringLiteral("Patch all Qt kits listed in \"jobs\", which is a JSON file like {\"kits\": [{\"qtDir\": \"...\", \"newDir\": \"...\"}, ...]}.\n"
+                                                       "Each kit may also contain \"name\", \"backupDir\", \"force\" and the keys of qbp.json. "
+                                                       "Relative paths are resolved against the dir of \"jobs\". Other options apply to all kits."),
+                                        QStringLiteral("jobs")));
+    parser.addOption(QCommandLineOption({QStringLiteral("u"), QStringLiteral("undo")},
+                                        QStringLiteral("Revert the patching recorded in journal \"journal\", which is saved in the backup dir specified by \"--backup\".\n"
+                                                       "Qt dir recorded in the journal is used unless \"--qt-dir\" is specified."),
+                                        QStringLiteral("journal")));
 
     parser.process(*qApp);
     if (parser.isSet(QStringLiteral("V")))
@@ -101,6 +162,8 @@ bool ArgumentsAndSettings::parse()
         s.backupDir = parser.value(QStringLiteral("b"));
     if (parser.isSet(QStringLiteral("l")))
         s.logfile = parser.value(QStringLiteral("l"));
+    if (parser.isSet(QStringLiteral("trace")))
+        s.traceFile = parser.value(QStringLiteral("trace"));
     if (parser.isSet(QStringLiteral("f")))
         s.force = true;
     if (parser.isSet(QStringLiteral("q")))
@@ -109,28 +172,40 @@ bool ArgumentsAndSettings::parse()
         s.newDir = parser.value(QStringLiteral("n"));
     if (parser.isSet(QStringLiteral("d")))
         s.dryRun = true;
-
-    s.unknownParameters = parser.unknownOptionNames() + parser.positionalArguments();
+    if (parser.isSet(QStringLiteral("j"))) {
+        bool ok = false;
+        int jobs = parser.value(QStringLiteral("j")).toInt(&ok);
+        if (ok && jobs > 0)
+            s.jobs = jobs;
+        else
+            s.unknownParameters << (QStringLiteral("jobs=") + parser.value(QStringLiteral("j")));
+    }
+    if (parser.isSet(QStringLiteral("query-qmake")))
+        s.queryQMake = true;
+    if (parser.isSet(QStringLiteral("rescan")))
+        s.rescan = true;
+    if (parser.isSet(QStringLiteral("no-verify")))
+        s.verify = false;
+    if (parser.isSet(QStringLiteral("discover-binaries")))
+        s.discoverBinaries = true;
+    if (parser.isSet(QStringLiteral("u")))
+        s.undoJournal = parser.value(QStringLiteral("u"));
+    if (parser.isSet(QStringLiteral("batch")))
+        s.batchFile = parser.value(QStringLiteral("batch"));
+
+    s.unknownParameters << parser.unknownOptionNames() << parser.positionalArguments();
 
     QFile configFile(QStringLiteral("qbp.json"));
     if (configFile.exists() && configFile.open(QFile::ReadOnly | QFile::Text)) {
         QJsonParseError err;
         QJsonDocument doc = QJsonDocument::fromJson(configFile.readAll(), &err);
         if (err.error == QJsonParseError::NoError) {
-            if (doc.isObject()) {
-                QJsonObject ob = doc.object();
-                if (ob.contains(QStringLiteral("crossMkspec")))
-                    s.crossMkspec = ob.value(QStringLiteral("crossMkspec")).toString();
-                if (ob.contains(QStringLiteral("hostMkspec")))
-                    s.hostMkspec = ob.value(QStringLiteral("hostMkspec")).toString();
-                if (ob.contains(QStringLiteral("qtVersion")))
-                    s.qtVersion = ob.value(QStringLiteral("qtVersion")).toString();
-                if (ob.contains(QStringLiteral("buildDir")))
-                    s.buildDir = ob.value(QStringLiteral("buildDir")).toString();
-            }
+            if (doc.isObject())
+                readConfig(doc.object());
         }
     }
 
+    parsed = s;
     return true;
 }
 
@@ -149,6 +224,11 @@ QString ArgumentsAndSettings::logFile()
     return s.logfile;
 }
 
+QString ArgumentsAndSettings::traceFile()
+{
+    return s.traceFile;
+}
+
 bool ArgumentsAndSettings::force()
 {
     return s.force;
@@ -169,6 +249,41 @@ bool ArgumentsAndSettings::dryRun()
     return s.dryRun;
 }
 
+int ArgumentsAndSettings::jobs()
+{
+    return s.jobs;
+}
+
+bool ArgumentsAndSettings::queryQMake()
+{
+    return s.queryQMake;
+}
+
+bool ArgumentsAndSettings::rescan()
+{
+    return s.rescan;
+}
+
+bool ArgumentsAndSettings::verify()
+{
+    return s.verify;
+}
+
+bool ArgumentsAndSettings::discoverBinaries()
+{
+    return s.discoverBinaries;
+}
+
+QString ArgumentsAndSettings::undoJournal()
+{
+    return s.undoJournal;
+}
+
+QString ArgumentsAndSettings::batchFile()
+{
+    return s.batchFile;
+}
+
 QStringList ArgumentsAndSettings::unknownParameters()
 {
     return s.unknownParameters;
@@ -204,6 +319,25 @@ QString ArgumentsAndSettings::oldDir()
     return s.oldDir;
 }
 
+void ArgumentsAndSettings::applyKit(const QJsonObject &kit, const QDir &baseDir, const QString &kitName)
+{
+    s = parsed;
+
+    if (kit.contains(QStringLiteral("qtDir")))
+        s.qtDir = baseDir.absoluteFilePath(kit.value(QStringLiteral("qtDir")).toString());
+    if (kit.contains(QStringLiteral("newDir")))
+        s.newDir = baseDir.absoluteFilePath(kit.value(QStringLiteral("newDir")).toString());
+    if (kit.contains(QStringLiteral("backupDir")))
+        s.backupDir = baseDir.absoluteFilePath(kit.value(QStringLiteral("backupDir")).toString());
+    else if (!s.backupDir.isEmpty()) {
+        // kits sharing the backup dir from command line must not overwrite the journal of each other
+        s.backupDir = QDir(s.backupDir).absoluteFilePath(kitName);
+    }
+    if (kit.contains(QStringLiteral("force")))
+        s.force = kit.value(QStringLiteral("force")).toBool();
+    readConfig(kit);
+}
+
 void ArgumentsAndSettings::setQtDir(const QString &dir)
 {
     QBPLOGV(QStringLiteral("qtDir is set to ") + dir);
@@ -3,6 +3,8 @@
 #ifndef QQBPARGUMENT_H
 #define QQBPARGUMENT_H
 
+#include <QDir>
+#include <QJsonObject>
 #include <QString>
 #include <QVersionNumber>
 
@@ -14,10 +16,18 @@ bool parse();
 bool verbose();
 QString backupDir();
 QString logFile();
+QString traceFile();
 bool force();
 QString qtDir();
 QString newDir();
 bool dryRun();
+int jobs();
+bool queryQMake();
+bool rescan();
+bool verify();
+bool discoverBinaries();
+QString undoJournal();
+QString batchFile();
 QStringList unknownParameters();
 
 // config files
@@ -30,6 +40,11 @@ QString buildDir();
 // detected from QMake
 QString oldDir();
 
+// batch mode
+// Restores the settings parsed from command line and qbp.json, then applies the ones of a kit in batch file.
+// Relative paths in the kit are resolved against baseDir.
+void applyKit(const QJsonObject &kit, const QDir &baseDir, const QString &kitName);
+
 // helpers
 void setQtDir(const QString &dir);
 void setNewDir(const QString &dir);
@@ -3,21 +3,154 @@
 #include "backup.h"
 #include "argument.h"
 #include "log.h"
+#include "trace.h"
+#include <QDataStream>
 #include <QDir>
-#include <QFileInfo>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QString>
 #include <QTemporaryDir>
 
+#include <cstring>
+
+namespace {
+
+const char journalMagic[8] = {'Q', 'Q', 'B', 'P', 'J', 'R', 'N', 'L'};
+// 1 had entries referring to whole files copied to the backup dir
+const quint32 journalVersion = 2;
+const QDataStream::Version journalStreamVersion = QDataStream::Qt_5_6;
+
+struct JournalEntry
+{
+    enum Type
+    {
+        Content = 1, // data is the qCompress'ed content of the whole file
+        Range = 2 // data is the old bytes at offset
+    };
+
+    quint8 type;
+    QString path;
+    qint64 offset;
+    QByteArray data;
+
+    JournalEntry()
+        : type(0)
+        , offset(0)
+    {
+    }
+};
+
+QDataStream &operator<<(QDataStream &s, const JournalEntry &e)
+{
+    return s << e.type << e.path << e.offset << e.data;
+}
+
+QDataStream &operator>>(QDataStream &s, JournalEntry &e)
+{
+    return s >> e.type >> e.path >> e.offset >> e.data;
+}
+
+bool restoreEntry(const JournalEntry &e, const QDir &qtDir)
+{
+    QString target = qtDir.absoluteFilePath(e.path);
+    switch (e.type) {
+    case JournalEntry::Content: {
+        // the file may have been removed by the patcher, so it is recreated if needed
+        QByteArray content = qUncompress(e.data);
+        QFile f(target);
+        return f.open(QIODevice::WriteOnly | QIODevice::Truncate) && f.write(content) == content.size();
+    }
+    case JournalEntry::Range: {
+        QFile f(target);
+        return f.open(QIODevice::ReadWrite) && f.seek(e.offset) && f.write(e.data) == e.data.size();
+    }
+    default:
+        break;
+    }
+
+    return false;
+}
+
+// replays the journal backwards, so a file touched by several entries ends up with its oldest content
+bool replay(const QList<JournalEntry> &entries, const QDir &qtDir)
+{
+    bool r = true;
+    for (int i = entries.length() - 1; i >= 0; --i) {
+        const JournalEntry &e = entries.at(i);
+        QBPLOGV([&]() { return QString(QStringLiteral("restoring file %1, entry type %2, %3 bytes")).arg(e.path).arg(e.type).arg(e.data.size()); });
+        if (!restoreEntry(e, qtDir)) {
+            QBPLOGE(QString(QStringLiteral("failed to restore file %1")).arg(e.path));
+            r = false;
+        }
+    }
+
+    return r;
+}
+
+}
+
 struct BackupPrivate
 {
     QDir qtDir;
     QDir backupDir;
     bool tempBackup;
-    QStringList filesMadeBackup;
+    bool journalTried;
+
+    // entries may be appended simultaneously by step4 workers
+    QMutex mutex;
+    QList<JournalEntry> entries;
+    QFile journalFile;
+    QDataStream journal;
 
     BackupPrivate()
         : tempBackup(false)
+        , journalTried(false)
+    {
+    }
+
+    // called with mutex held
+    void openJournal()
     {
+        journalTried = true;
+        journalFile.setFileName(backupDir.absoluteFilePath(QStringLiteral("QQtPatcher.journal")));
+        if (!journalFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            QBPLOGW(QString(QStringLiteral("Unable to write journal %1, the backup will be kept in memory only.")).arg(journalFile.fileName()));
+            return;
+        }
+
+        journal.setDevice(&journalFile);
+        journal.setVersion(journalStreamVersion);
+        journal.writeRawData(journalMagic, sizeof(journalMagic));
+        journal << journalVersion << qtDir.absolutePath();
+        journalFile.flush();
+    }
+
+    bool append(const JournalEntry &e)
+    {
+        QMutexLocker locker(&mutex);
+        entries << e;
+
+        // the journal is only created (and an older one overwritten) once there is something to undo
+        if (!journalTried)
+            openJournal();
+
+        // written out right away, so the changes can be undone even if the patcher crashes midway
+        if (!journalFile.isOpen())
+            return true;
+        journal << e;
+        return journalFile.flush() && journal.status() == QDataStream::Ok;
+    }
+
+    bool checkPath(const QString &pathRelativeToQtDir, const QString &originalPath) const
+    {
+        // detect possibly erroneous backup operation?
+        if (pathRelativeToQtDir.contains(QStringLiteral(".."))) {
+            QBPLOGE(QString(QStringLiteral("backup: path %1 contains \"..\", will not backup.")).arg(originalPath));
+            return false;
+        }
+        return true;
     }
 };
 
@@ -34,8 +167,10 @@ Backup::Backup()
             d->backupDir = QDir(dir.path());
             d->tempBackup = true;
         }
-    } else
+    } else {
         d->backupDir = QDir(ArgumentsAndSettings::backupDir());
+        d->backupDir.mkpath(QStringLiteral("."));
+    }
 
     d->qtDir = QDir(ArgumentsAndSettings::qtDir());
 
@@ -47,6 +182,8 @@ Backup::~Backup()
     if (!ArgumentsAndSettings::dryRun()) {
         if (d->tempBackup)
             destroy();
+        else if (d->journalFile.isOpen())
+            QBPLOGV(QString(QStringLiteral("journal saved to %1, patching can be reverted using --undo")).arg(d->journalFile.fileName()));
     }
 
     delete d;
@@ -57,22 +194,56 @@ bool Backup::backupOneFile(const QString &pathRelativeToQtDir_)
     if (ArgumentsAndSettings::dryRun())
         return false;
 
+    TraceSpan span("backup", "backupOneFile", pathRelativeToQtDir_);
+
     QString pathRelativeToQtDir = QDir::cleanPath(pathRelativeToQtDir_);
-    // detect possibly erroneous backup operation?
-    if (pathRelativeToQtDir.contains(QStringLiteral(".."))) {
-        QBPLOGE(QString(QStringLiteral("backupOneFile: path %1 contains \"..\", will not backup.")).arg(pathRelativeToQtDir_));
+    if (!d->checkPath(pathRelativeToQtDir, pathRelativeToQtDir_))
+        return false;
+
+    QFile f(d->qtDir.absoluteFilePath(pathRelativeToQtDir));
+    span.setBytes(f.size());
+    if (!f.open(QIODevice::ReadOnly)) {
+        QBPLOGE(QString(QStringLiteral("backupOneFile: unable to read %1")).arg(pathRelativeToQtDir));
         return false;
     }
+    return backupContent(pathRelativeToQtDir, f.readAll());
+}
+
+bool Backup::backupContent(const QString &pathRelativeToQtDir_, const QByteArray &content)
+{
+    if (ArgumentsAndSettings::dryRun())
+        return false;
+
+    QString pathRelativeToQtDir = QDir::cleanPath(pathRelativeToQtDir_);
+    if (!d->checkPath(pathRelativeToQtDir, pathRelativeToQtDir_))
+        return false;
+
+    QBPLOGV([&]() { return QString(QStringLiteral("making backup for file %1, strategy: journal, %2 bytes")).arg(pathRelativeToQtDir).arg(content.size()); });
+    TraceSpan span("backup", "backupContent", pathRelativeToQtDir);
+    span.setBytes(content.size());
+
+    JournalEntry e;
+    e.type = JournalEntry::Content;
+    e.path = pathRelativeToQtDir;
+    e.data = qCompress(content);
+    return d->append(e);
+}
 
-    QBPLOGV(QString(QStringLiteral("making backup for file %1")).arg(pathRelativeToQtDir));
+bool Backup::backupRange(const QString &pathRelativeToQtDir_, qint64 offset, const QByteArray &oldBytes)
+{
+    if (ArgumentsAndSettings::dryRun())
+        return false;
 
-    QFileInfo fileToBackup(d->qtDir, pathRelativeToQtDir);
-    QString relativeDir = d->qtDir.relativeFilePath(fileToBackup.absolutePath());
-    d->backupDir.mkpath(relativeDir);
-    QFile::copy(d->qtDir.absoluteFilePath(pathRelativeToQtDir), d->backupDir.absoluteFilePath(pathRelativeToQtDir));
+    QString pathRelativeToQtDir = QDir::cleanPath(pathRelativeToQtDir_);
+    if (!d->checkPath(pathRelativeToQtDir, pathRelativeToQtDir_))
+        return false;
 
-    d->filesMadeBackup << pathRelativeToQtDir;
-    return true;
+    JournalEntry e;
+    e.type = JournalEntry::Range;
+    e.path = pathRelativeToQtDir;
+    e.offset = offset;
+    e.data = oldBytes;
+    return d->append(e);
 }
 
 bool Backup::restoreAll()
@@ -80,13 +251,11 @@ bool Backup::restoreAll()
     if (ArgumentsAndSettings::dryRun())
         return false;
 
-    foreach (const QString &file, d->filesMadeBackup) {
-        QBPLOGV(QString(QStringLiteral("restoring backup file %1")).arg(file));
-        QFile::copy(d->backupDir.absoluteFilePath(file), d->qtDir.absoluteFilePath(file));
-    }
-    d->filesMadeBackup.clear();
+    QMutexLocker locker(&d->mutex);
+    bool r = replay(d->entries, d->qtDir);
+    d->entries.clear();
 
-    return true;
+    return r;
 }
 
 void Backup::destroy()
@@ -95,6 +264,47 @@ void Backup::destroy()
         return;
 
     QBPLOGV(QString(QStringLiteral("deleting backup dir %1")).arg(d->backupDir.absolutePath()));
+    QMutexLocker locker(&d->mutex);
+    d->journal.setDevice(nullptr);
+    d->journalFile.close();
     d->backupDir.removeRecursively();
-    d->filesMadeBackup.clear();
+    d->entries.clear();
+}
+
+bool Backup::undo(const QString &journalFile)
+{
+    QFile f(journalFile);
+    if (!f.open(QIODevice::ReadOnly)) {
+        QBPLOGE(QString(QStringLiteral("Unable to open journal %1")).arg(journalFile));
+        return false;
+    }
+
+    QDataStream s(&f);
+    s.setVersion(journalStreamVersion);
+    char magic[sizeof(journalMagic)];
+    quint32 version = 0;
+    QString qtDirPath;
+    if (s.readRawData(magic, sizeof(magic)) == sizeof(magic) && ::memcmp(magic, journalMagic, sizeof(magic)) == 0)
+        s >> version >> qtDirPath;
+    if (version != journalVersion) {
+        QBPLOGE(QString(QStringLiteral("%1 is not a journal of QQtPatcher")).arg(journalFile));
+        return false;
+    }
+
+    QList<JournalEntry> entries;
+    while (!s.atEnd()) {
+        JournalEntry e;
+        s >> e;
+        // the last entry may be incomplete if the patcher crashed while writing it
+        if (s.status() != QDataStream::Ok) {
+            QBPLOGW(QString(QStringLiteral("journal %1 is truncated, restoring the %2 complete entries")).arg(journalFile).arg(entries.length()));
+            break;
+        }
+        entries << e;
+    }
+
+    QDir qtDir(ArgumentsAndSettings::qtDir().isEmpty() ? qtDirPath : QDir(ArgumentsAndSettings::qtDir()).absolutePath());
+    QBPLOGV(QString(QStringLiteral("undo: QtDir: %1, %2 entries")).arg(qtDir.absolutePath()).arg(entries.length()));
+
+    return replay(entries, qtDir);
 }
@@ -3,20 +3,33 @@
 #ifndef QQBPBACKUP_H
 #define QQBPBACKUP_H
 
+#include <QByteArray>
 #include <QString>
 
 struct BackupPrivate;
 
+// Journal of the changes made during patching, which is replayed backwards to restore the files.
+// Only what is going to be changed is recorded: the old bytes of the rewritten ranges of binaries,
+// and the compressed original content of text files.
 class Backup
 {
 public:
     Backup();
     ~Backup();
 
+    // records the whole file before it is modified or removed
     bool backupOneFile(const QString &pathRelativeToQtDir);
+    // same as above, with the content already read by the patcher
+    bool backupContent(const QString &pathRelativeToQtDir, const QByteArray &content);
+    // records the bytes at offset which are going to be overwritten
+    bool backupRange(const QString &pathRelativeToQtDir, qint64 offset, const QByteArray &oldBytes);
+
     bool restoreAll();
     void destroy();
 
+    // restores the files recorded in the journal kept by a previous run
+    static bool undo(const QString &journalFile);
+
 private:
     Q_DISABLE_COPY(Backup)
     BackupPrivate *d;
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "batch.h"
+#include "argument.h"
+#include "log.h"
+#include "patch.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+
+#include <cstdio>
+
+namespace {
+
+struct KitResult
+{
+    QString name;
+    QString qtDir;
+    QString status;
+    bool success;
+    qint64 msecs;
+};
+
+// Patches the kit whose settings are already applied. Same procedure as a single run from main().
+void runKit(KitResult *result)
+{
+    try {
+        prepare();
+        warnAboutUnsupportedQtVersion();
+
+        if (!exitWhenSpacesExist()) {
+            result->status = QStringLiteral("failed: spaces in path");
+            result->success = false;
+        } else if (shouldForce() && !ArgumentsAndSettings::force()) {
+            result->status = QStringLiteral("skipped: already at new dir, use force to patch again");
+            result->success = true;
+        } else {
+            result->success = patch();
+            result->status = result->success ? QStringLiteral("success") : QStringLiteral("failed, backup restored");
+        }
+    } catch (const QbpFatalError &e) {
+        result->status = QStringLiteral("failed: ") + e.message;
+        result->success = false;
+    }
+
+    cleanup();
+}
+
+}
+
+bool runBatch(const QString &batchFile)
+{
+    QFile f(batchFile);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        QBPLOGE(QString(QStringLiteral("Unable to open batch file %1")).arg(batchFile));
+        return false;
+    }
+
+    QJsonParseError err;
+    QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &err);
+    if (err.error != QJsonParseError::NoError || !doc.isObject() || !doc.object().value(QStringLiteral("kits")).isArray()) {
+        QBPLOGE(QString(QStringLiteral("Batch file %1 is not an object with array \"kits\": %2")).arg(batchFile).arg(err.errorString()));
+        return false;
+    }
+
+    QDir baseDir = QFileInfo(f).absoluteDir();
+    QJsonArray kits = doc.object().value(QStringLiteral("kits")).toArray();
+    QList<KitResult> results;
+
+    // fatal errors of a kit fail only that kit
+    QbpLog::instance().setThrowOnFatal(true);
+    for (int i = 0; i < kits.size(); ++i) {
+        QJsonObject kit = kits.at(i).toObject();
+        KitResult result;
+        result.name = kit.value(QStringLiteral("name")).toString(QString::number(i + 1));
+        // the name is used as the subdir of the backup dir
+        QString backupName = QFileInfo(result.name).fileName() == result.name ? result.name : QString::number(i + 1);
+
+        ArgumentsAndSettings::applyKit(kit, baseDir, backupName);
+        result.qtDir = ArgumentsAndSettings::qtDir();
+        QBPLOGV(QString(QStringLiteral("Batch: kit %1 (%2/%3), QtDir: %4")).arg(result.name).arg(i + 1).arg(kits.size()).arg(result.qtDir));
+
+        QElapsedTimer timer;
+        timer.start();
+        runKit(&result);
+        result.msecs = timer.elapsed();
+
+        results << result;
+    }
+    QbpLog::instance().setThrowOnFatal(false);
+
+    bool r = true;
+    int succeeded = 0;
+    // the summary goes after everything logged while patching
+    QbpLog::instance().flush();
+    ::printf("Batch summary:\n");
+    foreach (const KitResult &result, results) {
+        QString line = QString(QStringLiteral("  [%1] %2 (%3 ms): %4")).arg(result.name).arg(result.qtDir).arg(result.msecs).arg(result.status);
+        QBPLOGV(line);
+        ::printf("%s\n", line.toLocal8Bit().constData());
+        if (result.success)
+            ++succeeded;
+        else
+            r = false;
+    }
+    ::printf("%d of %d kits succeeded.\n", succeeded, results.length());
+    ::fflush(stdout);
+
+    return r;
+}
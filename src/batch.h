@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPBATCH_H
+#define QQBPBATCH_H
+
+#include <QString>
+
+// Patches all kits listed in the batch file in this process, one after another, and prints a summary.
+// Returns true if all kits succeeded.
+bool runBatch(const QString &batchFile);
+
+#endif
@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "commit.h"
+#include "argument.h"
+#include "backup.h"
+#include "log.h"
+#include "manifest.h"
+#include "trace.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStringList>
+#include <QTemporaryFile>
+
+#include <cstdio>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+QMutex mutex;
+// absolute paths of the files committed but not synced yet
+QStringList committedFiles;
+
+bool replaceFile(const QString &from, const QString &to)
+{
+    // QFile::rename refuses to overwrite
+#ifdef Q_OS_WIN
+    return ::MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(from).utf16()), reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(to).utf16()),
+                         MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)
+        != 0;
+#else
+    return ::rename(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+}
+
+bool syncFile(const QString &fileName)
+{
+#ifdef Q_OS_WIN
+    QFile f(fileName);
+    return f.open(QIODevice::ReadWrite) && ::_commit(f.handle()) == 0;
+#else
+    // also used for directories, which QFile can't open
+    int fd = ::open(QFile::encodeName(fileName).constData(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    bool r = ::fsync(fd) == 0;
+    ::close(fd);
+    return r;
+#endif
+}
+
+#ifdef Q_OS_LINUX
+// one syncfs for the filesystem containing Qt dir, instead of one fsync per file
+bool syncFileSystem(const QString &dir)
+{
+    int fd = ::open(QFile::encodeName(dir).constData(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1)
+        return false;
+    bool r = ::syncfs(fd) == 0;
+    ::close(fd);
+    return r;
+}
+#endif
+
+}
+
+bool commitFile(Backup &backup, const QString &pathRelativeToQtDir, const QByteArray &original, const QByteArray &patched)
+{
+    // the content is in memory anyway, so the manifest does not need to read the file again
+    Manifest::setContentHash(pathRelativeToQtDir, Manifest::hashOf(patched));
+
+    if (patched == original) {
+        QBPLOGV([&]() { return QString(QStringLiteral("%1 is unchanged, not written")).arg(pathRelativeToQtDir); });
+        return true;
+    }
+
+    if (!backup.backupContent(pathRelativeToQtDir, original))
+        return false;
+
+    TraceSpan span("io", "commitFile", pathRelativeToQtDir);
+    span.setBytes(patched.size());
+
+    QString target = QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(pathRelativeToQtDir);
+    QTemporaryFile tmp(target + QStringLiteral(".qbp.XXXXXX"));
+    tmp.setAutoRemove(false);
+    if (!tmp.open()) {
+        QBPLOGE(QString(QStringLiteral("Unable to create temporary file for %1")).arg(target));
+        return false;
+    }
+
+    QString tmpName = tmp.fileName();
+    bool r = tmp.write(patched) == patched.size();
+    tmp.close();
+    // QTemporaryFile is created with owner-only permissions
+    r = r && QFile::setPermissions(tmpName, QFileInfo(target).permissions()) && replaceFile(tmpName, target);
+    if (!r) {
+        QFile::remove(tmpName);
+        QBPLOGE(QString(QStringLiteral("Unable to write %1")).arg(target));
+        return false;
+    }
+
+    QMutexLocker locker(&mutex);
+    committedFiles << target;
+    return true;
+}
+
+bool syncCommittedFiles()
+{
+    QMutexLocker locker(&mutex);
+    if (committedFiles.isEmpty())
+        return true;
+
+    bool r = true;
+#ifdef Q_OS_LINUX
+    if (syncFileSystem(ArgumentsAndSettings::qtDir())) {
+        QBPLOGV(QString(QStringLiteral("synced %1 committed files using syncfs")).arg(committedFiles.length()));
+        committedFiles.clear();
+        return true;
+    }
+#endif
+
+    QSet<QString> dirs;
+    foreach (const QString &file, committedFiles) {
+        r = syncFile(file) && r;
+        dirs.insert(QFileInfo(file).absolutePath());
+    }
+#ifndef Q_OS_WIN
+    // the renames are only durable once the dirs are synced
+    foreach (const QString &dir, dirs)
+        r = syncFile(dir) && r;
+#endif
+
+    QBPLOGV(QString(QStringLiteral("synced %1 committed files in %2 dirs")).arg(committedFiles.length()).arg(dirs.size()));
+    committedFiles.clear();
+    return r;
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPCOMMIT_H
+#define QQBPCOMMIT_H
+
+#include <QByteArray>
+#include <QString>
+
+class Backup;
+
+// Replaces the content of a text file in Qt dir with the patched one.
+// Nothing is written if the content is unchanged. Otherwise the original content is journaled, the patched content is written to a temporary file
+// in the same dir, which then replaces the original file by renaming, so the file is never left half-written.
+// Files are not synced to disk here, see syncCommittedFiles().
+bool commitFile(Backup &backup, const QString &pathRelativeToQtDir, const QByteArray &original, const QByteArray &patched);
+
+// Syncs all files committed so far to disk at once. Called at the end of step4.
+bool syncCommittedFiles();
+
+#endif
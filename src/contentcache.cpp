@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "contentcache.h"
+#include "log.h"
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+
+struct ContentCachePrivate
+{
+    struct Entry
+    {
+        QByteArray content;
+        quint64 lastUse;
+    };
+
+    QMutex mutex;
+    QHash<QString, Entry> entries;
+    // lastUse -> fileName, the first one is the least recently used
+    QMap<quint64, QString> useOrder;
+    quint64 useCounter;
+    qint64 used;
+
+    qint64 budget;
+    qint64 maxFileSize;
+
+    ContentCachePrivate()
+        : useCounter(0)
+        , used(0)
+        , budget(64 * 1024 * 1024)
+        , maxFileSize(4 * 1024 * 1024)
+    {
+    }
+
+    void touch(const QString &fileName, Entry &e)
+    {
+        useOrder.remove(e.lastUse);
+        e.lastUse = ++useCounter;
+        useOrder.insert(e.lastUse, fileName);
+    }
+
+    void remove(const QString &fileName)
+    {
+        QHash<QString, Entry>::iterator it = entries.find(fileName);
+        if (it == entries.end())
+            return;
+
+        used -= it->content.size();
+        useOrder.remove(it->lastUse);
+        entries.erase(it);
+    }
+
+    void insert(const QString &fileName, const QByteArray &content)
+    {
+        if (content.size() > maxFileSize || content.size() > budget)
+            return;
+
+        while (used + content.size() > budget && !useOrder.isEmpty()) {
+            QString evicted = useOrder.first();
+            QBPLOGV([&]() { return QString(QStringLiteral("ContentCache: evicting %1")).arg(evicted); });
+            remove(evicted);
+        }
+
+        Entry e;
+        e.content = content;
+        e.lastUse = ++useCounter;
+        entries.insert(fileName, e);
+        useOrder.insert(e.lastUse, fileName);
+        used += content.size();
+    }
+};
+
+namespace {
+bool readFromDisk(const QString &fileName, qint64 maxFileSize, QByteArray *content, bool *cacheable)
+{
+    QFile f(fileName);
+    if (!f.exists() || !f.open(QIODevice::ReadOnly))
+        return false;
+
+    *cacheable = f.size() <= maxFileSize;
+    *content = f.readAll();
+    f.close();
+    return true;
+}
+}
+
+ContentCache::ContentCache()
+    : d(new ContentCachePrivate)
+{
+}
+
+ContentCache::~ContentCache()
+{
+    delete d;
+}
+
+bool ContentCache::read(const QString &fileName_, QByteArray *content)
+{
+    QString fileName = QDir::cleanPath(fileName_);
+
+    {
+        QMutexLocker locker(&d->mutex);
+        QHash<QString, ContentCachePrivate::Entry>::iterator it = d->entries.find(fileName);
+        if (it != d->entries.end()) {
+            d->touch(fileName, *it);
+            *content = it->content;
+            return true;
+        }
+    }
+
+    bool cacheable = false;
+    if (!readFromDisk(fileName, d->maxFileSize, content, &cacheable))
+        return false;
+
+    if (cacheable) {
+        QMutexLocker locker(&d->mutex);
+        if (!d->entries.contains(fileName))
+            d->insert(fileName, *content);
+    } else
+        QBPLOGV([&]() { return QString(QStringLiteral("ContentCache: %1 is too large to be cached")).arg(fileName); });
+
+    return true;
+}
+
+bool ContentCache::take(const QString &fileName_, QByteArray *content)
+{
+    QString fileName = QDir::cleanPath(fileName_);
+
+    {
+        QMutexLocker locker(&d->mutex);
+        QHash<QString, ContentCachePrivate::Entry>::iterator it = d->entries.find(fileName);
+        if (it != d->entries.end()) {
+            *content = it->content;
+            d->remove(fileName);
+            return true;
+        }
+    }
+
+    bool cacheable = false;
+    return readFromDisk(fileName, d->maxFileSize, content, &cacheable);
+}
+
+void ContentCache::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->entries.clear();
+    d->useOrder.clear();
+    d->used = 0;
+}
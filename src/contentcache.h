@@ -0,0 +1,30 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPCONTENTCACHE_H
+#define QQBPCONTENTCACHE_H
+
+#include <QByteArray>
+#include <QString>
+
+struct ContentCachePrivate;
+
+// Keeps the content of text files read by shouldPatch() during step3, so that patchFile() in step4 does not read them again.
+// Least recently used files are evicted when the budget is exceeded. Files larger than maxFileSize are never cached.
+class ContentCache
+{
+public:
+    ContentCache();
+    ~ContentCache();
+
+    // Returns the content from cache, or reads the file and caches its content.
+    bool read(const QString &fileName, QByteArray *content);
+    // Returns the content and removes it from cache, or reads the file without caching.
+    bool take(const QString &fileName, QByteArray *content);
+    void clear();
+
+private:
+    Q_DISABLE_COPY(ContentCache)
+    ContentCachePrivate *d;
+};
+
+#endif
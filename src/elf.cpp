@@ -0,0 +1,259 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "elf.h"
+#include <QPair>
+#include <QtEndian>
+
+namespace {
+
+// from <elf.h>
+const int EI_CLASS = 4;
+const int EI_DATA = 5;
+const char ELFCLASS32 = 1;
+const char ELFCLASS64 = 2;
+const char ELFDATA2LSB = 1;
+const char ELFDATA2MSB = 2;
+
+const quint32 SHT_NOBITS = 8;
+
+const quint32 PT_LOAD = 1;
+const quint32 PT_DYNAMIC = 2;
+
+const quint64 DT_NULL = 0;
+const quint64 DT_STRTAB = 5;
+const quint64 DT_STRSZ = 10;
+const quint64 DT_RPATH = 15;
+const quint64 DT_RUNPATH = 29;
+
+struct Reader
+{
+    const char *data;
+    qint64 size;
+    bool is64;
+    bool bigEndian;
+
+    bool inBounds(quint64 offset, quint64 length) const
+    {
+        return offset <= static_cast<quint64>(size) && length <= static_cast<quint64>(size) - offset;
+    }
+
+    quint16 u16(quint64 offset) const
+    {
+        const uchar *u = reinterpret_cast<const uchar *>(data + offset);
+        return bigEndian ? qFromBigEndian<quint16>(u) : qFromLittleEndian<quint16>(u);
+    }
+
+    quint32 u32(quint64 offset) const
+    {
+        const uchar *u = reinterpret_cast<const uchar *>(data + offset);
+        return bigEndian ? qFromBigEndian<quint32>(u) : qFromLittleEndian<quint32>(u);
+    }
+
+    quint64 u64(quint64 offset) const
+    {
+        const uchar *u = reinterpret_cast<const uchar *>(data + offset);
+        return bigEndian ? qFromBigEndian<quint64>(u) : qFromLittleEndian<quint64>(u);
+    }
+
+    // Elf32_Addr, Elf32_Off and Elf32_Word or their 64 bit counterparts
+    quint64 word(quint64 offset) const
+    {
+        return is64 ? u64(offset) : u32(offset);
+    }
+};
+
+// e_ident, checks the magic and sets the class and byte order
+bool readHeader(const char *data, qint64 size, Reader *r)
+{
+    if (size < 52 || data[0] != '\x7f' || data[1] != 'E' || data[2] != 'L' || data[3] != 'F')
+        return false;
+
+    r->data = data;
+    r->size = size;
+    if (data[EI_CLASS] == ELFCLASS64)
+        r->is64 = true;
+    else if (data[EI_CLASS] == ELFCLASS32)
+        r->is64 = false;
+    else
+        return false;
+    if (data[EI_DATA] == ELFDATA2MSB)
+        r->bigEndian = true;
+    else if (data[EI_DATA] == ELFDATA2LSB)
+        r->bigEndian = false;
+    else
+        return false;
+
+    return !r->is64 || size >= 64;
+}
+
+struct Segment
+{
+    quint32 type;
+    quint64 offset;
+    quint64 vaddr;
+    quint64 filesz;
+};
+
+}
+
+bool Elf::readRunPaths(const char *data, qint64 size, QVector<RunPath> *paths)
+{
+    paths->clear();
+
+    Reader r;
+    if (!readHeader(data, size, &r))
+        return false;
+
+    // Elf32_Ehdr / Elf64_Ehdr
+    quint64 phoff = r.is64 ? r.u64(0x20) : r.u32(0x1c);
+    quint16 phentsize = r.u16(r.is64 ? 0x36 : 0x2a);
+    quint16 phnum = r.u16(r.is64 ? 0x38 : 0x2c);
+    quint16 minimumPhentsize = r.is64 ? 56 : 32;
+    if (phnum == 0)
+        return true;
+    if (phentsize < minimumPhentsize || !r.inBounds(phoff, static_cast<quint64>(phentsize) * phnum))
+        return false;
+
+    // Elf32_Phdr / Elf64_Phdr, whose members are in different orders
+    QVector<Segment> segments;
+    for (quint16 i = 0; i < phnum; ++i) {
+        quint64 p = phoff + static_cast<quint64>(i) * phentsize;
+        Segment s;
+        s.type = r.u32(p);
+        if (r.is64) {
+            s.offset = r.u64(p + 8);
+            s.vaddr = r.u64(p + 16);
+            s.filesz = r.u64(p + 32);
+        } else {
+            s.offset = r.u32(p + 4);
+            s.vaddr = r.u32(p + 8);
+            s.filesz = r.u32(p + 16);
+        }
+        segments << s;
+    }
+
+    foreach (const Segment &dynamic, segments) {
+        if (dynamic.type != PT_DYNAMIC || dynamic.filesz == 0)
+            continue;
+        if (!r.inBounds(dynamic.offset, dynamic.filesz))
+            return false;
+
+        // Elf32_Dyn / Elf64_Dyn
+        typedef QPair<quint64, quint64> TagValuePair;
+        quint64 entrySize = r.is64 ? 16 : 8;
+        quint64 strtab = 0;
+        quint64 strsz = 0;
+        QVector<TagValuePair> found;
+        for (quint64 p = dynamic.offset; p + entrySize <= dynamic.offset + dynamic.filesz; p += entrySize) {
+            quint64 tag = r.word(p);
+            quint64 value = r.word(p + entrySize / 2);
+            if (tag == DT_NULL)
+                break;
+            if (tag == DT_STRTAB)
+                strtab = value;
+            else if (tag == DT_STRSZ)
+                strsz = value;
+            else if (tag == DT_RPATH || tag == DT_RUNPATH)
+                found << qMakePair(tag, value);
+        }
+        if (found.isEmpty())
+            continue;
+
+        // DT_STRTAB is an address, find it in the file through the loaded segments
+        quint64 strtabOffset = 0;
+        bool mapped = false;
+        foreach (const Segment &load, segments) {
+            if (load.type == PT_LOAD && strtab >= load.vaddr && strtab - load.vaddr < load.filesz) {
+                strtabOffset = load.offset + (strtab - load.vaddr);
+                mapped = true;
+                break;
+            }
+        }
+        if (!mapped || !r.inBounds(strtabOffset, strsz))
+            return false;
+
+        foreach (const TagValuePair &i, found) {
+            if (i.second >= strsz)
+                return false;
+
+            RunPath path;
+            path.runPath = (i.first == DT_RUNPATH);
+            path.offset = static_cast<qint64>(strtabOffset + i.second);
+            const char *s = data + path.offset;
+            path.value = QByteArray(s, static_cast<int>(qstrnlen(s, static_cast<uint>(strsz - i.second))));
+            *paths << path;
+        }
+    }
+
+    return true;
+}
+
+QByteArray Elf::rewritten(const RunPath &path, const QByteArray &newValue)
+{
+    if (newValue.length() > path.value.length())
+        return QByteArray();
+
+    QByteArray r = newValue;
+    r.append(QByteArray(path.value.length() - newValue.length(), '\0'));
+    return r;
+}
+
+bool Elf::readSections(const char *data, qint64 size, QVector<Section> *sections)
+{
+    sections->clear();
+
+    Reader r;
+    if (!readHeader(data, size, &r))
+        return false;
+
+    quint64 shoff = r.is64 ? r.u64(0x28) : r.u32(0x20);
+    quint16 shentsize = r.u16(r.is64 ? 0x3a : 0x2e);
+    quint16 shnum = r.u16(r.is64 ? 0x3c : 0x30);
+    quint16 shstrndx = r.u16(r.is64 ? 0x3e : 0x32);
+    quint16 minimumShentsize = r.is64 ? 64 : 40;
+    // stripped of section headers, or more than SHN_LORESERVE sections
+    if (shnum == 0 || shstrndx >= shnum)
+        return true;
+    if (shentsize < minimumShentsize || !r.inBounds(shoff, static_cast<quint64>(shentsize) * shnum))
+        return false;
+
+    // Elf32_Shdr / Elf64_Shdr
+    struct Header
+    {
+        quint32 name;
+        quint32 type;
+        quint64 offset;
+        quint64 size;
+    };
+    QVector<Header> headers;
+    for (quint16 i = 0; i < shnum; ++i) {
+        quint64 p = shoff + static_cast<quint64>(i) * shentsize;
+        Header h;
+        h.name = r.u32(p);
+        h.type = r.u32(p + 4);
+        h.offset = r.is64 ? r.u64(p + 24) : r.u32(p + 16);
+        h.size = r.is64 ? r.u64(p + 32) : r.u32(p + 20);
+        headers << h;
+    }
+
+    const Header &names = headers.at(shstrndx);
+    if (!r.inBounds(names.offset, names.size))
+        return false;
+
+    foreach (const Header &h, headers) {
+        // .bss and the like take no room in the file
+        if (h.type == SHT_NOBITS || h.size == 0)
+            continue;
+        if (h.name >= names.size || !r.inBounds(h.offset, h.size))
+            return false;
+
+        Section section;
+        const char *name = data + names.offset + h.name;
+        section.name = QByteArray(name, static_cast<int>(qstrnlen(name, static_cast<uint>(names.size - h.name))));
+        section.offset = static_cast<qint64>(h.offset);
+        section.size = static_cast<qint64>(h.size);
+        *sections << section;
+    }
+
+    return true;
+}
@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPELF_H
+#define QQBPELF_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Reads the run paths in the dynamic section and the section table of ELF files, so they are changed without patchelf or chrpath.
+// 32 and 64 bit files of both byte orders are read.
+namespace Elf {
+
+struct RunPath
+{
+    // DT_RPATH or DT_RUNPATH
+    bool runPath;
+    // offset of the string in the file, within the string table of the dynamic section
+    qint64 offset;
+    // colon separated, its length is the room available for a new value
+    QByteArray value;
+};
+
+// Returns false if data is not an ELF file, or its headers or dynamic section are out of bounds.
+// Files without a dynamic section, such as static executables and separated debug info, have no run paths.
+bool readRunPaths(const char *data, qint64 size, QVector<RunPath> *paths);
+
+struct Section
+{
+    QByteArray name;
+    // where the content is in the file
+    qint64 offset;
+    qint64 size;
+};
+
+// The sections having content in the file, in the order of the section table. Files stripped of the section table have none.
+// Returns false if data is not an ELF file, or a section is out of bounds.
+bool readSections(const char *data, qint64 size, QVector<Section> *sections);
+
+// The bytes to be written at path.offset to change its value to newValue: newValue padded with '\0' to the length of the old value.
+// Empty if newValue is longer, as the string table can't grow without moving the following data.
+QByteArray rewritten(const RunPath &path, const QByteArray &newValue);
+
+}
+
+#endif
@@ -0,0 +1,228 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "fileindex.h"
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QVector>
+
+#include <algorithm>
+
+struct FileIndexPrivate
+{
+    QDir qtDir;
+    QSet<QString> roots;
+
+    QMutex mutex;
+    QVector<FileIndexEntry> entries;
+    QHash<QString, int> byPath;
+    // key is the path of the directory, "" for the top level of the Qt dir
+    QHash<QString, QVector<int>> children;
+
+    void add(const QString &dir, const QVector<FileIndexEntry> &found)
+    {
+        QMutexLocker locker(&mutex);
+        QVector<int> &c = children[dir];
+        foreach (const FileIndexEntry &e, found) {
+            int i = entries.size();
+            entries << e;
+            byPath[e.path] = i;
+            c << i;
+        }
+    }
+
+    bool accept(const FileIndexEntry &e, const QStringList &nameFilters, FileIndex::Filters filters) const
+    {
+        if (filters.testFlag(FileIndex::NoSymLinks) && e.symLink)
+            return false;
+        if (!((filters.testFlag(FileIndex::Files) && e.type == FileIndexEntry::File) || (filters.testFlag(FileIndex::Dirs) && e.type == FileIndexEntry::Dir)))
+            return false;
+        if (nameFilters.isEmpty())
+            return true;
+        foreach (const QString &f, nameFilters) {
+            if (FileIndex::wildcardMatch(f, e.name))
+                return true;
+        }
+        return false;
+    }
+
+    void collect(const QString &dir, const QStringList &nameFilters, FileIndex::Filters filters, bool recursive, QStringList &r) const
+    {
+        foreach (int i, children.value(dir)) {
+            const FileIndexEntry &e = entries.at(i);
+            if (accept(e, nameFilters, filters))
+                r << e.path;
+            if (recursive && e.type == FileIndexEntry::Dir && !e.symLink)
+                collect(e.path, nameFilters, filters, true, r);
+        }
+    }
+};
+
+namespace {
+
+// Lists one directory, and starts a new job for each subdirectory, so the whole walk spreads over the pool.
+// Symlinked directories are recorded but not followed.
+class DirWalkJob : public QRunnable
+{
+public:
+    DirWalkJob(FileIndexPrivate *d, QThreadPool *pool, const QString &relativeDir)
+        : d(d)
+        , pool(pool)
+        , relativeDir(relativeDir)
+    {
+    }
+
+    void run() override
+    {
+        QDir dir(d->qtDir.absoluteFilePath(relativeDir));
+        QFileInfoList l = dir.entryInfoList(QDir::AllEntries | QDir::System | QDir::Hidden | QDir::NoDotAndDotDot, QDir::NoSort);
+
+        QVector<FileIndexEntry> found;
+        found.reserve(l.size());
+        foreach (const QFileInfo &fi, l) {
+            FileIndexEntry e;
+            e.name = fi.fileName();
+            e.path = relativeDir.isEmpty() ? e.name : (relativeDir + QLatin1Char('/') + e.name);
+            e.symLink = fi.isSymLink();
+            if (fi.isDir())
+                e.type = FileIndexEntry::Dir;
+            else if (fi.isFile()) {
+                e.type = FileIndexEntry::File;
+                e.size = fi.size();
+            }
+
+            if (e.type == FileIndexEntry::Dir && !e.symLink && (!relativeDir.isEmpty() || d->roots.contains(e.name)))
+                pool->start(new DirWalkJob(d, pool, e.path));
+
+            found << e;
+        }
+
+        d->add(relativeDir, found);
+    }
+
+private:
+    FileIndexPrivate *d;
+    QThreadPool *pool;
+    QString relativeDir;
+};
+
+QString cleanRelativeDir(const QString &dir)
+{
+    QString r = QDir::fromNativeSeparators(dir);
+    while (r.endsWith(QLatin1Char('/')))
+        r.chop(1);
+    if (r == QStringLiteral("."))
+        r.clear();
+    return r;
+}
+
+}
+
+FileIndex::FileIndex()
+    : d(new FileIndexPrivate)
+{
+}
+
+FileIndex::~FileIndex()
+{
+    delete d;
+}
+
+void FileIndex::build(const QString &qtDir, const QStringList &roots)
+{
+    clear();
+
+    d->qtDir = QDir(qtDir);
+    foreach (const QString &root, roots)
+        d->roots.insert(root);
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    pool->start(new DirWalkJob(d, pool, QString()));
+    pool->waitForDone();
+}
+
+void FileIndex::clear()
+{
+    d->roots.clear();
+    d->entries.clear();
+    d->byPath.clear();
+    d->children.clear();
+}
+
+const FileIndexEntry *FileIndex::entry(const QString &path) const
+{
+    QHash<QString, int>::const_iterator it = d->byPath.constFind(cleanRelativeDir(path));
+    if (it == d->byPath.constEnd())
+        return nullptr;
+
+    return &d->entries.at(it.value());
+}
+
+bool FileIndex::exists(const QString &path) const
+{
+    // like QDir::exists, broken symlinks are treated as non-existent
+    const FileIndexEntry *e = entry(path);
+    return e != nullptr && e->type != FileIndexEntry::Other;
+}
+
+bool FileIndex::isFile(const QString &path) const
+{
+    const FileIndexEntry *e = entry(path);
+    return e != nullptr && e->type == FileIndexEntry::File;
+}
+
+bool FileIndex::isDir(const QString &path) const
+{
+    const FileIndexEntry *e = entry(path);
+    return e != nullptr && e->type == FileIndexEntry::Dir;
+}
+
+QStringList FileIndex::entryList(const QString &dir, const QStringList &nameFilters, Filters filters, bool recursive) const
+{
+    QStringList r;
+    d->collect(cleanRelativeDir(dir), nameFilters, filters, recursive, r);
+    std::sort(r.begin(), r.end());
+    return r;
+}
+
+QList<const FileIndexEntry *> FileIndex::select(const std::function<bool(const FileIndexEntry &)> &predicate) const
+{
+    QList<const FileIndexEntry *> r;
+    for (QVector<FileIndexEntry>::const_iterator it = d->entries.constBegin(); it != d->entries.constEnd(); ++it) {
+        if (predicate(*it))
+            r << &(*it);
+    }
+    return r;
+}
+
+bool FileIndex::wildcardMatch(const QString &pattern, const QString &name)
+{
+    // supports '*' and '?', case insensitive
+    int p = 0;
+    int n = 0;
+    int starP = -1;
+    int starN = 0;
+    while (n < name.length()) {
+        if (p < pattern.length() && pattern.at(p) == QLatin1Char('*')) {
+            starP = p++;
+            starN = n;
+        } else if (p < pattern.length() && (pattern.at(p) == QLatin1Char('?') || pattern.at(p).toCaseFolded() == name.at(n).toCaseFolded())) {
+            ++p;
+            ++n;
+        } else if (starP != -1) {
+            p = starP + 1;
+            n = ++starN;
+        } else
+            return false;
+    }
+
+    while (p < pattern.length() && pattern.at(p) == QLatin1Char('*'))
+        ++p;
+
+    return p == pattern.length();
+}
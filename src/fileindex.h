@@ -0,0 +1,76 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPFILEINDEX_H
+#define QQBPFILEINDEX_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+struct FileIndexEntry
+{
+    enum Type
+    {
+        File,
+        Dir,
+        Other // broken symlinks, sockets, etc.
+    };
+
+    QString name;
+    // relative to Qt dir, separated by '/'
+    QString path;
+    qint64 size;
+    Type type;
+    bool symLink;
+
+    FileIndexEntry()
+        : size(0)
+        , type(Other)
+        , symLink(false)
+    {
+    }
+};
+
+struct FileIndexPrivate;
+
+// In-memory index of the Qt dir, built by one parallel directory walk in step3.
+// Patchers query the index instead of listing directories by themselves.
+class FileIndex
+{
+public:
+    enum Filter
+    {
+        Files = 0x1,
+        Dirs = 0x2,
+        NoSymLinks = 0x4
+    };
+    Q_DECLARE_FLAGS(Filters, Filter)
+
+    FileIndex();
+    ~FileIndex();
+
+    // Only the top level of qtDir and the subtrees named in roots are walked, using the global thread pool.
+    void build(const QString &qtDir, const QStringList &roots);
+    void clear();
+
+    const FileIndexEntry *entry(const QString &path) const;
+    bool exists(const QString &path) const;
+    bool isFile(const QString &path) const;
+    bool isDir(const QString &path) const;
+
+    // name filters are wildcards matched case insensitively, like QDir::setNameFilters
+    QStringList entryList(const QString &dir, const QStringList &nameFilters, Filters filters, bool recursive = false) const;
+    QList<const FileIndexEntry *> select(const std::function<bool(const FileIndexEntry &)> &predicate) const;
+
+    static bool wildcardMatch(const QString &pattern, const QString &name);
+
+private:
+    Q_DISABLE_COPY(FileIndex)
+    FileIndexPrivate *d;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(FileIndex::Filters)
+
+#endif
@@ -1,20 +1,213 @@
 // SPDX-License-Identifier: Unlicense
 
 #include "log.h"
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include <QDebug>
 #include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QThread>
+
+namespace {
+
+struct LogRecord
+{
+    enum Kind
+    {
+        Message,
+        // written when reached, releases done
+        Flush,
+        // ends the writer thread
+        Stop
+    };
+
+    explicit LogRecord(Kind kind = Message)
+        : kind(kind)
+        , level(QbpLog::Verbose)
+        , done(nullptr)
+        , next(nullptr)
+    {
+    }
+
+    Kind kind;
+    QbpLog::LogLevel level;
+    QString message;
+    QSemaphore *done;
+    QAtomicPointer<LogRecord> next;
+};
+
+// Intrusive multiple producer single consumer queue by Dmitry Vyukov.
+// push() is lock free and may be called from any thread, pop() is only called from the writer thread.
+class LogQueue
+{
+public:
+    LogQueue()
+        : head(&stub)
+        , tail(&stub)
+    {
+    }
+
+    void push(LogRecord *r)
+    {
+        r->next.storeRelease(nullptr);
+        LogRecord *prev = head.fetchAndStoreOrdered(r);
+        prev->next.storeRelease(r);
+    }
+
+    // nullptr if the queue is empty or the last push() has not linked its record yet
+    LogRecord *pop()
+    {
+        LogRecord *t = tail;
+        LogRecord *next = t->next.loadAcquire();
+        if (t == &stub) {
+            if (next == nullptr)
+                return nullptr;
+            tail = next;
+            t = next;
+            next = next->next.loadAcquire();
+        }
+
+        if (next != nullptr) {
+            tail = next;
+            return t;
+        }
+
+        if (t != head.loadAcquire())
+            return nullptr;
+
+        push(&stub);
+        next = t->next.loadAcquire();
+        if (next != nullptr) {
+            tail = next;
+            return t;
+        }
+
+        return nullptr;
+    }
+
+private:
+    Q_DISABLE_COPY(LogQueue)
+    LogRecord stub;
+    QAtomicPointer<LogRecord> head;
+    LogRecord *tail;
+};
+
+}
 
 struct QbpLogPrivate
 {
     QFile f;
-    bool verbose;
+    // guards f, which is written by the writer thread and reopened by setLogFile()
+    QMutex mutex;
+    QAtomicInt verbose;
+    QAtomicInt fileOpen;
+    bool throwOnFatal;
+
+    LogQueue queue;
+    // one for each record in queue
+    QSemaphore pending;
+    QThread *writer;
 
     QbpLogPrivate()
-        : verbose(false)
+        : verbose(0)
+        , fileOpen(0)
+        , throwOnFatal(false)
+        , writer(nullptr)
+    {
+    }
+
+    void enqueue(LogRecord *r)
+    {
+        queue.push(r);
+        pending.release();
+    }
+
+    void write(const LogRecord *r);
+    void writerMain();
+};
+
+namespace {
+
+class LogWriter : public QThread
+{
+public:
+    explicit LogWriter(QbpLogPrivate *d)
+        : d(d)
     {
     }
+
+protected:
+    void run() override
+    {
+        d->writerMain();
+    }
+
+private:
+    QbpLogPrivate *d;
 };
 
+}
+
+void QbpLogPrivate::write(const LogRecord *r)
+{
+    static const QStringList logLevelStr {QStringLiteral("Verbose"), QStringLiteral("Warning"), QStringLiteral("Error"), QStringLiteral("Fatal")};
+    switch (r->level) {
+    case QbpLog::Verbose:
+        if (verbose.loadAcquire() != 0)
+            qDebug("%s", r->message.toUtf8().constData());
+        break;
+    case QbpLog::Warning:
+        qWarning("%s", r->message.toUtf8().constData());
+        break;
+    case QbpLog::Error:
+        qCritical("%s", r->message.toUtf8().constData());
+        break;
+    default:
+        // fatal errors are output by the thread raising them, after flush()
+        break;
+    }
+
+    QMutexLocker locker(&mutex);
+    if (f.isOpen())
+        f.write(QString(QStringLiteral("%1: %2\n")).arg(logLevelStr.value(static_cast<int>(r->level))).arg(r->message).toUtf8());
+}
+
+void QbpLogPrivate::writerMain()
+{
+    forever {
+        pending.acquire();
+
+        // a record pushed at the same time by another thread may block the queue until it is linked, which is a matter of instructions
+        LogRecord *r;
+        while ((r = queue.pop()) == nullptr)
+            QThread::yieldCurrentThread();
+
+        LogRecord::Kind kind = r->kind;
+        if (kind == LogRecord::Message) {
+            write(r);
+        } else {
+            QMutexLocker locker(&mutex);
+            if (f.isOpen())
+                f.flush();
+            if (r->done != nullptr)
+                r->done->release();
+        }
+        delete r;
+
+        if (kind == LogRecord::Stop)
+            return;
+
+        // keep the file reasonably up to date without flushing on every record
+        if (pending.available() == 0) {
+            QMutexLocker locker(&mutex);
+            if (f.isOpen())
+                f.flush();
+        }
+    }
+}
+
 QbpLog &QbpLog::instance()
 {
     static QbpLog l;
@@ -23,6 +216,10 @@ QbpLog &QbpLog::instance()
 
 QbpLog::~QbpLog()
 {
+    d->enqueue(new LogRecord(LogRecord::Stop));
+    d->writer->wait();
+    delete d->writer;
+
     if (d->f.isOpen())
         d->f.close();
 
@@ -31,62 +228,85 @@ QbpLog::~QbpLog()
 
 void QbpLog::setVerbose(bool verbose)
 {
-    d->verbose = verbose;
+    d->verbose.storeRelease(verbose ? 1 : 0);
+}
+
+void QbpLog::setThrowOnFatal(bool throwOnFatal)
+{
+    d->throwOnFatal = throwOnFatal;
 }
 
 bool QbpLog::setLogFile(const QString &fileName)
 {
+    // messages printed before belong to the previous file
+    flush();
+
+    QMutexLocker locker(&d->mutex);
     if (d->f.isOpen())
         d->f.close();
 
+    bool r = true;
     if (!fileName.isEmpty()) {
         d->f.setFileName(fileName);
-        return d->f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text | QIODevice::Unbuffered);
+        r = d->f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
     }
 
-    return true;
+    d->fileOpen.storeRelease(d->f.isOpen() ? 1 : 0);
+    return r;
+}
+
+bool QbpLog::isVerboseEnabled() const
+{
+    return d->verbose.loadAcquire() != 0 || d->fileOpen.loadAcquire() != 0;
 }
 
 void QbpLog::print(const QString &c, LogLevel l)
 {
-    bool levelAvailable = true;
-    bool fatalError = false;
-    static const QStringList logLevelStr {QStringLiteral("Verbose"), QStringLiteral("Warning"), QStringLiteral("Error"), QStringLiteral("Fatal")};
-    switch (l) {
-    case Verbose:
-        if (d->verbose)
-            qDebug("%s", c.toUtf8().constData());
-        break;
-    case Warning:
-        qWarning("%s", c.toUtf8().constData());
-        break;
-    case Error:
-        qCritical("%s", c.toUtf8().constData());
-        break;
-    case Fatal:
-        // qFatal will call exit();
-        fatalError = true;
-        break;
-    default:
+    if (l < Verbose || l > Fatal) {
         // ???
-        levelAvailable = false;
         print(QString(QStringLiteral("Log Level %1 is not available for log \"%2\"")).arg(static_cast<int>(l)).arg(c), Warning);
-        break;
+        return;
     }
 
-    if (levelAvailable && d->f.isOpen())
-        d->f.write(QString(QStringLiteral("%1: %2\n")).arg(logLevelStr.value(static_cast<int>(l))).arg(c).toUtf8().constData());
+    if (l == Verbose && !isVerboseEnabled())
+        return;
+
+    LogRecord *r = new LogRecord;
+    r->level = l;
+    r->message = c;
+    d->enqueue(r);
+
+    if (l != Fatal)
+        return;
 
-    if (fatalError) {
-        // why nothing is wrote during fatal error?
-        // Close the file before calling qFatal, since qFatal is calling exit() so any code after qFatal is unreachable.
+    // qFatal calls abort() and the exception may end the program as well, so everything printed so far is written first
+    flush();
+
+    if (d->throwOnFatal) {
+        qCritical("%s", c.toUtf8().constData());
+        throw QbpFatalError {c};
+    }
+
+    {
+        QMutexLocker locker(&d->mutex);
         d->f.close();
-        qFatal("%s", c.toUtf8().constData());
-        Q_UNREACHABLE();
     }
+    qFatal("%s", c.toUtf8().constData());
+    Q_UNREACHABLE();
+}
+
+void QbpLog::flush()
+{
+    QSemaphore done;
+    LogRecord *r = new LogRecord(LogRecord::Flush);
+    r->done = &done;
+    d->enqueue(r);
+    done.acquire();
 }
 
 QbpLog::QbpLog()
     : d(new QbpLogPrivate)
 {
+    d->writer = new LogWriter(d);
+    d->writer->start();
 }
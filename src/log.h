@@ -7,6 +7,12 @@
 
 struct QbpLogPrivate;
 
+// thrown by fatal errors instead of exiting if setThrowOnFatal(true), so batch mode can go on with the next kit
+struct QbpFatalError
+{
+    QString message;
+};
+
 class QbpLog
 {
 public:
@@ -21,8 +27,14 @@ public:
     static QbpLog &instance();
     ~QbpLog();
     void setVerbose(bool verbose);
+    void setThrowOnFatal(bool throwOnFatal);
     bool setLogFile(const QString &fileName);
+    // whether a verbose message goes anywhere, i.e. verbose is on or a log file is open
+    bool isVerboseEnabled() const;
+    // Messages are written to the console and the log file by a background thread in the order they are printed.
+    // print() only queues them, flush() returns after everything printed before it is written.
     void print(const QString &c, LogLevel l = Verbose);
+    void flush();
 
 private:
     QbpLog();
@@ -36,6 +48,15 @@ Q_ALWAYS_INLINE void QBPLOGV(const QString &l)
     QbpLog::instance().print(l, QbpLog::Verbose);
 }
 
+// Formats the message only if it goes anywhere, for messages which are expensive to build or printed many times, e.g.
+// QBPLOGV([&]() { return QString(QStringLiteral("patching %1")).arg(file); });
+template<typename Formatter>
+Q_ALWAYS_INLINE void QBPLOGV(Formatter formatter)
+{
+    if (QbpLog::instance().isVerboseEnabled())
+        QbpLog::instance().print(formatter(), QbpLog::Verbose);
+}
+
 Q_ALWAYS_INLINE void QBPLOGW(const QString &l)
 {
     QbpLog::instance().print(l, QbpLog::Warning);
@@ -0,0 +1,272 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "macho.h"
+#include <QtEndian>
+
+#include <functional>
+
+namespace {
+
+// from <mach-o/loader.h> and <mach-o/fat.h>
+const quint32 MH_MAGIC = 0xfeedface;
+const quint32 MH_MAGIC_64 = 0xfeedfacf;
+const quint32 FAT_MAGIC = 0xcafebabe;
+const quint32 FAT_MAGIC_64 = 0xcafebabf;
+
+const quint32 LC_REQ_DYLD = 0x80000000;
+const quint32 LC_SEGMENT = 0x1;
+const quint32 LC_SEGMENT_64 = 0x19;
+const quint32 LC_LOAD_DYLIB = 0xc;
+const quint32 LC_ID_DYLIB = 0xd;
+const quint32 LC_LOAD_WEAK_DYLIB = 0x18 | LC_REQ_DYLD;
+const quint32 LC_REEXPORT_DYLIB = 0x1f | LC_REQ_DYLD;
+const quint32 LC_LAZY_LOAD_DYLIB = 0x20;
+const quint32 LC_LOAD_UPWARD_DYLIB = 0x23 | LC_REQ_DYLD;
+
+const quint32 SECTION_TYPE = 0xff;
+const quint32 S_ZEROFILL = 0x1;
+const quint32 S_GB_ZEROFILL = 0xc;
+const quint32 S_THREAD_LOCAL_ZEROFILL = 0x12;
+
+// sizeof(struct dylib_command)
+const quint32 dylibCommandSize = 24;
+
+// Java class files start with FAT_MAGIC as well, followed by their version which is at least 45
+const quint32 maxArchitectures = 32;
+
+quint32 read32(const char *p, bool bigEndian)
+{
+    const uchar *u = reinterpret_cast<const uchar *>(p);
+    return bigEndian ? qFromBigEndian<quint32>(u) : qFromLittleEndian<quint32>(u);
+}
+
+quint64 read64(const char *p, bool bigEndian)
+{
+    const uchar *u = reinterpret_cast<const uchar *>(p);
+    return bigEndian ? qFromBigEndian<quint64>(u) : qFromLittleEndian<quint64>(u);
+}
+
+bool isDylibCommand(quint32 command)
+{
+    switch (command) {
+    case LC_LOAD_DYLIB:
+    case LC_ID_DYLIB:
+    case LC_LOAD_WEAK_DYLIB:
+    case LC_REEXPORT_DYLIB:
+    case LC_LAZY_LOAD_DYLIB:
+    case LC_LOAD_UPWARD_DYLIB:
+        return true;
+    default:
+        break;
+    }
+    return false;
+}
+
+struct LoadCommand
+{
+    // the image the command is in, which is the whole file or an architecture of a fat file
+    const char *image;
+    qint64 base;
+    qint64 imageSize;
+    // offset of the command in the image
+    qint64 offset;
+    quint32 command;
+    quint32 size;
+    bool bigEndian;
+    bool is64;
+};
+
+// returns false to stop reading, as the command is broken
+typedef std::function<bool(const LoadCommand &)> LoadCommandVisitor;
+
+// a thin Mach-O image at base
+bool readImage(const char *data, qint64 base, qint64 size, const LoadCommandVisitor &visit)
+{
+    if (size < 28)
+        return false;
+
+    const char *image = data + base;
+    bool bigEndian = false;
+    quint32 magic = read32(image, false);
+    if (magic != MH_MAGIC && magic != MH_MAGIC_64) {
+        bigEndian = true;
+        magic = read32(image, true);
+        if (magic != MH_MAGIC && magic != MH_MAGIC_64)
+            return false;
+    }
+
+    // struct mach_header(_64)
+    quint32 ncmds = read32(image + 16, bigEndian);
+    quint32 sizeofcmds = read32(image + 20, bigEndian);
+    qint64 offset = (magic == MH_MAGIC_64) ? 32 : 28;
+    qint64 end = offset + sizeofcmds;
+    if (end > size)
+        return false;
+
+    for (quint32 i = 0; i < ncmds; ++i) {
+        if (offset + 8 > end)
+            return false;
+
+        LoadCommand c;
+        c.image = image;
+        c.base = base;
+        c.imageSize = size;
+        c.offset = offset;
+        c.command = read32(image + offset, bigEndian);
+        c.size = read32(image + offset + 4, bigEndian);
+        c.bigEndian = bigEndian;
+        c.is64 = (magic == MH_MAGIC_64);
+        if (c.size < 8 || offset + c.size > end)
+            return false;
+        if (!visit(c))
+            return false;
+
+        offset += c.size;
+    }
+
+    return true;
+}
+
+// each architecture of a fat file, or the thin file
+bool readFile(const char *data, qint64 size, const LoadCommandVisitor &visit)
+{
+    if (size < 8)
+        return false;
+
+    // fat headers are always big endian
+    quint32 magic = read32(data, true);
+    if (magic != FAT_MAGIC && magic != FAT_MAGIC_64)
+        return readImage(data, 0, size, visit);
+
+    quint32 architectures = read32(data + 4, true);
+    if (architectures == 0 || architectures > maxArchitectures)
+        return false;
+
+    // struct fat_arch(_64)
+    qint64 entrySize = (magic == FAT_MAGIC_64) ? 32 : 20;
+    if (8 + architectures * entrySize > size)
+        return false;
+
+    for (quint32 i = 0; i < architectures; ++i) {
+        const char *entry = data + 8 + i * entrySize;
+        quint64 offset;
+        quint64 imageSize;
+        if (magic == FAT_MAGIC_64) {
+            offset = read64(entry + 8, true);
+            imageSize = read64(entry + 16, true);
+        } else {
+            offset = read32(entry + 8, true);
+            imageSize = read32(entry + 12, true);
+        }
+
+        if (offset > static_cast<quint64>(size) || imageSize > static_cast<quint64>(size) - offset)
+            return false;
+        if (!readImage(data, static_cast<qint64>(offset), static_cast<qint64>(imageSize), visit))
+            return false;
+    }
+
+    return true;
+}
+
+// 16 bytes, not terminated if all are used
+QByteArray fixedName(const char *p)
+{
+    return QByteArray(p, static_cast<int>(qstrnlen(p, 16)));
+}
+
+}
+
+bool MachO::isMachO(const char *data, qint64 size)
+{
+    if (size < 4)
+        return false;
+
+    quint32 magic = read32(data, true);
+    quint32 swapped = read32(data, false);
+    return magic == FAT_MAGIC || magic == FAT_MAGIC_64 || magic == MH_MAGIC || magic == MH_MAGIC_64 || swapped == MH_MAGIC || swapped == MH_MAGIC_64;
+}
+
+bool MachO::DylibCommand::isId() const
+{
+    return command == LC_ID_DYLIB;
+}
+
+bool MachO::readDylibCommands(const char *data, qint64 size, QVector<DylibCommand> *commands)
+{
+    commands->clear();
+
+    return readFile(data, size, [commands](const LoadCommand &lc) -> bool {
+        if (!isDylibCommand(lc.command))
+            return true;
+        if (lc.size < dylibCommandSize)
+            return false;
+
+        // dylib.name.offset, relative to the command
+        quint32 nameOffset = read32(lc.image + lc.offset + 8, lc.bigEndian);
+        if (nameOffset < dylibCommandSize || nameOffset >= lc.size)
+            return false;
+
+        DylibCommand c;
+        c.command = lc.command;
+        c.nameOffset = lc.base + lc.offset + nameOffset;
+        c.nameCapacity = lc.size - nameOffset;
+        const char *name = lc.image + lc.offset + nameOffset;
+        c.name = QByteArray(name, static_cast<int>(qstrnlen(name, static_cast<uint>(c.nameCapacity))));
+        *commands << c;
+        return true;
+    });
+}
+
+bool MachO::readSections(const char *data, qint64 size, QVector<Section> *sections)
+{
+    sections->clear();
+
+    return readFile(data, size, [sections](const LoadCommand &lc) -> bool {
+        if (lc.command != LC_SEGMENT && lc.command != LC_SEGMENT_64)
+            return true;
+
+        // struct segment_command(_64) followed by struct section(_64)
+        qint64 segmentSize = lc.is64 ? 72 : 56;
+        qint64 sectionSize = lc.is64 ? 80 : 68;
+        if (lc.size < segmentSize)
+            return false;
+        const char *segment = lc.image + lc.offset;
+        quint32 count = read32(segment + (lc.is64 ? 64 : 48), lc.bigEndian);
+        if (static_cast<qint64>(count) > (lc.size - segmentSize) / sectionSize)
+            return false;
+
+        for (quint32 i = 0; i < count; ++i) {
+            const char *p = segment + segmentSize + i * sectionSize;
+            quint32 flags = read32(p + (lc.is64 ? 64 : 56), lc.bigEndian);
+            quint32 type = flags & SECTION_TYPE;
+            // zero filled sections take no room in the file
+            if (type == S_ZEROFILL || type == S_GB_ZEROFILL || type == S_THREAD_LOCAL_ZEROFILL)
+                continue;
+
+            Section section;
+            section.name = fixedName(p);
+            section.segment = fixedName(p + 16);
+            quint64 sectionDataSize = lc.is64 ? read64(p + 40, lc.bigEndian) : read32(p + 36, lc.bigEndian);
+            quint64 offset = read32(p + (lc.is64 ? 48 : 40), lc.bigEndian);
+            if (sectionDataSize == 0)
+                continue;
+            if (offset > static_cast<quint64>(lc.imageSize) || sectionDataSize > static_cast<quint64>(lc.imageSize) - offset)
+                return false;
+
+            section.offset = lc.base + static_cast<qint64>(offset);
+            section.size = static_cast<qint64>(sectionDataSize);
+            *sections << section;
+        }
+        return true;
+    });
+}
+
+QByteArray MachO::renamed(const DylibCommand &command, const QByteArray &newName)
+{
+    if (newName.length() + 1 > command.nameCapacity)
+        return QByteArray();
+
+    QByteArray r = newName;
+    r.append(QByteArray(static_cast<int>(command.nameCapacity - newName.length()), '\0'));
+    return r;
+}
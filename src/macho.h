@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPMACHO_H
+#define QQBPMACHO_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Reads the install names and sections in the load commands of Mach-O files, thin or fat (universal), so they are changed without otool and install_name_tool.
+// Both byte orders are read, since Qt 4 was built for PowerPC as well.
+namespace MachO {
+
+// Whether data starts with the magic of a thin or fat Mach-O file, the headers are not checked.
+bool isMachO(const char *data, qint64 size);
+
+struct DylibCommand
+{
+    // LC_ID_DYLIB, LC_LOAD_DYLIB, LC_LOAD_WEAK_DYLIB, LC_REEXPORT_DYLIB, LC_LAZY_LOAD_DYLIB or LC_LOAD_UPWARD_DYLIB
+    quint32 command;
+    // offset of the name in the file
+    qint64 nameOffset;
+    // bytes from the name to the end of the command, the terminating '\0' included
+    qint64 nameCapacity;
+    QByteArray name;
+
+    bool isId() const;
+};
+
+// Commands of all architectures of a fat file are returned, in file order.
+// Returns false if data is not a Mach-O file, or its headers or load commands are out of bounds.
+bool readDylibCommands(const char *data, qint64 size, QVector<DylibCommand> *commands);
+
+struct Section
+{
+    // e.g. "__TEXT" and "__const"
+    QByteArray segment;
+    QByteArray name;
+    // where the content is in the file
+    qint64 offset;
+    qint64 size;
+};
+
+// The sections having content in the file, of all architectures of a fat file.
+// Returns false if data is not a Mach-O file, or a section is out of bounds.
+bool readSections(const char *data, qint64 size, QVector<Section> *sections);
+
+// The bytes to be written at command.nameOffset to change its name to newName: newName padded with '\0' to nameCapacity.
+// Empty if newName does not fit, as the load commands can't grow without moving the following data.
+QByteArray renamed(const DylibCommand &command, const QByteArray &newName);
+
+}
+
+#endif
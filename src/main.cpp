@@ -1,10 +1,14 @@
 // SPDX-License-Identifier: Unlicense
 
 #include "argument.h"
+#include "backup.h"
+#include "batch.h"
 #include "log.h"
 #include "patch.h"
+#include "trace.h"
 #include <QCoreApplication>
 #include <QDir>
+#include <QThreadPool>
 
 #include <cstdio>
 
@@ -20,10 +24,21 @@ int main(int argc, char *argv[])
 
     QbpLog::instance().setVerbose(ArgumentsAndSettings::verbose());
     QbpLog::instance().setLogFile(ArgumentsAndSettings::logFile());
+    if (!ArgumentsAndSettings::traceFile().isEmpty())
+        Trace::start(ArgumentsAndSettings::traceFile());
 
     if (!ArgumentsAndSettings::unknownParameters().isEmpty())
         QBPLOGW(QString(QStringLiteral("Unknown Parameters: %1")).arg(ArgumentsAndSettings::unknownParameters().join(QStringLiteral(", "))));
 
+    // all parallel work goes to the global pool, so the limit holds across kits in batch mode
+    QThreadPool::globalInstance()->setMaxThreadCount(ArgumentsAndSettings::jobs());
+
+    if (!ArgumentsAndSettings::undoJournal().isEmpty())
+        return Backup::undo(ArgumentsAndSettings::undoJournal()) ? 0 : 1;
+
+    if (!ArgumentsAndSettings::batchFile().isEmpty())
+        return runBatch(ArgumentsAndSettings::batchFile()) ? 0 : 1;
+
     bool success = true;
     prepare();
     warnAboutUnsupportedQtVersion();
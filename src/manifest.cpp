@@ -0,0 +1,277 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "manifest.h"
+#include "log.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+
+// 1 was saved in the Qt dir, 2 had neither the Qt dir nor the hashes
+const int manifestVersion = 3;
+
+QMutex contentHashMutex;
+// path as listed by the patcher -> hex SHA-1, see Manifest::setContentHash
+QHash<QString, QByteArray> contentHashes;
+
+QByteArray sha1Of(const QString &fileName)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!hash.addData(&f))
+        return QByteArray();
+
+    return hash.result().toHex();
+}
+
+}
+
+struct ManifestPrivate
+{
+    QString qtDir;
+    QString prefix;
+    QString qtVersion;
+
+    QMutex mutex;
+    QList<ManifestEntry> entries;
+};
+
+Manifest::Manifest()
+    : d(new ManifestPrivate)
+{
+}
+
+Manifest::~Manifest()
+{
+    delete d;
+}
+
+QString Manifest::fileName(const QString &canonicalQtDir, const QString &backupDir)
+{
+    if (!backupDir.isEmpty())
+        return QDir(backupDir).absoluteFilePath(QStringLiteral("QQtPatcher.manifest.json"));
+
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    if (cacheDir.isEmpty() || canonicalQtDir.isEmpty())
+        return QString();
+
+    QByteArray key = QCryptographicHash::hash(canonicalQtDir.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return QDir(cacheDir).absoluteFilePath(QString(QStringLiteral("QQtPatcher/%1.manifest.json")).arg(QString::fromLatin1(key)));
+}
+
+bool Manifest::load(const QString &fileName, const QString &canonicalQtDir)
+{
+    clear();
+
+    if (fileName.isEmpty())
+        return false;
+
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QJsonParseError err;
+    QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &err);
+    if (err.error != QJsonParseError::NoError || !doc.isObject()) {
+        QBPLOGW(QString(QStringLiteral("Manifest %1 is broken, ignored.")).arg(f.fileName()));
+        return false;
+    }
+
+    QJsonObject ob = doc.object();
+    if (ob.value(QStringLiteral("version")).toInt() != manifestVersion)
+        return false;
+
+    if (ob.value(QStringLiteral("qtDir")).toString() != canonicalQtDir) {
+        QBPLOGV(QString(QStringLiteral("Manifest %1 is written for %2, ignored.")).arg(f.fileName()).arg(ob.value(QStringLiteral("qtDir")).toString()));
+        return false;
+    }
+
+    d->qtDir = canonicalQtDir;
+    d->prefix = ob.value(QStringLiteral("prefix")).toString();
+    d->qtVersion = ob.value(QStringLiteral("qtVersion")).toString();
+    foreach (const QJsonValue &v, ob.value(QStringLiteral("files")).toArray()) {
+        QJsonObject file = v.toObject();
+        ManifestEntry e;
+        e.path = file.value(QStringLiteral("path")).toString();
+        e.patcher = file.value(QStringLiteral("patcher")).toString();
+        // JSON numbers are doubles, which hold qint64 msecs and file sizes exactly
+        e.size = static_cast<qint64>(file.value(QStringLiteral("size")).toDouble(-1));
+        e.mtime = static_cast<qint64>(file.value(QStringLiteral("mtime")).toDouble());
+        e.sha1 = file.value(QStringLiteral("sha1")).toString().toLatin1();
+        d->entries << e;
+    }
+
+    QBPLOGV(QString(QStringLiteral("Loaded manifest %1, prefix: %2, %3 files")).arg(f.fileName()).arg(d->prefix).arg(d->entries.length()));
+    return true;
+}
+
+bool Manifest::save(const QString &fileName) const
+{
+    if (fileName.isEmpty())
+        return false;
+
+    QJsonArray files;
+    QMutexLocker locker(&d->mutex);
+    foreach (const ManifestEntry &e, d->entries) {
+        QJsonObject file;
+        file.insert(QStringLiteral("path"), e.path);
+        file.insert(QStringLiteral("patcher"), e.patcher);
+        file.insert(QStringLiteral("size"), static_cast<double>(e.size));
+        file.insert(QStringLiteral("mtime"), static_cast<double>(e.mtime));
+        file.insert(QStringLiteral("sha1"), QString::fromLatin1(e.sha1));
+        files.append(file);
+    }
+
+    QJsonObject ob;
+    ob.insert(QStringLiteral("version"), manifestVersion);
+    ob.insert(QStringLiteral("qtDir"), d->qtDir);
+    ob.insert(QStringLiteral("prefix"), d->prefix);
+    ob.insert(QStringLiteral("qtVersion"), d->qtVersion);
+    ob.insert(QStringLiteral("files"), files);
+
+    // the cache dir may not exist yet
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly) || f.write(QJsonDocument(ob).toJson()) == -1 || !f.commit()) {
+        QBPLOGW(QString(QStringLiteral("Unable to write manifest %1.")).arg(fileName));
+        return false;
+    }
+
+    return true;
+}
+
+void Manifest::remove(const QString &fileName)
+{
+    if (!fileName.isEmpty())
+        QFile::remove(fileName);
+}
+
+void Manifest::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->qtDir.clear();
+    d->prefix.clear();
+    d->qtVersion.clear();
+    d->entries.clear();
+}
+
+QString Manifest::qtDir() const
+{
+    return d->qtDir;
+}
+
+void Manifest::setQtDir(const QString &canonicalQtDir)
+{
+    d->qtDir = canonicalQtDir;
+}
+
+QString Manifest::prefix() const
+{
+    return d->prefix;
+}
+
+void Manifest::setPrefix(const QString &prefix)
+{
+    d->prefix = prefix;
+}
+
+QString Manifest::qtVersion() const
+{
+    return d->qtVersion;
+}
+
+void Manifest::setQtVersion(const QString &version)
+{
+    d->qtVersion = version;
+}
+
+QList<ManifestEntry> Manifest::entries() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->entries;
+}
+
+void Manifest::add(const ManifestEntry &entry)
+{
+    QMutexLocker locker(&d->mutex);
+    d->entries << entry;
+}
+
+void Manifest::record(const QString &qtDir, const QString &path, const QString &patcher, const QByteArray &sha1)
+{
+    QString fileName = QDir(qtDir).absoluteFilePath(path);
+    QFileInfo fi(fileName);
+
+    ManifestEntry e;
+    e.path = path;
+    e.patcher = patcher;
+    if (fi.exists()) {
+        e.size = fi.size();
+        e.mtime = fi.lastModified().toMSecsSinceEpoch();
+        e.sha1 = sha1;
+    }
+
+    add(e);
+}
+
+void Manifest::setContentHash(const QString &path, const QByteArray &sha1)
+{
+    QMutexLocker locker(&contentHashMutex);
+    contentHashes.insert(path, sha1);
+}
+
+QByteArray Manifest::takeContentHash(const QString &path)
+{
+    QMutexLocker locker(&contentHashMutex);
+    return contentHashes.take(path);
+}
+
+QByteArray Manifest::hashOf(const QByteArray &content)
+{
+    return QCryptographicHash::hash(content, QCryptographicHash::Sha1).toHex();
+}
+
+QByteArray Manifest::hashOf(const char *data, qint64 size, const QMap<qint64, QByteArray> &replaced)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    qint64 pos = 0;
+    for (QMap<qint64, QByteArray>::const_iterator it = replaced.constBegin(); it != replaced.constEnd(); ++it) {
+        if (it.key() < pos || it.key() + it.value().size() > size)
+            return QByteArray();
+        hash.addData(QByteArray::fromRawData(data + pos, static_cast<int>(it.key() - pos)));
+        hash.addData(it.value());
+        pos = it.key() + it.value().size();
+    }
+    hash.addData(QByteArray::fromRawData(data + pos, static_cast<int>(size - pos)));
+
+    return hash.result().toHex();
+}
+
+bool Manifest::isUpToDate(const QString &qtDir, const ManifestEntry &entry)
+{
+    QString fileName = QDir(qtDir).absoluteFilePath(entry.path);
+    QFileInfo fi(fileName);
+    if (!fi.exists())
+        return entry.size == -1;
+    if (fi.size() != entry.size)
+        return false;
+    if (fi.lastModified().toMSecsSinceEpoch() == entry.mtime)
+        return true;
+
+    // only read when the mtime is not kept, so an unchanged tree costs one stat per file
+    return !entry.sha1.isEmpty() && sha1Of(fileName) == entry.sha1;
+}
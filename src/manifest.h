@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPMANIFEST_H
+#define QQBPMANIFEST_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+struct ManifestEntry
+{
+    // relative to Qt dir
+    QString path;
+    // class name of the patcher
+    QString patcher;
+    // -1 if the file is removed by the patcher
+    qint64 size;
+    // msecs since epoch
+    qint64 mtime;
+    // hex SHA-1 of the content left by the patchers, empty if none of them reported it
+    QByteArray sha1;
+
+    ManifestEntry()
+        : size(-1)
+        , mtime(0)
+    {
+    }
+};
+
+struct ManifestPrivate;
+
+// State of the files patched by a successful run, kept out of the Qt dir so it is not shipped with it.
+// The next run on the same Qt dir uses it to skip the files which are already relocated, and to skip searching the files when the tree is unchanged.
+class Manifest
+{
+public:
+    Manifest();
+    ~Manifest();
+
+    // In the backup dir if one is given, otherwise in the cache dir of the user, one file per canonical Qt dir. Empty if there is no cache dir.
+    static QString fileName(const QString &canonicalQtDir, const QString &backupDir);
+
+    // fails if the manifest is written for another Qt dir, which may happen with a backup dir shared by several trees
+    bool load(const QString &fileName, const QString &canonicalQtDir);
+    bool save(const QString &fileName) const;
+    static void remove(const QString &fileName);
+    void clear();
+
+    // canonical
+    QString qtDir() const;
+    void setQtDir(const QString &canonicalQtDir);
+    // the new dir the files are patched to
+    QString prefix() const;
+    void setPrefix(const QString &prefix);
+    QString qtVersion() const;
+    void setQtVersion(const QString &version);
+
+    QList<ManifestEntry> entries() const;
+    // add and record are thread safe
+    void add(const ManifestEntry &entry);
+    // adds the size and mtime of the file along with sha1, the content is not read
+    void record(const QString &qtDir, const QString &path, const QString &patcher, const QByteArray &sha1);
+
+    // Patchers report the content they leave in a file here, hashed from the memory they already have, so the file is not read again for the manifest.
+    // Thread safe. The hash is taken by the job of the file after all its patchers are done.
+    static void setContentHash(const QString &path, const QByteArray &sha1);
+    static QByteArray takeContentHash(const QString &path);
+    // hex SHA-1 of content
+    static QByteArray hashOf(const QByteArray &content);
+    // hex SHA-1 of data with the bytes at each offset replaced by the ones of the same length in replaced, without copying data.
+    // Empty if the replaced ranges overlap or are out of data.
+    static QByteArray hashOf(const char *data, qint64 size, const QMap<qint64, QByteArray> &replaced);
+
+    // Whether the file is still the same as recorded: same size and mtime.
+    // A file with another mtime, e.g. copied without preserving it, is hashed and compared with the recorded hash if there is one.
+    static bool isUpToDate(const QString &qtDir, const ManifestEntry &entry);
+
+private:
+    Q_DISABLE_COPY(Manifest)
+    ManifestPrivate *d;
+};
+
+#endif
@@ -3,13 +3,30 @@
 #include "patch.h"
 #include "argument.h"
 #include "backup.h"
+#include "commit.h"
+#include "contentcache.h"
+#include "fileindex.h"
 #include "log.h"
+#include "manifest.h"
+#include "patchcontext.h"
+#include "qtinfo.h"
+#include "trace.h"
+#include "verify.h"
+#include <QAtomicInt>
 #include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
 #include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
 #include <QProcess>
 #include <QRegularExpression>
+#include <QRunnable>
+#include <QSet>
 #include <QStringList>
 #include <QTextStream>
+#include <QThreadPool>
 #include <QVersionNumber>
 
 namespace PatcherFactory {
@@ -27,10 +44,33 @@ Patcher::~Patcher()
 namespace {
 
 QMap<Patcher *, QStringList> patcherFileMap;
+// built after step2, read only from then on
+PatchContext context;
+FileIndex qtDirIndex;
+ContentCache qtDirContents;
+// the manifest saved by the last run, and the one to be saved by this run
+Manifest lastManifest;
+Manifest newManifest;
+
+// the Qt dir with symlinks resolved, which the manifest is kept for
+QString canonicalQtDir()
+{
+    return QFileInfo(ArgumentsAndSettings::qtDir()).canonicalFilePath();
+}
+
+QString manifestFile()
+{
+    return Manifest::fileName(canonicalQtDir(), ArgumentsAndSettings::backupDir());
+}
+
+QMutex warningsMutex;
+QSet<QString> warnings;
 
 // step 1: get Qt version from QMake and command line arguments, make absolute path of both dirs passed from command line
 QString step1()
 {
+    TraceSpan span("step", "step1");
+
     // make absolute path
     QDir newDir;
     if (!ArgumentsAndSettings::newDir().isEmpty())
@@ -88,18 +128,42 @@ QString step1()
     return qmakeProgram;
 }
 
-// step 2: Query QMake
-void step2(const QString &qmakeProgram)
+// Renames bin/qt.conf away while qmake is queried, and back when going out of scope.
+// Fatal errors throw in batch mode, the kit must not be left without its qt.conf then.
+class QtConfHider
+{
+public:
+    explicit QtConfHider(const QDir &qtDir)
+        : qtDir(qtDir)
+        , exists(qtDir.exists(QStringLiteral("bin/qt.conf")))
+    {
+        if (exists) {
+            this->qtDir.remove(QStringLiteral("bin/QQBP_qt.conf_QQBP"));
+            this->qtDir.rename(QStringLiteral("bin/qt.conf"), QStringLiteral("bin/QQBP_qt.conf_QQBP"));
+        }
+    }
+
+    ~QtConfHider()
+    {
+        if (exists)
+            qtDir.rename(QStringLiteral("bin/QQBP_qt.conf_QQBP"), QStringLiteral("bin/qt.conf"));
+    }
+
+private:
+    Q_DISABLE_COPY(QtConfHider)
+    QDir qtDir;
+    bool exists;
+};
+
+// run qmake -query, only when the values can't be detected from files, or when verification is requested
+QtInfo queryQMake(const QString &qmakeProgram)
 {
     QDir qtDir(ArgumentsAndSettings::qtDir());
 
     // temporily rename qt.conf for ease processing
-    bool qtConfExists = qtDir.exists(QStringLiteral("bin/qt.conf"));
-    if (qtConfExists) {
-        qtDir.remove(QStringLiteral("bin/QQBP_qt.conf_QQBP"));
-        qtDir.rename(QStringLiteral("bin/qt.conf"), QStringLiteral("bin/QQBP_qt.conf_QQBP"));
-    }
+    QtConfHider qtConfHider(qtDir);
 
+    TraceSpan span("process", "qmake", qtDir.absoluteFilePath(qmakeProgram));
     QProcess process;
     process.setProgram(qtDir.absoluteFilePath(qmakeProgram));
     process.setWorkingDirectory(qtDir.absoluteFilePath(QStringLiteral("bin")));
@@ -119,6 +183,7 @@ void step2(const QString &qmakeProgram)
     QString s = QString::fromLocal8Bit(process.readAllStandardOutput());
     QBPLOGV(QStringLiteral("qmake output:\n") + s);
 
+    QtInfo r;
     QTextStream ts(&s, QIODevice::ReadOnly | QIODevice::Text);
     while (!ts.atEnd()) {
         QString line = ts.readLine();
@@ -128,30 +193,68 @@ void step2(const QString &qmakeProgram)
         QString key = line.left(col);
         QString value = line.mid(col + 1);
         QBPLOGV(QString(QStringLiteral("key:%1,value:%2")).arg(key).arg(value));
-        if (key == QStringLiteral("QMAKE_SPEC")) {
-            if (!ArgumentsAndSettings::hostMkspec().isEmpty() && !value.contains(ArgumentsAndSettings::hostMkspec()))
-                QBPLOGW(QString(QStringLiteral("Host Mkspec detected from QMake is %1, which may not compatible with the one written in config file(%2)."))
-                            .arg(value)
-                            .arg(ArgumentsAndSettings::hostMkspec()));
-            ArgumentsAndSettings::setHostMkspec(value);
-        } else if (key == QStringLiteral("QMAKE_XSPEC")) {
-            if (!ArgumentsAndSettings::crossMkspec().isEmpty() && !value.contains(ArgumentsAndSettings::crossMkspec()))
-                QBPLOGW(QString(QStringLiteral("Cross Mkspec detected from QMake is %1, which may not compatible with the one written in config file(%2)."))
-                            .arg(value)
-                            .arg(ArgumentsAndSettings::crossMkspec()));
-            ArgumentsAndSettings::setCrossMkspec(value);
-        } else if (key == QStringLiteral("QT_VERSION")) {
-            if (!ArgumentsAndSettings::qtVersion().isEmpty() && (value != ArgumentsAndSettings::qtVersion()))
-                QBPLOGW(QString(QStringLiteral("Qt version detected from QMake is %1, which is different with the one written in config file(%2)."))
-                            .arg(value)
-                            .arg(ArgumentsAndSettings::qtVersion()));
-            ArgumentsAndSettings::setQtVersion(value);
-        } else if (key == QStringLiteral("QT_INSTALL_PREFIX"))
-            ArgumentsAndSettings::setOldDir(QDir(value).absolutePath());
+        if (key == QStringLiteral("QMAKE_SPEC"))
+            r.hostMkspec = value;
+        else if (key == QStringLiteral("QMAKE_XSPEC"))
+            r.crossMkspec = value;
+        else if (key == QStringLiteral("QT_VERSION"))
+            r.qtVersion = value;
+        else if (key == QStringLiteral("QT_INSTALL_PREFIX"))
+            r.installPrefix = QDir(value).absolutePath();
     }
 
-    if (qtConfExists)
-        qtDir.rename(QStringLiteral("bin/QQBP_qt.conf_QQBP"), QStringLiteral("bin/qt.conf"));
+    return r;
+}
+
+void verifyDetected(const QString &name, const QString &detected, const QString &queried)
+{
+    if (!detected.isEmpty() && detected != queried)
+        QBPLOGW(QString(QStringLiteral("%1 detected from files is %2, but qmake -query reports %3, the latter is used.")).arg(name).arg(detected).arg(queried));
+}
+
+// step 2: detect Qt version, prefix and mkspecs from files, query QMake if needed
+void step2(const QString &qmakeProgram)
+{
+    TraceSpan span("step", "step2");
+
+    QtInfo info = detectQtInfo(ArgumentsAndSettings::qtDir(), qmakeProgram);
+
+    // mkspecs may also come from config file
+    bool complete = !info.qtVersion.isEmpty() && !info.installPrefix.isEmpty() && !(info.hostMkspec.isEmpty() && ArgumentsAndSettings::hostMkspec().isEmpty())
+        && !(info.crossMkspec.isEmpty() && ArgumentsAndSettings::crossMkspec().isEmpty());
+    if (!complete || ArgumentsAndSettings::queryQMake()) {
+        QBPLOGV(complete ? QStringLiteral("Step2: verifying the values using qmake -query") : QStringLiteral("Step2: not all values are detected from files, using qmake -query"));
+        QtInfo queried = queryQMake(qmakeProgram);
+        verifyDetected(QStringLiteral("QMAKE_SPEC"), info.hostMkspec, queried.hostMkspec);
+        verifyDetected(QStringLiteral("QMAKE_XSPEC"), info.crossMkspec, queried.crossMkspec);
+        verifyDetected(QStringLiteral("QT_VERSION"), info.qtVersion, queried.qtVersion);
+        verifyDetected(QStringLiteral("QT_INSTALL_PREFIX"), info.installPrefix, queried.installPrefix);
+        info = queried;
+    }
+
+    if (!info.hostMkspec.isEmpty()) {
+        if (!ArgumentsAndSettings::hostMkspec().isEmpty() && !info.hostMkspec.contains(ArgumentsAndSettings::hostMkspec()))
+            QBPLOGW(QString(QStringLiteral("Host Mkspec detected from QMake is %1, which may not compatible with the one written in config file(%2)."))
+                        .arg(info.hostMkspec)
+                        .arg(ArgumentsAndSettings::hostMkspec()));
+        ArgumentsAndSettings::setHostMkspec(info.hostMkspec);
+    }
+    if (!info.crossMkspec.isEmpty()) {
+        if (!ArgumentsAndSettings::crossMkspec().isEmpty() && !info.crossMkspec.contains(ArgumentsAndSettings::crossMkspec()))
+            QBPLOGW(QString(QStringLiteral("Cross Mkspec detected from QMake is %1, which may not compatible with the one written in config file(%2)."))
+                        .arg(info.crossMkspec)
+                        .arg(ArgumentsAndSettings::crossMkspec()));
+        ArgumentsAndSettings::setCrossMkspec(info.crossMkspec);
+    }
+    if (!info.qtVersion.isEmpty()) {
+        if (!ArgumentsAndSettings::qtVersion().isEmpty() && (info.qtVersion != ArgumentsAndSettings::qtVersion()))
+            QBPLOGW(QString(QStringLiteral("Qt version detected from QMake is %1, which is different with the one written in config file(%2)."))
+                        .arg(info.qtVersion)
+                        .arg(ArgumentsAndSettings::qtVersion()));
+        ArgumentsAndSettings::setQtVersion(info.qtVersion);
+    }
+    if (!info.installPrefix.isEmpty())
+        ArgumentsAndSettings::setOldDir(info.installPrefix);
 
     QBPLOGV(QString(QStringLiteral("Step2: "
                                    "hostMkspec: %1, "
@@ -167,56 +270,296 @@ void step2(const QString &qmakeProgram)
         QBPLOGF(QString(QStringLiteral("OldDir with spaces is not supported. (%1)")).arg(ArgumentsAndSettings::oldDir()));
 }
 
+Patcher *createPatcher(const QString &className)
+{
+    foreach (const QMetaObject *mo, PatcherFactory::metaObjects) {
+        if (QString::fromUtf8(mo->className()) == className)
+            return qobject_cast<Patcher *>(mo->newInstance());
+    }
+
+    return nullptr;
+}
+
+// The tree is as it was left by the last run, only moved, so the files to patch are the ones patched by the last run.
+bool step3FromManifest(const QList<ManifestEntry> &entries)
+{
+    QMap<QString, Patcher *> patchers;
+    foreach (const ManifestEntry &e, entries) {
+        // removed by the patcher, e.g. bin/qt.conf
+        if (e.size == -1) {
+            newManifest.add(e);
+            continue;
+        }
+
+        Patcher *&patcher = patchers[e.patcher];
+        if (patcher == nullptr)
+            patcher = createPatcher(e.patcher);
+        if (patcher == nullptr) {
+            // written by a version of QQtPatcher with different patchers
+            qDeleteAll(patchers);
+            patcherFileMap.clear();
+            newManifest.clear();
+            return false;
+        }
+        patcherFileMap[patcher] << e.path;
+    }
+
+    QBPLOGV(QString(QStringLiteral("Step3: Qt dir is unchanged since last run, %1 files listed in manifest will be patched")).arg(entries.length()));
+    return true;
+}
+
 // step3: generate patchers
 void step3()
 {
+    TraceSpan span("step", "step3");
+
+    QString qtDir = ArgumentsAndSettings::qtDir();
+
+    // the manifest is kept out of the Qt dir, which is left clean for redistribution
+    QList<ManifestEntry> upToDate;
+    if (!ArgumentsAndSettings::rescan() && lastManifest.load(manifestFile(), canonicalQtDir())
+        && lastManifest.qtVersion() == ArgumentsAndSettings::qtVersion()) {
+        QList<ManifestEntry> entries = lastManifest.entries();
+        foreach (const ManifestEntry &e, entries) {
+            if (Manifest::isUpToDate(qtDir, e))
+                upToDate << e;
+            else
+                QBPLOGV([&]() { return QString(QStringLiteral("Step3: %1 is changed since last run")).arg(e.path); });
+        }
+        bool allUpToDate = upToDate.length() == entries.length();
+
+        if (allUpToDate && QDir(lastManifest.prefix()) == QDir(ArgumentsAndSettings::newDir())) {
+            foreach (const ManifestEntry &e, upToDate)
+                newManifest.add(e);
+            QBPLOGV(QString(QStringLiteral("Step3: Qt dir is already relocated to %1 by last run, nothing to patch")).arg(ArgumentsAndSettings::newDir()));
+            return;
+        }
+        // the files found by discovery may not be in the manifest of a run without it
+        if (allUpToDate && QDir(lastManifest.prefix()) == QDir(ArgumentsAndSettings::oldDir()) && !context.discoverBinaries && step3FromManifest(upToDate))
+            return;
+    }
+
+    // all patchers search files in these dirs, walk them only once
+    // clang-format off
+    static const QStringList indexedDirs {
+        QStringLiteral("bin"),
+        QStringLiteral("lib"),
+        QStringLiteral("libexec"),
+        QStringLiteral("mkspecs"),
+        QStringLiteral("plugins"),
+        QStringLiteral("qml"),
+    };
+    // clang-format on
+
+    QElapsedTimer timer;
+    timer.start();
+    {
+        TraceSpan span("io", "indexQtDir", ArgumentsAndSettings::qtDir());
+        qtDirIndex.build(ArgumentsAndSettings::qtDir(), indexedDirs);
+    }
+    QBPLOGV(QString(QStringLiteral("Step3: indexed %1 in %2 ms")).arg(ArgumentsAndSettings::qtDir()).arg(timer.elapsed()));
+
     foreach (const QMetaObject *mo, PatcherFactory::metaObjects) {
         Patcher *patcher = qobject_cast<Patcher *>(mo->newInstance());
         if (patcher == nullptr)
             continue;
 
-        QStringList l = patcher->findFileToPatch();
+        QStringList l;
+        {
+            TraceSpan span("findFileToPatch", mo->className());
+            l = patcher->findFileToPatch(context);
+        }
 
         if (!l.isEmpty()) {
-            QBPLOGV(QString(QStringLiteral("Step3: File found by Patcher %1:\n%2")).arg(QString::fromUtf8(patcher->metaObject()->className())).arg(l.join(QStringLiteral("\n"))));
+            QBPLOGV([&]() { return QString(QStringLiteral("Step3: File found by Patcher %1:\n%2")).arg(QString::fromUtf8(patcher->metaObject()->className())).arg(l.join(QStringLiteral("\n"))); });
             patcherFileMap[patcher] = l;
         } else {
             QBPLOGV(QString(QStringLiteral("Step3: No file found by Patcher %1")).arg(QString::fromUtf8(patcher->metaObject()->className())));
             delete patcher;
         }
     }
+
+    // files relocated to new dir by last run and unchanged since then are skipped
+    if (!upToDate.isEmpty() && QDir(lastManifest.prefix()) == QDir(ArgumentsAndSettings::newDir())) {
+        int skipped = 0;
+        foreach (const ManifestEntry &e, upToDate) {
+            Patcher *patcher = nullptr;
+            foreach (Patcher *p, patcherFileMap.keys()) {
+                if (QString::fromUtf8(p->metaObject()->className()) == e.patcher)
+                    patcher = p;
+            }
+            if (patcher != nullptr && patcherFileMap[patcher].removeAll(e.path) > 0) {
+                newManifest.add(e);
+                ++skipped;
+            }
+        }
+        QBPLOGV(QString(QStringLiteral("Step3: %1 files are skipped since they are already relocated by last run")).arg(skipped));
+    }
 }
 
 // step4: patch! (with backup)
+// Each file is a job run by a worker pool. Once a job fails no more jobs are started, jobs already running are waited for, then the backup is restored.
+// A file listed by more than one patcher, such as bin/qmake holding both the qt_prfxpath= key and a run path, is patched by one job, one patcher after another.
+class PatchJob : public QRunnable
+{
+public:
+    PatchJob(Backup *backup, QAtomicInt *fail)
+        : backup(backup)
+        , fail(fail)
+    {
+    }
+
+    // file as listed by patcher, which may be a symlink to the file listed by the others
+    void add(Patcher *patcher, const QString &file)
+    {
+        tasks << qMakePair(patcher, file);
+    }
+
+    void run() override
+    {
+        foreach (const Task &task, tasks) {
+            if (fail->loadAcquire() != 0)
+                break;
+
+            Patcher *patcher = task.first;
+            const QString &file = task.second;
+            bool failed = false;
+            if (!ArgumentsAndSettings::dryRun()) {
+                // the patcher journals what it is going to change by itself
+                TraceSpan span("patchFile", patcher->metaObject()->className(), file);
+                failed = !patcher->patchFile(context, file, *backup);
+                if (failed)
+                    fail->storeRelease(1);
+            }
+            if (failed) {
+                QBPLOGE(QString(QStringLiteral("Step4:patched %1 using Patcher %2, result: failed")).arg(file).arg(QString::fromUtf8(patcher->metaObject()->className())));
+            } else {
+                QBPLOGV([&]() {
+                    return QString(QStringLiteral("Step4:patched %1 using Patcher %2, result: %3"))
+                        .arg(file)
+                        .arg(QString::fromUtf8(patcher->metaObject()->className()))
+                        .arg(ArgumentsAndSettings::dryRun() ? QStringLiteral("dry-run") : QStringLiteral("success"));
+                });
+            }
+        }
+
+        // the tasks are for the same file, the hash reported by the last patcher is the one of its final content
+        QByteArray sha1;
+        foreach (const Task &task, tasks) {
+            QByteArray reported = Manifest::takeContentHash(task.second);
+            if (!reported.isEmpty())
+                sha1 = reported;
+        }
+
+        // recorded after all patchers are done, so the manifest has the final content of the file
+        if (!ArgumentsAndSettings::dryRun() && fail->loadAcquire() == 0) {
+            foreach (const Task &task, tasks)
+                newManifest.record(ArgumentsAndSettings::qtDir(), task.second, QString::fromUtf8(task.first->metaObject()->className()), sha1);
+        }
+    }
+
+private:
+    typedef QPair<Patcher *, QString> Task;
+    QList<Task> tasks;
+    Backup *backup;
+    QAtomicInt *fail;
+};
+
+// the file a job is for, with symlinks resolved, qtDir is canonical
+QString jobKey(const QDir &qtDir, const QString &file)
+{
+    const FileIndexEntry *e = qtDirIndex.entry(file);
+    if (e != nullptr && !e->symLink)
+        return qtDir.absoluteFilePath(file);
+
+    // not indexed when listed by the manifest, or below a symlinked dir
+    QString canonical = QFileInfo(qtDir.absoluteFilePath(file)).canonicalFilePath();
+    return canonical.isEmpty() ? qtDir.absoluteFilePath(file) : canonical;
+}
+
 bool step4()
 {
+    TraceSpan span("step", "step4");
+
     Backup backup;
-    bool fail = false;
+    QAtomicInt fail(0);
+
+    // the manifest is invalid as soon as any file is touched, it is written again after success
+    if (!ArgumentsAndSettings::dryRun())
+        Manifest::remove(manifestFile());
+
+    // shared with the walk of step3, and with all kits in batch mode
+    QThreadPool *pool = QThreadPool::globalInstance();
+    QBPLOGV(QString(QStringLiteral("Step4: patching using %1 jobs")).arg(pool->maxThreadCount()));
+
+    QDir qtDir(canonicalQtDir());
+    QMap<QString, PatchJob *> jobs;
     foreach (Patcher *patcher, patcherFileMap.keys()) {
         QStringList l = patcherFileMap.value(patcher);
         foreach (const QString &file, l) {
-            if (!ArgumentsAndSettings::dryRun()) {
-                backup.backupOneFile(file);
-                fail = !patcher->patchFile(file);
-            }
-            QbpLog::instance().print(QString(QStringLiteral("Step4:patched %1 using Patcher %2, result: %3"))
-                                         .arg(file)
-                                         .arg(QString::fromUtf8(patcher->metaObject()->className()))
-                                         .arg(ArgumentsAndSettings::dryRun() ? QStringLiteral("dry-run") : (fail ? QStringLiteral("failed") : QStringLiteral("success"))),
-                                     fail ? QbpLog::Error : QbpLog::Verbose);
-
-            if (fail)
-                break;
+            PatchJob *&job = jobs[jobKey(qtDir, file)];
+            if (job == nullptr)
+                job = new PatchJob(&backup, &fail);
+            job->add(patcher, file);
         }
-
-        if (fail)
-            break;
     }
+    foreach (PatchJob *job, jobs)
+        pool->start(job);
+    pool->waitForDone();
 
-    if (fail)
+    if (fail.loadAcquire() != 0)
         backup.restoreAll();
 
-    return !fail;
+    // text files are committed without syncing, sync them all at once
+    if (!syncCommittedFiles())
+        QBPLOGW(QStringLiteral("Step4: failed to sync patched files to disk"));
+
+    if (fail.loadAcquire() == 0 && !ArgumentsAndSettings::dryRun()) {
+        newManifest.setQtDir(canonicalQtDir());
+        newManifest.setPrefix(ArgumentsAndSettings::newDir());
+        newManifest.setQtVersion(ArgumentsAndSettings::qtVersion());
+        newManifest.save(manifestFile());
+    }
+
+    return fail.loadAcquire() == 0;
+}
+
+// step5: make sure the old dir is gone from the whole tree, including the files no patcher knows about
+void step5()
+{
+    if (ArgumentsAndSettings::dryRun() || !ArgumentsAndSettings::verify())
+        return;
+    // patched again in place, the old dir is the new one
+    if (context.canonicalOldDir == PatchContext::canonicalPath(context.newDir))
+        return;
+
+    TraceSpan span("step", "step5");
+
+    QStringList skippedDirs;
+    if (!ArgumentsAndSettings::backupDir().isEmpty())
+        skippedDirs << ArgumentsAndSettings::backupDir();
+
+    QElapsedTimer timer;
+    timer.start();
+    Verify::Result result = Verify::scan(context, skippedDirs);
+    QBPLOGV(QString(QStringLiteral("Step5: searched %1 files (%2 bytes) for %3 in %4 ms"))
+                .arg(result.files)
+                .arg(result.bytes)
+                .arg(context.oldDir)
+                .arg(timer.elapsed()));
+
+    // one warning for each file, listing all offsets
+    int files = 0;
+    for (int i = 0; i < result.hits.length();) {
+        const QString &path = result.hits.at(i).path;
+        QStringList offsets;
+        for (; i < result.hits.length() && result.hits.at(i).path == path; ++i)
+            offsets << QString(QStringLiteral("%1 (%2)")).arg(result.hits.at(i).offset).arg(QString::fromUtf8(result.hits.at(i).needle));
+        QBPLOGW(QString(QStringLiteral("Step5: %1 still refers to the old dir at offset %2")).arg(path).arg(offsets.join(QStringLiteral(", "))));
+        ++files;
+    }
+    if (files > 0)
+        QBPLOGW(QString(QStringLiteral("Step5: %1 references to the old dir %2 are left in %3 files")).arg(result.hits.length()).arg(context.oldDir).arg(files));
 }
 
 }
@@ -226,10 +569,30 @@ void registerPatcherMetaObject(const QMetaObject *metaObject)
     PatcherFactory::metaObjects << metaObject;
 }
 
+const FileIndex &fileIndex()
+{
+    return qtDirIndex;
+}
+
+ContentCache &contentCache()
+{
+    return qtDirContents;
+}
+
+bool isFirstWarning(const QString &key)
+{
+    QMutexLocker locker(&warningsMutex);
+    if (warnings.contains(key))
+        return false;
+    warnings.insert(key);
+    return true;
+}
+
 void prepare()
 {
     QString qmakeProgram = step1();
     step2(qmakeProgram);
+    context = PatchContext::fromSettings();
     step3();
 }
 
@@ -312,11 +675,23 @@ bool exitWhenSpacesExist()
 
 bool patch()
 {
-    return step4();
+    bool r = step4();
+    if (r)
+        step5();
+    return r;
 }
 
 void cleanup()
 {
     qDeleteAll(patcherFileMap.keys());
     patcherFileMap.clear();
+    qtDirIndex.clear();
+    qtDirContents.clear();
+    lastManifest.clear();
+    newManifest.clear();
+    {
+        QMutexLocker locker(&warningsMutex);
+        warnings.clear();
+    }
+    context = PatchContext();
 }
@@ -7,6 +7,11 @@
 #include <QMetaObject>
 #include <QObject>
 
+class Backup;
+class ContentCache;
+class FileIndex;
+struct PatchContext;
+
 class Patcher : public QObject
 {
     Q_OBJECT
@@ -15,12 +20,19 @@ public:
     Patcher();
     virtual ~Patcher() = 0;
 
-    // make sure the following functions called after prepare();
-    virtual QStringList findFileToPatch() const = 0;
-    virtual bool patchFile(const QString &file) const = 0;
+    // the following functions are called after prepare() with the context it built
+    virtual QStringList findFileToPatch(const PatchContext &context) const = 0;
+    // may be called simultaneously from worker threads, each call with a different file
+    virtual bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const = 0;
 };
 
 void registerPatcherMetaObject(const QMetaObject *metaObject);
+// files found in Qt dir, available after step3 starts
+const FileIndex &fileIndex();
+// content of text files read during step3, reused during step4
+ContentCache &contentCache();
+// true the first time key is passed during a run, for warnings about the Qt dir which more than one patcher may print
+bool isFirstWarning(const QString &key);
 void warnAboutUnsupportedQtVersion();
 bool exitWhenSpacesExist();
 bool shouldForce();
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "patchcontext.h"
+#include "argument.h"
+
+#include <QDir>
+
+namespace {
+
+QByteArray escapedNativePath(const QString &path)
+{
+    return QDir::toNativeSeparators(path).replace(QStringLiteral("\\"), QStringLiteral("\\\\")).toUtf8();
+}
+
+// Whether canonicalPath() would only change the case of path: ASCII, absolute, '/' separated, without "." and ".." parts, doubled or trailing separators.
+// Paths in the files of Qt almost always are, and are compared without cleaning and converting them.
+bool isCanonicalAscii(const QString &path)
+{
+    const int n = path.length();
+#ifdef Q_OS_WIN
+    // "c:/", UNC paths are cleaned
+    if (n < 3 || path.at(0).unicode() >= 0x80 || !path.at(0).isLetter() || path.at(1) != QLatin1Char(':') || path.at(2) != QLatin1Char('/'))
+        return false;
+    const int root = 2;
+#else
+    if (n < 1 || path.at(0) != QLatin1Char('/'))
+        return false;
+    const int root = 0;
+#endif
+    if (n > root + 1 && path.at(n - 1) == QLatin1Char('/'))
+        return false;
+
+    const QChar *p = path.constData();
+    for (int i = root; i < n; ++i) {
+        ushort c = p[i].unicode();
+        if (c >= 0x80 || c == '\\')
+            return false;
+        if (c != '/')
+            continue;
+
+        // the part following the separator
+        int rest = n - i - 1;
+        if (rest >= 1 && p[i + 1] == QLatin1Char('/'))
+            return false;
+        if (rest >= 1 && p[i + 1] == QLatin1Char('.') && (rest == 1 || p[i + 2] == QLatin1Char('/')))
+            return false;
+        if (rest >= 2 && p[i + 1] == QLatin1Char('.') && p[i + 2] == QLatin1Char('.') && (rest == 2 || p[i + 3] == QLatin1Char('/')))
+            return false;
+    }
+    return true;
+}
+
+bool isCanonical(const QString &path, const QByteArray &canonical)
+{
+    if (!isCanonicalAscii(path))
+        return PatchContext::canonicalPath(path) == canonical;
+    if (path.length() != canonical.length())
+        return false;
+
+    const QChar *p = path.constData();
+    for (int i = 0; i < canonical.length(); ++i) {
+        char c = static_cast<char>(p[i].unicode());
+#ifdef Q_OS_WIN
+        if (c >= 'A' && c <= 'Z')
+            c = static_cast<char>(c - 'A' + 'a');
+#endif
+        if (c != canonical.at(i))
+            return false;
+    }
+    return true;
+}
+
+}
+
+PatchContext::PatchContext()
+    : majorVersion(0)
+    , minorVersion(0)
+    , win32(false)
+    , msvc(false)
+    , android(false)
+    , discoverBinaries(false)
+{
+}
+
+PatchContext PatchContext::fromSettings()
+{
+    PatchContext r;
+
+    r.qtVersion = ArgumentsAndSettings::qtQVersion();
+    r.majorVersion = r.qtVersion.majorVersion();
+    r.minorVersion = r.qtVersion.minorVersion();
+
+    r.crossMkspec = ArgumentsAndSettings::crossMkspec();
+    r.hostMkspec = ArgumentsAndSettings::hostMkspec();
+    r.win32 = r.crossMkspec.startsWith(QStringLiteral("win32-"));
+    r.msvc = r.crossMkspec.contains(QStringLiteral("msvc"));
+    r.android = r.crossMkspec.startsWith(QStringLiteral("android"));
+    r.discoverBinaries = ArgumentsAndSettings::discoverBinaries();
+
+    r.qtDir = QDir(ArgumentsAndSettings::qtDir()).absolutePath();
+    r.oldDir = QDir(ArgumentsAndSettings::oldDir()).absolutePath();
+    r.newDir = QDir(ArgumentsAndSettings::newDir()).absolutePath();
+    if (!ArgumentsAndSettings::buildDir().isEmpty())
+        r.buildDir = QDir(ArgumentsAndSettings::buildDir()).absolutePath();
+
+    r.canonicalOldDir = canonicalPath(r.oldDir);
+    r.canonicalOldLibDir = canonicalPath(r.oldDir + QStringLiteral("/lib"));
+    r.canonicalOldIncludeDir = canonicalPath(r.oldDir + QStringLiteral("/include"));
+    if (!r.buildDir.isEmpty()) {
+        r.canonicalBuildDir = canonicalPath(r.buildDir);
+        r.canonicalBuildLibDir = canonicalPath(r.buildDir + QStringLiteral("/lib"));
+    }
+
+    r.newDirPath = QDir::fromNativeSeparators(r.newDir).toUtf8();
+    r.newLibDirPath = QDir::fromNativeSeparators(r.newDir + QStringLiteral("/lib")).toUtf8();
+    r.newIncludeDirPath = QDir::fromNativeSeparators(r.newDir + QStringLiteral("/include")).toUtf8();
+    r.newDirEscapedNativePath = escapedNativePath(r.newDir);
+    r.newLibDirEscapedNativePath = escapedNativePath(r.newDir + QStringLiteral("/lib"));
+
+    return r;
+}
+
+QByteArray PatchContext::canonicalPath(const QString &path)
+{
+    if (isCanonicalAscii(path)) {
+#ifdef Q_OS_WIN
+        return path.toLatin1().toLower();
+#else
+        return path.toLatin1();
+#endif
+    }
+
+    QString r = QDir::cleanPath(QDir::fromNativeSeparators(path));
+    if (QDir::isRelativePath(r))
+        r = QDir::cleanPath(QDir::current().absoluteFilePath(r));
+#ifdef Q_OS_WIN
+    r = r.toLower();
+#endif
+    return r.toUtf8();
+}
+
+bool PatchContext::isOldDir(const QString &path) const
+{
+    return isCanonical(path, canonicalOldDir);
+}
+
+bool PatchContext::isOldLibDir(const QString &path) const
+{
+    return isCanonical(path, canonicalOldLibDir);
+}
+
+bool PatchContext::isOldIncludeDir(const QString &path) const
+{
+    return isCanonical(path, canonicalOldIncludeDir);
+}
+
+bool PatchContext::isBuildDir(const QString &path) const
+{
+    return !canonicalBuildDir.isEmpty() && isCanonical(path, canonicalBuildDir);
+}
+
+bool PatchContext::isBuildLibDir(const QString &path) const
+{
+    return !canonicalBuildLibDir.isEmpty() && isCanonical(path, canonicalBuildLibDir);
+}
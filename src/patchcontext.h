@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPPATCHCONTEXT_H
+#define QQBPPATCHCONTEXT_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVersionNumber>
+
+// The settings of one patch run as the patchers need them, built once by prepare() after the Qt dir is detected.
+// It is passed to the patchers as a const reference and never changed while they run, so they may read it from any thread.
+// Dirs are kept in canonical form (see canonicalPath()) as well, so a path is matched against them by comparing bytes instead of through QDir.
+struct PatchContext
+{
+    PatchContext();
+
+    static PatchContext fromSettings();
+
+    // Absolute, cleaned, '/' separated and UTF-8 encoded. Lower case on Windows, whose file systems are case insensitive.
+    static QByteArray canonicalPath(const QString &path);
+
+    bool isOldDir(const QString &path) const;
+    bool isOldLibDir(const QString &path) const;
+    bool isOldIncludeDir(const QString &path) const;
+    // always false without a build dir
+    bool isBuildDir(const QString &path) const;
+    bool isBuildLibDir(const QString &path) const;
+
+    QVersionNumber qtVersion;
+    int majorVersion;
+    int minorVersion;
+
+    QString crossMkspec;
+    QString hostMkspec;
+    // crossMkspec starts with "win32-"
+    bool win32;
+    // crossMkspec contains "msvc"
+    bool msvc;
+    // crossMkspec starts with "android"
+    bool android;
+    // BinaryPatcher searches all binaries for the keys
+    bool discoverBinaries;
+
+    // absolute
+    QString qtDir;
+    QString oldDir;
+    QString newDir;
+    // empty if not given
+    QString buildDir;
+
+    QByteArray canonicalOldDir;
+    QByteArray canonicalOldLibDir;
+    QByteArray canonicalOldIncludeDir;
+    QByteArray canonicalBuildDir;
+    QByteArray canonicalBuildLibDir;
+
+    // replacements, '/' separated and UTF-8 encoded
+    QByteArray newDirPath;
+    QByteArray newLibDirPath;
+    QByteArray newIncludeDirPath;
+    // the same with native separators, backslashes doubled as in qmake and libtool files
+    QByteArray newDirEscapedNativePath;
+    QByteArray newLibDirEscapedNativePath;
+};
+
+#endif
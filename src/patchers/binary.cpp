@@ -1,13 +1,219 @@
 // SPDX-License-Identifier: Unlicense
 
-#include "argument.h"
+#include "archive.h"
+#include "backup.h"
+#include "elf.h"
+#include "fileindex.h"
 #include "log.h"
+#include "macho.h"
+#include "manifest.h"
 #include "patch.h"
+#include "patchcontext.h"
+#include "patternmatcher.h"
+#include "pe.h"
+#include "trace.h"
 #include <QDir>
 #include <QFile>
-#include <QProcess>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
 #include <QString>
 #include <QStringList>
+#include <QThreadPool>
+
+#include <algorithm>
+
+namespace {
+
+struct ChangedRange
+{
+    qint64 offset;
+    QByteArray bytes;
+    // kept for the undo journal
+    QByteArray oldBytes;
+};
+
+// compare replacement with the bytes at offset, record only the runs of bytes which differ
+void appendChangedRanges(const char *data, qint64 size, qint64 offset, const QByteArray &replacement, QList<ChangedRange> *changes)
+{
+    qint64 length = qMin<qint64>(replacement.length(), size - offset);
+    qint64 i = 0;
+    while (i < length) {
+        if (data[offset + i] == replacement.at(i)) {
+            ++i;
+            continue;
+        }
+
+        qint64 start = i;
+        while (i < length && data[offset + i] != replacement.at(i))
+            ++i;
+
+        ChangedRange change;
+        change.offset = offset + start;
+        change.bytes = replacement.mid(start, i - start);
+        change.oldBytes = QByteArray(data + change.offset, i - start);
+        changes->append(change);
+    }
+}
+
+struct SearchRange
+{
+    qint64 offset;
+    qint64 size;
+};
+
+SearchRange makeRange(qint64 offset, qint64 size)
+{
+    SearchRange range;
+    range.offset = offset;
+    range.size = size;
+    return range;
+}
+
+// The members of a static library which may hold the keys: the ones defining QLibraryInfo, which qconfig.cpp is compiled into.
+// They are looked up in the symbol index, and by name for archives without one.
+void archiveRanges(const char *data, qint64 size, QVector<SearchRange> *ranges)
+{
+    QVector<Archive::Member> members;
+    if (!Archive::readMembers(data, size, &members))
+        return;
+
+    QSet<qint64> defining;
+    QVector<Archive::Symbol> symbols;
+    if (Archive::readSymbols(data, members, &symbols)) {
+        foreach (const Archive::Symbol &symbol, symbols) {
+            if (symbol.name.contains("QLibraryInfo"))
+                defining.insert(symbol.member);
+        }
+    }
+
+    foreach (const Archive::Member &member, members) {
+        // member names of COFF archives are paths of the objects
+        QByteArray baseName = member.name.mid(qMax(member.name.lastIndexOf('/'), member.name.lastIndexOf('\\')) + 1);
+        if (defining.contains(member.header) || baseName.startsWith("qlibraryinfo.") || baseName.startsWith("qconfig."))
+            *ranges << makeRange(member.offset, member.size);
+    }
+}
+
+// The sections of an executable or shared library which may hold the keys.
+// They are initialized const char arrays, placed with the read only data, or with the data of relocatable code.
+void sectionRanges(const char *data, qint64 size, QVector<SearchRange> *ranges)
+{
+    QVector<Elf::Section> elfSections;
+    if (Elf::readSections(data, size, &elfSections)) {
+        foreach (const Elf::Section &section, elfSections) {
+            if (section.name == ".rodata" || section.name == ".data" || section.name == ".data.rel.ro" || section.name.startsWith(".rodata.") || section.name.startsWith(".data."))
+                *ranges << makeRange(section.offset, section.size);
+        }
+        return;
+    }
+
+    QVector<Pe::Section> peSections;
+    if (Pe::readSections(data, size, &peSections)) {
+        foreach (const Pe::Section &section, peSections) {
+            if (section.name == ".rdata" || section.name == ".data")
+                *ranges << makeRange(section.offset, section.size);
+        }
+        return;
+    }
+
+    QVector<MachO::Section> machOSections;
+    if (MachO::readSections(data, size, &machOSections)) {
+        foreach (const MachO::Section &section, machOSections) {
+            if (section.segment == "__DATA" || section.segment == "__DATA_CONST" || (section.segment == "__TEXT" && (section.name == "__const" || section.name == "__cstring")))
+                *ranges << makeRange(section.offset, section.size);
+        }
+    }
+}
+
+// The parts of a file which may hold the keys, found by reading the headers of the file.
+// The whole file is searched if its format is unknown, or nothing is found in the headers.
+QVector<SearchRange> searchRanges(const char *data, qint64 size)
+{
+    QVector<SearchRange> r;
+    archiveRanges(data, size, &r);
+    if (r.isEmpty())
+        sectionRanges(data, size, &r);
+
+    if (r.isEmpty())
+        r << makeRange(0, size);
+    return r;
+}
+
+bool isWholeFile(const QVector<SearchRange> &ranges, qint64 size)
+{
+    return ranges.length() == 1 && ranges.first().offset == 0 && ranges.first().size == size;
+}
+
+template <typename Pair>
+QList<QByteArray> keysOf(const QList<Pair> &l)
+{
+    QList<QByteArray> r;
+    foreach (const Pair &i, l)
+        r << i.first;
+    return r;
+}
+
+// Searches one file for the keys. Files without them cost one read through the file, as the shared "qt_" prefix is searched using memchr.
+class DiscoveryJob : public QRunnable
+{
+public:
+    DiscoveryJob(const QString &fileName, const QString &path, const PatternMatcher *markers, QMutex *mutex, QStringList *found)
+        : fileName(fileName)
+        , path(path)
+        , markers(markers)
+        , mutex(mutex)
+        , found(found)
+    {
+    }
+
+    void run() override
+    {
+        TraceSpan span("discover", "scan", path);
+
+        QFile f(fileName);
+        if (!f.open(QIODevice::ReadOnly))
+            return;
+
+        qint64 size = f.size();
+        span.setBytes(size);
+        QByteArray buffer;
+        uchar *mapped = f.map(0, size);
+        const char *data = reinterpret_cast<const char *>(mapped);
+        if (mapped == nullptr) {
+            buffer = f.readAll();
+            data = buffer.constData();
+            size = buffer.size();
+        }
+
+        bool hit = false;
+        foreach (const SearchRange &range, searchRanges(data, size)) {
+            if (!markers->findAll(data + range.offset, range.size).isEmpty()) {
+                hit = true;
+                break;
+            }
+        }
+
+        if (mapped != nullptr)
+            f.unmap(mapped);
+
+        if (hit) {
+            QMutexLocker locker(mutex);
+            *found << path;
+        }
+    }
+
+private:
+    QString fileName;
+    QString path;
+    const PatternMatcher *markers;
+    QMutex *mutex;
+    QStringList *found;
+};
+
+}
 
 class BinaryPatcher : public Patcher
 {
@@ -17,14 +223,15 @@ public:
     Q_INVOKABLE BinaryPatcher();
     ~BinaryPatcher() override;
 
-    QStringList findFileToPatch() const override;
-    bool patchFile(const QString &file) const override;
+    QStringList findFileToPatch(const PatchContext &context) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
 
-    QStringList findFileToPatch4() const;
-    QStringList findFileToPatch5() const;
+    QStringList findFileToPatch4(const PatchContext &context) const;
+    QStringList findFileToPatch5(const PatchContext &context) const;
+    QStringList discoverBinaries(const PatchContext &context, const QStringList &known) const;
 
     QStringList collectBinaryFilesForQt4Mac() const;
-    void changeBinaryPathsForQt4Mac(const QString &file) const;
+    void changeBinaryPathsForQt4Mac(const PatchContext &context, const QString &file, const char *data, qint64 size, QList<ChangedRange> *changes) const;
     bool isQmakeOrQtCoreForQt4Mac(const QString &file) const;
     QString getPathForQt4Mac(const QString &fileName, QString &relativeToRet) const;
 };
@@ -37,24 +244,83 @@ BinaryPatcher::~BinaryPatcher()
 {
 }
 
-QStringList BinaryPatcher::findFileToPatch() const
+QStringList BinaryPatcher::findFileToPatch(const PatchContext &context) const
 {
-    if (ArgumentsAndSettings::qtQVersion().majorVersion() == 5)
-        return findFileToPatch5();
-    else if (ArgumentsAndSettings::qtQVersion().majorVersion() == 4)
-        return findFileToPatch4();
+    QStringList r;
+    if (context.majorVersion == 5)
+        r = findFileToPatch5(context);
+    else if (context.majorVersion == 4)
+        r = findFileToPatch4(context);
+    else
+        return r;
+
+    if (context.discoverBinaries)
+        r << discoverBinaries(context, r);
 
-    return QStringList();
+    return r;
+}
+
+// Searches all files in bin, lib, libexec and plugins for the keys, in parallel using the global thread pool.
+// This finds the tools and other copies of QtCore, such as the ones for another target, which are not in the lists above.
+QStringList BinaryPatcher::discoverBinaries(const PatchContext &context, const QStringList &known) const
+{
+    // every Qt version has qt_prfxpath=
+    static const PatternMatcher markers({"qt_prfxpath=", "qt_epfxpath=", "qt_hpfxpath="});
+    // clang-format off
+    static const QStringList dirs {
+        QStringLiteral("bin/"),
+        QStringLiteral("lib/"),
+        QStringLiteral("libexec/"),
+        QStringLiteral("plugins/"),
+    };
+    // clang-format on
+
+    QList<const FileIndexEntry *> files = fileIndex().select([](const FileIndexEntry &e) {
+        if (e.type != FileIndexEntry::File || e.symLink || e.size < 12)
+            return false;
+        foreach (const QString &dir, dirs) {
+            if (e.path.startsWith(dir))
+                return true;
+        }
+        return false;
+    });
+    // largest first, so that the pool does not end up waiting for a big library started last
+    std::sort(files.begin(), files.end(), [](const FileIndexEntry *a, const FileIndexEntry *b) {
+        return a->size > b->size;
+    });
+
+    QDir qtDir(context.qtDir);
+    QMutex mutex;
+    QStringList found;
+    QThreadPool *pool = QThreadPool::globalInstance();
+    foreach (const FileIndexEntry *e, files)
+        pool->start(new DiscoveryJob(qtDir.absoluteFilePath(e->path), e->path, &markers, &mutex, &found));
+    pool->waitForDone();
+
+    // the known ones may be symlinks to the files found, such as lib/libQt5Core.so
+    QSet<QString> knownFiles;
+    foreach (const QString &f, known)
+        knownFiles.insert(QFileInfo(qtDir.absoluteFilePath(f)).canonicalFilePath());
+
+    QStringList r;
+    foreach (const QString &f, found) {
+        if (!knownFiles.contains(QFileInfo(qtDir.absoluteFilePath(f)).canonicalFilePath()))
+            r << f;
+    }
+    std::sort(r.begin(), r.end());
+
+    QBPLOGV([&]() { return QString(QStringLiteral("BinaryPatcher: searched %1 files for the keys, also patching:\n%2")).arg(files.length()).arg(r.join(QStringLiteral("\n"))); });
+    return r;
 }
 
-QStringList BinaryPatcher::findFileToPatch4() const
+QStringList BinaryPatcher::findFileToPatch4(const PatchContext &context) const
 {
     QStringList r;
     QStringList n;
 
     // qmake or qmake.exe
-    QDir qtDir(ArgumentsAndSettings::qtDir());
-    if (ArgumentsAndSettings::hostMkspec().startsWith(QStringLiteral("win32"))) {
+    const FileIndex &qtDir = fileIndex();
+    if (context.hostMkspec.startsWith(QStringLiteral("win32"))) {
         if (qtDir.exists(QStringLiteral("bin/qmake.exe")))
             r << QStringLiteral("bin/qmake.exe");
         else
@@ -66,12 +332,12 @@ QStringList BinaryPatcher::findFileToPatch4() const
             QBPLOGW(QStringLiteral("Cannot find bin/qmake"));
     }
 
-    if (ArgumentsAndSettings::hostMkspec() == ArgumentsAndSettings::crossMkspec()) {
+    if (context.hostMkspec == context.crossMkspec) {
         bool exist = false;
 
         // for non-cross shared/dynamic builds, search QtCore4.dll/QtCored4.dll(on Windows),
         // or libQtCore.so(on Unix-like system such as linux), libQtCore.dylib(on macOS)
-        if (ArgumentsAndSettings::hostMkspec().startsWith(QStringLiteral("win32"))) {
+        if (context.hostMkspec.startsWith(QStringLiteral("win32"))) {
             if (qtDir.exists(QStringLiteral("bin/QtCore4.dll"))) {
                 exist = true;
                 r << QStringLiteral("bin/QtCore4.dll");
@@ -92,7 +358,7 @@ QStringList BinaryPatcher::findFileToPatch4() const
                 r << QStringLiteral("lib/QtCored4.dll");
             } else
                 n << QStringLiteral("lib/QtCored4.dll");
-        } else if (ArgumentsAndSettings::hostMkspec().startsWith(QStringLiteral("macx")))
+        } else if (context.hostMkspec.startsWith(QStringLiteral("macx")))
             return collectBinaryFilesForQt4Mac();
         else {
             if (qtDir.exists(QStringLiteral("lib/libQtCore.so.4"))) {
@@ -110,14 +376,14 @@ QStringList BinaryPatcher::findFileToPatch4() const
     return r;
 }
 
-QStringList BinaryPatcher::findFileToPatch5() const
+QStringList BinaryPatcher::findFileToPatch5(const PatchContext &context) const
 {
     QStringList r;
     QStringList n;
 
     // qmake or qmake.exe
-    QDir qtDir(ArgumentsAndSettings::qtDir());
-    if (ArgumentsAndSettings::hostMkspec().startsWith(QStringLiteral("win32"))) {
+    const FileIndex &qtDir = fileIndex();
+    if (context.hostMkspec.startsWith(QStringLiteral("win32"))) {
         if (qtDir.exists(QStringLiteral("bin/qmake.exe")))
             r << QStringLiteral("bin/qmake.exe");
         else
@@ -129,12 +395,12 @@ QStringList BinaryPatcher::findFileToPatch5() const
             QBPLOGW(QStringLiteral("Cannot find bin/qmake"));
     }
 
-    if (ArgumentsAndSettings::hostMkspec() == ArgumentsAndSettings::crossMkspec()) {
+    if (context.hostMkspec == context.crossMkspec) {
         bool exist = false;
 
         // for non-cross shared/dynamic builds, search Qt5Core.dll/Qt5Cored.dll(on Windows),
         // or libQt5Core.so(on Unix-like system such as linux), libQt5Core.dylib(on macOS)
-        if (ArgumentsAndSettings::hostMkspec().startsWith(QStringLiteral("win32"))) {
+        if (context.hostMkspec.startsWith(QStringLiteral("win32"))) {
             if (qtDir.exists(QStringLiteral("bin/Qt5Core.dll"))) {
                 exist = true;
                 r << QStringLiteral("bin/Qt5Core.dll");
@@ -145,7 +411,7 @@ QStringList BinaryPatcher::findFileToPatch5() const
                 r << QStringLiteral("bin/Qt5Cored.dll");
             } else
                 n << QStringLiteral("bin/Qt5Cored.dll");
-        } else if (ArgumentsAndSettings::hostMkspec().startsWith(QStringLiteral("macx"))) {
+        } else if (context.hostMkspec.startsWith(QStringLiteral("macx"))) {
             // treat with framework/framework-less builds
             if (qtDir.exists(QStringLiteral("lib/QtCore.framework/QtCore"))) {
                 exist = true;
@@ -169,7 +435,7 @@ QStringList BinaryPatcher::findFileToPatch5() const
 
         if (!exist) {
             // check for static builds, search Qt5Core.lib/Qt5Cored.lib(if build is Windows MSVC), or libQt5Core.a(otherwise...)
-            if (ArgumentsAndSettings::hostMkspec().contains(QStringLiteral("msvc"))) {
+            if (context.hostMkspec.contains(QStringLiteral("msvc"))) {
                 if (qtDir.exists(QStringLiteral("lib/Qt5Core.lib"))) {
                     exist = true;
                     r << QStringLiteral("lib/Qt5Core.lib");
@@ -201,52 +467,29 @@ QStringList BinaryPatcher::findFileToPatch5() const
 QStringList BinaryPatcher::collectBinaryFilesForQt4Mac() const
 {
     QStringList r;
+    const FileIndex &qtDir = fileIndex();
 
-    QDir libDir(ArgumentsAndSettings::qtDir());
-    if (libDir.cd(QStringLiteral("lib"))) {
-        libDir.setFilter(QDir::NoDotAndDotDot | QDir::Dirs | QDir::NoSymLinks);
-        libDir.setNameFilters({QStringLiteral("Qt*.framework"), QStringLiteral("phonon.framework")});
-        QStringList l = libDir.entryList();
+    if (qtDir.isDir(QStringLiteral("lib"))) {
+        QStringList l = qtDir.entryList(QStringLiteral("lib"), {QStringLiteral("Qt*.framework"), QStringLiteral("phonon.framework")}, FileIndex::Dirs | FileIndex::NoSymLinks);
         foreach (const QString &f, l) {
-            QDir frameworkDir = libDir;
-            if (!frameworkDir.cd(f))
-                continue;
-
-            QFileInfo fi(frameworkDir.absolutePath());
-            QString baseName = fi.baseName();
-            QString libPath = QStringLiteral("Versions/4/") + baseName;
+            QString baseName = QFileInfo(f).baseName();
+            QString libPath = f + QStringLiteral("/Versions/4/") + baseName;
 
-            if (frameworkDir.exists(libPath))
-                r << (QStringLiteral("lib/") + f + QStringLiteral("/Versions/4/") + baseName);
+            if (qtDir.exists(libPath))
+                r << libPath;
         }
 
-        libDir.setFilter(QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Readable);
-        libDir.setNameFilters({QStringLiteral("libQt*.dylib"), QStringLiteral("libphonon.dylib")});
-        l = libDir.entryList();
-        foreach (const QString &f, l)
-            r << (QStringLiteral("lib/") + f);
+        r << qtDir.entryList(QStringLiteral("lib"), {QStringLiteral("libQt*.dylib"), QStringLiteral("libphonon.dylib")}, FileIndex::Files | FileIndex::NoSymLinks);
     }
 
-    QDir pluginDir(ArgumentsAndSettings::qtDir());
-    if (pluginDir.cd(QStringLiteral("plugins"))) {
-        pluginDir.setFilter(QDir::NoDotAndDotDot | QDir::Files | QDir::AllDirs | QDir::NoSymLinks);
-        pluginDir.setNameFilters({QStringLiteral("*.dylib")});
-        QFileInfoList l = pluginDir.entryInfoList();
-        foreach (const QFileInfo &f, l) {
-            if (f.isDir()) {
-                QDir d(f.absoluteFilePath());
-                d.setFilter(QDir::NoDotAndDotDot | QDir::Files | QDir::NoSymLinks);
-                d.setNameFilters({QStringLiteral("*.dylib")});
-                QStringList l2 = d.entryList();
-                foreach (const QString &f2, l2)
-                    r << (QStringLiteral("plugins/") + f.fileName() + QStringLiteral("/") + f2);
-            } else
-                r << (QStringLiteral("plugins/") + f.fileName());
-        }
+    if (qtDir.isDir(QStringLiteral("plugins"))) {
+        r << qtDir.entryList(QStringLiteral("plugins"), {QStringLiteral("*.dylib")}, FileIndex::Files | FileIndex::NoSymLinks);
+        QStringList l = qtDir.entryList(QStringLiteral("plugins"), QStringList(), FileIndex::Dirs | FileIndex::NoSymLinks);
+        foreach (const QString &d, l)
+            r << qtDir.entryList(d, {QStringLiteral("*.dylib")}, FileIndex::Files | FileIndex::NoSymLinks);
     }
 
-    QDir binDir(ArgumentsAndSettings::qtDir());
-    if (binDir.cd(QStringLiteral("bin"))) {
+    if (qtDir.isDir(QStringLiteral("bin"))) {
         // clang-format off
         static const QStringList knownQt4Apps {
             QStringLiteral("Assistant.app"),
@@ -260,20 +503,14 @@ QStringList BinaryPatcher::collectBinaryFilesForQt4Mac() const
         // clang-format on
 
         foreach (const QString &f, knownQt4Apps) {
-            if (!binDir.exists(f))
+            if (!qtDir.isDir(QStringLiteral("bin/") + f))
                 continue;
 
-            QDir appDir(binDir);
+            QString baseName = QFileInfo(f).baseName();
+            QString binPath = QStringLiteral("bin/") + f + QStringLiteral("/Contents/MacOS/") + baseName;
 
-            if (!appDir.cd(f))
-                continue;
-
-            QFileInfo fi(appDir.absolutePath());
-            QString baseName = fi.baseName();
-            QString binPath = QStringLiteral("Contents/MacOS/") + baseName;
-
-            if (appDir.exists(binPath))
-                r << (QStringLiteral("bin/") + f + QStringLiteral("/Contents/MacOS/") + baseName);
+            if (qtDir.exists(binPath))
+                r << binPath;
         }
 
         // clang-format off
@@ -298,7 +535,7 @@ QStringList BinaryPatcher::collectBinaryFilesForQt4Mac() const
         // clang-format on
 
         foreach (const QString &f, knownQt4Tools) {
-            if (!binDir.exists(f))
+            if (!qtDir.exists(QStringLiteral("bin/") + f))
                 continue;
 
             r << (QStringLiteral("bin/") + f);
@@ -307,65 +544,50 @@ QStringList BinaryPatcher::collectBinaryFilesForQt4Mac() const
     return r;
 }
 
-void BinaryPatcher::changeBinaryPathsForQt4Mac(const QString &file) const
+// Changes the install names of the libraries in old lib dir, as "install_name_tool -id" and "install_name_tool -change" would.
+void BinaryPatcher::changeBinaryPathsForQt4Mac(const PatchContext &context, const QString &file, const char *data, qint64 size, QList<ChangedRange> *changes) const
 {
-    // TODO: add judgement to waitForFinished
-    // Since there will be no more builds of Qt 4 from me, I might not fix this
-    QProcess otool;
-    otool.start(QStringLiteral("otool"), {QStringLiteral("-L"), file});
-    otool.waitForFinished();
-
-    QString output = QString::fromUtf8(otool.readAllStandardOutput());
-    QBPLOGV(QStringLiteral("otool output:"));
-    QBPLOGV(output);
-
-#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
-    QStringList outputLines = output.split(QStringLiteral("\n"), QString::SkipEmptyParts);
-#else
-    QStringList outputLines = output.split(QStringLiteral("\n"), Qt::SkipEmptyParts);
-#endif
-    outputLines.removeFirst();
-
-    QDir libDir(ArgumentsAndSettings::oldDir() + QStringLiteral("/lib"));
-    QDir newDir(ArgumentsAndSettings::newDir() + QStringLiteral("/lib"));
-
-    if (file.contains(QStringLiteral(".dylib")) || file.contains(QStringLiteral(".framework"))) {
-        // The first line of their name is "LC_ID_DYLIB", it should be changed using "install_name_tool -id"
-        QString id = outputLines.first();
-        QString fileName = id.split(QStringLiteral("(compatibility")).first().trimmed();
-        if (fileName.startsWith(QStringLiteral("/"))) {
-            QBPLOGV(QStringLiteral("Qt library detected, installing LC_ID_DYLIB"));
-            QString relativeToPath;
-            QString path = getPathForQt4Mac(fileName, relativeToPath);
-
-            // check that this file is in libdir, since libs in plugin dir should not install "LC_ID_DYLIB"
-            if (QDir::toNativeSeparators(path) == QDir::toNativeSeparators(libDir.absolutePath())) {
-                QString newPath = newDir.absoluteFilePath(relativeToPath);
-                QProcess installNameTool;
-                installNameTool.start(QStringLiteral("install_name_tool"), {QStringLiteral("-id"), newPath, file});
-                installNameTool.waitForFinished();
-                QBPLOGV(installNameTool.program() + QStringLiteral(" ") + installNameTool.arguments().join(QStringLiteral(" ")));
-            }
-        } else {
-            QBPLOGV(QStringLiteral("Plugin detected."));
-        }
-        outputLines.removeFirst();
+    // e.g. static libraries, which hold the keys as well and are found by discovery
+    if (!MachO::isMachO(data, size)) {
+        QBPLOGV([&]() { return QString(QStringLiteral("BinaryPatcher: %1 is not a Mach-O file, its install names are skipped.")).arg(file); });
+        return;
+    }
+
+    QVector<MachO::DylibCommand> commands;
+    if (!MachO::readDylibCommands(data, size, &commands)) {
+        QBPLOGW(QString(QStringLiteral("The load commands of %1 are broken, its install names are left unchanged.")).arg(file));
+        return;
     }
 
-    // use "install_name_tool -change" to change remaining path
-    foreach (const QString &dyld, outputLines) {
-        QString fileName = dyld.split(QStringLiteral("(compatibility")).first().trimmed();
+    QDir newLibDir(context.newDir + QStringLiteral("/lib"));
+
+    foreach (const MachO::DylibCommand &c, commands) {
+        QString fileName = QString::fromUtf8(c.name);
+        // plugins have relative ids, and libraries may be loaded relative to @executable_path, @loader_path or @rpath
+        if (!fileName.startsWith(QStringLiteral("/")))
+            continue;
+
         QString relativeToPath;
         QString path = getPathForQt4Mac(fileName, relativeToPath);
 
-        // check that used file is in libdir
-        if (QDir::toNativeSeparators(path) == QDir::toNativeSeparators(libDir.absolutePath())) {
-            QString newPath = newDir.absoluteFilePath(relativeToPath);
-            QProcess installNameTool;
-            installNameTool.start(QStringLiteral("install_name_tool"), {QStringLiteral("-change"), fileName, newPath, file});
-            installNameTool.waitForFinished();
-            QBPLOGV(installNameTool.program() + QStringLiteral(" ") + installNameTool.arguments().join(QStringLiteral(" ")));
+        // check that the file is in libdir, system libraries are left as is
+        if (!context.isOldLibDir(path))
+            continue;
+
+        QByteArray newPath = newLibDir.absoluteFilePath(relativeToPath).toUtf8();
+        QByteArray replacement = MachO::renamed(c, newPath);
+        if (replacement.isEmpty()) {
+            QBPLOGW(QString(QStringLiteral("%1 in %2 is left unchanged, %3 does not fit in the %4 bytes available in the load command. "
+                                           "The file should be linked using -headerpad_max_install_names."))
+                        .arg(fileName)
+                        .arg(file)
+                        .arg(QString::fromUtf8(newPath))
+                        .arg(c.nameCapacity - 1));
+            continue;
         }
+
+        QBPLOGV([&]() { return QString(QStringLiteral("%1: %2 %3 -> %4")).arg(file).arg(c.isId() ? QStringLiteral("id") : QStringLiteral("change")).arg(fileName).arg(QString::fromUtf8(newPath)); });
+        appendChangedRanges(data, size, c.nameOffset, replacement, changes);
     }
 }
 
@@ -398,12 +620,12 @@ QString BinaryPatcher::getPathForQt4Mac(const QString &fileName, QString &relati
         relativeToRet = fileInfo.fileName();
         r = fileInfo.absolutePath();
     }
-    QBPLOGV(QString(QStringLiteral("BinaryPatcher::getPathForQt4Mac: filename = %1, relativeToRet = %2, ret = %3")).arg(fileName).arg(relativeToRet).arg(r));
+    QBPLOGV([&]() { return QString(QStringLiteral("BinaryPatcher::getPathForQt4Mac: filename = %1, relativeToRet = %2, ret = %3")).arg(fileName).arg(relativeToRet).arg(r); });
 
     return r;
 }
 
-bool BinaryPatcher::patchFile(const QString &file) const
+bool BinaryPatcher::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
 {
     typedef QPair<QByteArray, QString> KeySuffixPair;
 
@@ -428,45 +650,136 @@ bool BinaryPatcher::patchFile(const QString &file) const
     };
     // clang-format on
 
+    // all keys are searched in one pass over the file
+    static const PatternMatcher m5(keysOf(l5));
+    static const PatternMatcher m4(keysOf(l4));
+
     const QList<KeySuffixPair> *l = &l5;
-    if (ArgumentsAndSettings::qtQVersion().majorVersion() == 4) {
-        if (ArgumentsAndSettings::hostMkspec().startsWith(QStringLiteral("macx"))) {
-            changeBinaryPathsForQt4Mac(file);
-            if (!isQmakeOrQtCoreForQt4Mac(file))
-                return true;
-        }
+    const PatternMatcher *m = &m5;
+    bool qt4Mac = false;
+    if (context.majorVersion == 4) {
+        qt4Mac = context.hostMkspec.startsWith(QStringLiteral("macx"));
         l = &l4;
+        m = &m4;
     }
 
-    QDir qtDir(ArgumentsAndSettings::qtDir());
+    QDir qtDir(context.qtDir);
     QFile binFile(qtDir.absoluteFilePath(file));
-    if (binFile.exists() && binFile.open(QIODevice::ReadOnly)) {
-        QByteArray arr = binFile.readAll();
-        foreach (const KeySuffixPair &i, *l) {
-            int index = 0;
-            while ((index = arr.indexOf(i.first, index)) != -1) {
-                QByteArray plusPath = i.first;
-                if (ArgumentsAndSettings::qtQVersion().majorVersion() == 5)
-                    plusPath.append(QDir::fromNativeSeparators(QDir(ArgumentsAndSettings::newDir() + i.second).absolutePath()).toUtf8());
-                else
-                    plusPath.append(QDir::toNativeSeparators(QDir(ArgumentsAndSettings::newDir() + i.second).absolutePath()).toUtf8());
-                plusPath.append('\0');
-                arr.replace(index, plusPath.length(), plusPath);
-                index += plusPath.length();
+    if (!binFile.exists() || !binFile.open(QIODevice::ReadOnly)) {
+        QBPLOGE(QString(QStringLiteral("file %1 is not found or not readable during patching.")).arg(binFile.fileName()));
+        return false;
+    }
+
+    // Map the file and search the mapping, only the bytes which are really changed are written back.
+    // If the file can't be mapped, read it into memory instead.
+    // It is opened for writing only when something is changed, so read only files which are already patched don't fail the run.
+    qint64 size = binFile.size();
+    QByteArray buffer;
+    uchar *mapped = binFile.map(0, size);
+    const char *data = reinterpret_cast<const char *>(mapped);
+    if (mapped == nullptr) {
+        QBPLOGV([&]() { return QString(QStringLiteral("file %1 can't be mapped, reading it instead.")).arg(binFile.fileName()); });
+        buffer = binFile.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    QList<QByteArray> plusPaths;
+    foreach (const KeySuffixPair &i, *l) {
+        QByteArray plusPath = i.first;
+        if (context.majorVersion == 5)
+            plusPath.append(QDir::fromNativeSeparators(QDir(context.newDir + i.second).absolutePath()).toUtf8());
+        else
+            plusPath.append(QDir::toNativeSeparators(QDir(context.newDir + i.second).absolutePath()).toUtf8());
+        plusPath.append('\0');
+        plusPaths << plusPath;
+    }
+
+    // install names which can't be changed are warned about, as run paths of ELF files are
+    QList<ChangedRange> changes;
+    if (qt4Mac)
+        changeBinaryPathsForQt4Mac(context, file, data, size, &changes);
+
+    // the keys are only in QtCore and qmake on macOS, unless more binaries are discovered
+    qint64 searched = 0;
+    if (!qt4Mac || context.discoverBinaries || isQmakeOrQtCoreForQt4Mac(file)) {
+        QVector<SearchRange> ranges = searchRanges(data, size);
+        QVector<QVector<PatternMatcher::Match> > found;
+        bool any = false;
+        foreach (const SearchRange &range, ranges) {
+            found << m->findAll(data + range.offset, range.size);
+            any = any || !found.last().isEmpty();
+            searched += range.size;
+        }
+
+        // the sections are guessed from where compilers place the keys, search the whole file if they are not there
+        if (!any && !isWholeFile(ranges, size)) {
+            QBPLOGV([&]() { return QString(QStringLiteral("BinaryPatcher: no key is found in the sections of %1, searching the whole file.")).arg(file); });
+            ranges.clear();
+            ranges << makeRange(0, size);
+            found.clear();
+            found << m->findAll(data, size);
+            searched = size;
+        }
+
+        for (int i = 0; i < ranges.length(); ++i) {
+            qint64 replacedUntil = 0;
+            foreach (const PatternMatcher::Match &match, found.at(i)) {
+                // key found inside the path just replaced
+                if (match.offset < replacedUntil)
+                    continue;
+
+                const QByteArray &plusPath = plusPaths.at(match.pattern);
+                appendChangedRanges(data, size, ranges.at(i).offset + match.offset, plusPath, &changes);
+                replacedUntil = match.offset + plusPath.length();
             }
         }
-        binFile.close();
-        if (binFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-            binFile.write(arr);
+    }
+
+    // hashed for the manifest while the content is still in memory
+    QMap<qint64, QByteArray> replaced;
+    foreach (const ChangedRange &change, changes)
+        replaced.insert(change.offset, change.bytes);
+    Manifest::setContentHash(file, Manifest::hashOf(data, size, replaced));
+
+    if (mapped != nullptr)
+        binFile.unmap(mapped);
+    binFile.close();
+
+    if (!changes.isEmpty() && !binFile.open(QIODevice::ReadWrite)) {
+        QBPLOGE(QString(QStringLiteral("file %1 is not writable during patching.")).arg(binFile.fileName()));
+        return false;
+    }
+
+    // every range is journaled before the first byte of the file is written
+    foreach (const ChangedRange &change, changes) {
+        if (!backup.backupRange(file, change.offset, change.oldBytes)) {
+            binFile.close();
+            return false;
+        }
+    }
+
+    qint64 touched = 0;
+    foreach (const ChangedRange &change, changes) {
+        if (!binFile.seek(change.offset) || binFile.write(change.bytes) != change.bytes.length()) {
             binFile.close();
-        } else {
             QBPLOGE(QString(QStringLiteral("file %1 is not writable during patching.")).arg(binFile.fileName()));
             return false;
         }
-    } else {
-        QBPLOGE(QString(QStringLiteral("file %1 is not found or not readable during patching.")).arg(binFile.fileName()));
-        return false;
+        touched += change.bytes.length();
     }
+    binFile.close();
+
+    QBPLOGV([&]() {
+        return QString(QStringLiteral("BinaryPatcher: %1 bytes in %2 ranges of %3 are changed, %4 of %5 bytes searched%6."))
+            .arg(touched)
+            .arg(changes.length())
+            .arg(file)
+            .arg(searched)
+            .arg(size)
+            .arg(mapped != nullptr ? QStringLiteral(", mapped") : QString());
+    });
+
     return true;
 
     // orginal QtBinPatcher patches the following variables, which I didn't found in the binary. Maybe these variables are in Qt4 Unix or Cross-compiled versions?
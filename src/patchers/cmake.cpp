@@ -1,8 +1,13 @@
 // SPDX-License-Identifier: Unlicense
 
-#include "argument.h"
+#include "commit.h"
+#include "contentcache.h"
+#include "fileindex.h"
 #include "log.h"
 #include "patch.h"
+#include "patchcontext.h"
+#include "textlines.h"
+#include "trace.h"
 #include <QDir>
 
 class CMakePatcher : public Patcher
@@ -13,10 +18,10 @@ public:
     Q_INVOKABLE CMakePatcher();
     ~CMakePatcher() override;
 
-    QStringList findFileToPatch() const override;
-    bool patchFile(const QString &file) const override;
+    QStringList findFileToPatch(const PatchContext &context) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
 
-    bool shouldPatch(const QString &file) const;
+    bool shouldPatch(const PatchContext &context, const QString &file) const;
 };
 
 CMakePatcher::CMakePatcher()
@@ -27,10 +32,10 @@ CMakePatcher::~CMakePatcher()
 {
 }
 
-QStringList CMakePatcher::findFileToPatch() const
+QStringList CMakePatcher::findFileToPatch(const PatchContext &context) const
 {
     // Qt4 doesn't support CMake
-    if (ArgumentsAndSettings::qtQVersion().majorVersion() != 5)
+    if (context.majorVersion != 5)
         return QStringList();
 
     // patch "lib/cmake/Qt5Gui/Qt5GuiConfigExtras.cmake" in cross versions? or only for android?
@@ -39,8 +44,8 @@ QStringList CMakePatcher::findFileToPatch() const
     // no absolute patchs should be found in these variables.
     static QString fileName = QStringLiteral("lib/cmake/Qt5Gui/Qt5GuiConfigExtras.cmake");
 
-    if (ArgumentsAndSettings::crossMkspec().startsWith(QStringLiteral("android"))) {
-        if (QDir(ArgumentsAndSettings::qtDir()).exists(fileName) && shouldPatch(fileName))
+    if (context.android) {
+        if (fileIndex().exists(fileName) && shouldPatch(context, fileName))
             return {fileName};
     }
 
@@ -49,32 +54,44 @@ QStringList CMakePatcher::findFileToPatch() const
     // original QtBinPatcher patches lib/cmake/Qt5LinguistTools/Qt5LinguistToolsConfig.cmake, but I don't know why
 }
 
-bool CMakePatcher::patchFile(const QString &file) const
+namespace {
+
+// "_qt5gui_find_extra_libs(EGL "libEGL.so" "" "")" -> arguments
+bool splitFindExtraLibs(const QByteArray &line, QList<QByteArray> *arguments)
+{
+    QByteArray l = TextLines::trimmed(line);
+    if (!l.startsWith("_qt5gui_find_extra_libs("))
+        return false;
+
+    *arguments = TextLines::mid(l, 24, l.length() - 25).split(' ');
+    return true;
+}
+
+}
+
+bool CMakePatcher::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
 {
     if (file.contains(QStringLiteral("Qt5Gui"))) {
-        QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-        if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QByteArray toWrite;
-            char arr[10000];
-            while (f.readLine(arr, 9999) > 0) {
-                QString str = QString::fromUtf8(arr);
-                str = str.trimmed();
-                if (str.startsWith(QStringLiteral("_qt5gui_find_extra_libs("))) {
-                    str = str.mid(24);
-                    str.chop(1);
-                    QStringList l = str.split(QStringLiteral(" "));
-                    if (l.first() == QStringLiteral("EGL") && l.value(1) != QStringLiteral("\"EGL\""))
-                        strcpy(arr, "    _qt5gui_find_extra_libs(EGL \"EGL\" \"\" \"\")\n");
-                    else if (l.first() == QStringLiteral("OPENGL") && l.value(1) != QStringLiteral("\"GLESv2\""))
-                        strcpy(arr, "    _qt5gui_find_extra_libs(OPENGL \"GLESv2\" \"\" \"\")\n");
-                }
-                toWrite.append(arr);
-            }
-            f.close();
-
-            f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-            f.write(toWrite);
-            f.close();
+        QFile f(QDir(context.qtDir).absoluteFilePath(file));
+        QByteArray content;
+        if (contentCache().take(f.fileName(), &content)) {
+            QByteArray toWrite = TextLines::rewrite(content, [](const QByteArray &line, QByteArray *replacement) -> bool {
+                QList<QByteArray> l;
+                if (!splitFindExtraLibs(line, &l))
+                    return false;
+
+                if (l.first() == "EGL" && l.value(1) != "\"EGL\"")
+                    *replacement = "    _qt5gui_find_extra_libs(EGL \"EGL\" \"\" \"\")";
+                else if (l.first() == "OPENGL" && l.value(1) != "\"GLESv2\"")
+                    *replacement = "    _qt5gui_find_extra_libs(OPENGL \"GLESv2\" \"\" \"\")";
+                else
+                    return false;
+
+                return true;
+            });
+
+            if (!commitFile(backup, file, content, toWrite))
+                return false;
         } else
             return false;
     } else
@@ -83,30 +100,21 @@ bool CMakePatcher::patchFile(const QString &file) const
     return true;
 }
 
-bool CMakePatcher::shouldPatch(const QString &file) const
+bool CMakePatcher::shouldPatch(const PatchContext &context, const QString &file) const
 {
+    TraceSpan span("shouldPatch", metaObject()->className(), file);
+
     if (file.contains(QStringLiteral("Qt5Gui"))) {
-        QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-        if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            char arr[10000];
-            while (f.readLine(arr, 9999) > 0) {
-                QString str = QString::fromUtf8(arr);
-                str = str.trimmed();
-                if (str.startsWith(QStringLiteral("_qt5gui_find_extra_libs("))) {
-                    str = str.mid(24);
-                    str.chop(1);
-                    QStringList l = str.split(QStringLiteral(" "));
-                    QBPLOGV(l.first() + QStringLiteral(", ") + l.value(1));
-                    if (l.first() == QStringLiteral("EGL") && l.value(1) != QStringLiteral("\"EGL\"")) {
-                        f.close();
-                        return true;
-                    } else if (l.first() == QStringLiteral("OPENGL") && l.value(1) != QStringLiteral("\"GLESv2\"")) {
-                        f.close();
-                        return true;
-                    }
-                }
-            }
-            f.close();
+        QByteArray content;
+        if (contentCache().read(QDir(context.qtDir).absoluteFilePath(file), &content)) {
+            return TextLines::find(content, [](const QByteArray &line) -> bool {
+                QList<QByteArray> l;
+                if (!splitFindExtraLibs(line, &l))
+                    return false;
+
+                QBPLOGV([&l]() { return QString::fromUtf8(l.first()) + QStringLiteral(", ") + QString::fromUtf8(l.value(1)); });
+                return (l.first() == "EGL" && l.value(1) != "\"EGL\"") || (l.first() == "OPENGL" && l.value(1) != "\"GLESv2\"");
+            });
         }
     }
 
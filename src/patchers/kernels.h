@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPKERNELS_H
+#define QQBPKERNELS_H
+
+#include <QByteArray>
+#include <QString>
+
+struct PatchContext;
+
+// The rewriting done by the text patchers on the content of one file, with no file access.
+// Each is defined next to its patcher and returns content itself if nothing is changed. They are declared here so that benchmarks can call them directly.
+namespace PatcherKernels {
+
+QByteArray patchPrl(const PatchContext &context, const QByteArray &content);
+// rules of some Qt versions append the base name of fileName
+QByteArray patchPc(const PatchContext &context, const QString &fileName, const QByteArray &content);
+QByteArray patchLa(const PatchContext &context, const QByteArray &content);
+
+}
+
+#endif
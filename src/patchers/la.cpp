@@ -1,7 +1,13 @@
 // SPDX-License-Identifier: Unlicense
 
-#include "argument.h"
+#include "commit.h"
+#include "contentcache.h"
+#include "fileindex.h"
+#include "kernels.h"
 #include "patch.h"
+#include "patchcontext.h"
+#include "textlines.h"
+#include "trace.h"
 #include <QDir>
 
 class LaPatcher : public Patcher
@@ -12,10 +18,10 @@ public:
     Q_INVOKABLE LaPatcher();
     ~LaPatcher() override;
 
-    QStringList findFileToPatch() const override;
-    bool patchFile(const QString &file) const override;
+    QStringList findFileToPatch(const PatchContext &context) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
 
-    bool shouldPatch(const QString &file) const;
+    bool shouldPatch(const PatchContext &context, const QString &file) const;
 };
 
 LaPatcher::LaPatcher()
@@ -26,28 +32,25 @@ LaPatcher::~LaPatcher()
 {
 }
 
-QStringList LaPatcher::findFileToPatch() const
+QStringList LaPatcher::findFileToPatch(const PatchContext &context) const
 {
     // libtool is not supported on Windows platforms, including MSVC and MinGW
 
-    if (!ArgumentsAndSettings::crossMkspec().startsWith(QStringLiteral("win"))) {
-        QDir libDir(ArgumentsAndSettings::qtDir());
-        if (!libDir.cd(QStringLiteral("lib")))
-            return QStringList();
-
-        libDir.setFilter(QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot | QDir::Readable);
-        if (ArgumentsAndSettings::qtQVersion().majorVersion() == 5)
-            libDir.setNameFilters({QStringLiteral("libQt5*.la"), QStringLiteral("libEnginio.la")});
+    if (!context.crossMkspec.startsWith(QStringLiteral("win"))) {
+        QStringList nameFilters;
+        if (context.majorVersion == 5)
+            nameFilters = QStringList {QStringLiteral("libQt5*.la"), QStringLiteral("libEnginio.la")};
         else
-            libDir.setNameFilters({QStringLiteral("libQt*.la"), QStringLiteral("libphonon.la")});
+            nameFilters = QStringList {QStringLiteral("libQt*.la"), QStringLiteral("libphonon.la")};
         QStringList r;
-        QStringList l = libDir.entryList();
+        QStringList l = fileIndex().entryList(QStringLiteral("lib"), nameFilters, FileIndex::Files | FileIndex::NoSymLinks);
         foreach (const QString &f, l) {
-            if ((ArgumentsAndSettings::qtQVersion().majorVersion() == 4) && f.startsWith(QStringLiteral("libQt5")))
+            QString fileName = f.mid(f.lastIndexOf(QLatin1Char('/')) + 1);
+            if ((context.majorVersion == 4) && fileName.startsWith(QStringLiteral("libQt5")))
                 continue;
 
-            if (shouldPatch(f))
-                r << (QStringLiteral("lib/") + f);
+            if (shouldPatch(context, fileName))
+                r << f;
         }
         return r;
     }
@@ -55,137 +58,111 @@ QStringList LaPatcher::findFileToPatch() const
     return QStringList();
 }
 
-bool LaPatcher::patchFile(const QString &file) const
+QByteArray PatcherKernels::patchLa(const PatchContext &context, const QByteArray &content)
 {
-    QDir qtDir(ArgumentsAndSettings::qtDir());
-
-    QDir oldLibDir(ArgumentsAndSettings::oldDir() + QStringLiteral("/lib"));
-    QDir newLibDir(ArgumentsAndSettings::newDir() + QStringLiteral("/lib"));
-
     // It is assumed that no spaces is in the olddir prefix
-    QFile f(qtDir.absoluteFilePath(file));
-    if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QByteArray toWrite;
-        char arr[10000];
-        while (f.readLine(arr, 9999) > 0) {
-            QString str = QString::fromUtf8(arr);
-            str = str.trimmed();
-            if (str.startsWith(QStringLiteral("dependency_libs="))) {
-                str = str.mid(17);
-                str.chop(1);
-#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
-                QStringList l = str.split(QStringLiteral(" "), QString::SkipEmptyParts);
-#else
-                QStringList l = str.split(QStringLiteral(" "), Qt::SkipEmptyParts);
-#endif
-                QStringList r;
-                foreach (const QString &m, l) {
-                    QString n = m;
-                    if (n.startsWith(QStringLiteral("-L="))) {
-                        if (QDir(n.mid(3).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir)
-                            n = QStringLiteral("-L=") + QDir::fromNativeSeparators(newLibDir.absolutePath());
-                    } else if (n.startsWith(QStringLiteral("-L"))) {
-                        if (QDir(n.mid(2).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir)
-                            n = QStringLiteral("-L") + QDir::fromNativeSeparators(newLibDir.absolutePath());
-                    } else if (!n.startsWith(QStringLiteral("-l"))) {
-                        QFileInfo fi(QString(n).replace(QStringLiteral("\\\\"), QStringLiteral("\\")));
-                        if (QDir(fi.absolutePath()) == oldLibDir) {
-                            QFileInfo fiNew(newLibDir, fi.baseName());
-                            n = QDir::fromNativeSeparators(fiNew.absoluteFilePath());
-                        }
+    return TextLines::rewrite(content, [&](const QByteArray &line, QByteArray *replacement) -> bool {
+        QByteArray trimmedLine = TextLines::trimmed(line);
+        if (trimmedLine.startsWith("dependency_libs=")) {
+            QByteArray value = TextLines::mid(trimmedLine, 17, trimmedLine.length() - 18);
+            QByteArray patched = TextLines::rewriteTokens(value, TextLines::tokenize(value), [&](const TextLines::ValueToken &token, QByteArray *tokenReplacement) -> bool {
+                if (token.text.startsWith("-L=")) {
+                    if (context.isOldLibDir(TextLines::tokenPath(token, 3))) {
+                        *tokenReplacement = "-L=" + context.newLibDirPath;
+                        return true;
+                    }
+                } else if (token.text.startsWith("-L")) {
+                    if (context.isOldLibDir(TextLines::tokenPath(token, 2))) {
+                        *tokenReplacement = "-L" + context.newLibDirPath;
+                        return true;
+                    }
+                } else if (!token.text.startsWith("-l")) {
+                    QFileInfo fi(TextLines::tokenPath(token));
+                    if (context.isOldLibDir(fi.absolutePath())) {
+                        *tokenReplacement = context.newLibDirPath + '/' + fi.baseName().toUtf8();
+                        return true;
                     }
-                    r << n;
-                }
-                str = QStringLiteral("dependency_libs=\'") + r.join(QLatin1Char(' ')) + QStringLiteral("\'\n");
-                strcpy(arr, str.toUtf8().constData());
-            } else if (str.startsWith(QStringLiteral("libdir="))) {
-                str = str.mid(8);
-                str.chop(1);
-
-                QString equalMark;
-                if (str.startsWith(QStringLiteral("="))) {
-                    equalMark = QStringLiteral("=");
-                    str = str.mid(1);
                 }
+                return false;
+            });
+            *replacement = "dependency_libs=\'" + patched + "\'";
+            return true;
+        } else if (trimmedLine.startsWith("libdir=")) {
+            QString str = QString::fromUtf8(TextLines::mid(trimmedLine, 8, trimmedLine.length() - 9));
+
+            QByteArray equalMark;
+            if (str.startsWith(QStringLiteral("="))) {
+                equalMark = "=";
+                str = str.mid(1);
+            }
 
-                if (QDir(QString(str).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir) {
-                    str = QStringLiteral("libdir=\'") + equalMark + QDir::toNativeSeparators(newLibDir.absolutePath()).replace(QStringLiteral("\\"), QStringLiteral("\\\\"))
-                        + QStringLiteral("\'\n");
-                    strcpy(arr, str.toUtf8().constData());
-                }
+            if (context.isOldLibDir(str.replace(QStringLiteral("\\\\"), QStringLiteral("\\")))) {
+                *replacement = "libdir=\'" + equalMark + context.newLibDirEscapedNativePath + "\'";
+                return true;
             }
-            toWrite.append(arr);
         }
-        f.close();
 
-        f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-        f.write(toWrite);
-        f.close();
+        return false;
+    });
+}
+
+bool LaPatcher::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
+{
+    QDir qtDir(context.qtDir);
+
+    QFile f(qtDir.absoluteFilePath(file));
+    QByteArray content;
+    if (contentCache().take(f.fileName(), &content)) {
+        QByteArray toWrite = PatcherKernels::patchLa(context, content);
+        if (!commitFile(backup, file, content, toWrite))
+            return false;
     } else
         return false;
 
     return true;
 }
 
-bool LaPatcher::shouldPatch(const QString &file) const
+bool LaPatcher::shouldPatch(const PatchContext &context, const QString &file) const
 {
-    QDir libDir(ArgumentsAndSettings::qtDir());
-    if (!libDir.cd(QStringLiteral("lib")))
+    TraceSpan span("shouldPatch", metaObject()->className(), file);
+
+    if (!fileIndex().isDir(QStringLiteral("lib")))
         return false;
 
-    QDir oldLibDir(ArgumentsAndSettings::oldDir() + QStringLiteral("/lib"));
+    QDir libDir(context.qtDir + QStringLiteral("/lib"));
 
     // it is assumed that no spaces is in the olddir prefix
 
-    QFile f(libDir.absoluteFilePath(file));
-    if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        char arr[10000];
-        while (f.readLine(arr, 9999) > 0) {
-            QString str = QString::fromUtf8(arr);
-            str = str.trimmed();
-            if (str.startsWith(QStringLiteral("dependency_libs="))) {
-                str = str.mid(17);
-                str.chop(1);
-#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
-                QStringList l = str.split(QStringLiteral(" "), QString::SkipEmptyParts);
-#else
-                QStringList l = str.split(QStringLiteral(" "), Qt::SkipEmptyParts);
-#endif
-                foreach (const QString &m, l) {
-                    QString n = m;
-                    if (n.startsWith(QStringLiteral("-L="))) {
-                        if (QDir(n.mid(3).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir) {
-                            f.close();
-                            return true;
-                        }
-                    } else if (n.startsWith(QStringLiteral("-L"))) {
-                        if (QDir(n.mid(2).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir) {
-                            f.close();
-                            return true;
-                        }
-                    } else if (!n.startsWith(QStringLiteral("-l"))) {
-                        if (QDir(QFileInfo(QString(n).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))).absolutePath()) == oldLibDir) {
-                            f.close();
-                            return true;
-                        }
-                    }
-                }
-            } else if (str.startsWith(QStringLiteral("libdir="))) {
-                str = str.mid(8);
-                str.chop(1);
-                if (str.startsWith(QStringLiteral("=")))
-                    str = str.mid(1);
-
-                if (QDir(QString(str).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir) {
-                    f.close();
-                    return true;
+    QByteArray content;
+    if (!contentCache().read(libDir.absoluteFilePath(file), &content))
+        return false;
+
+    return TextLines::find(content, [&](const QByteArray &line) -> bool {
+        QByteArray trimmedLine = TextLines::trimmed(line);
+        if (trimmedLine.startsWith("dependency_libs=")) {
+            QByteArray value = TextLines::mid(trimmedLine, 17, trimmedLine.length() - 18);
+            foreach (const TextLines::ValueToken &token, TextLines::tokenize(value)) {
+                if (token.text.startsWith("-L=")) {
+                    if (context.isOldLibDir(TextLines::tokenPath(token, 3)))
+                        return true;
+                } else if (token.text.startsWith("-L")) {
+                    if (context.isOldLibDir(TextLines::tokenPath(token, 2)))
+                        return true;
+                } else if (!token.text.startsWith("-l")) {
+                    if (context.isOldLibDir(QFileInfo(TextLines::tokenPath(token)).absolutePath()))
+                        return true;
                 }
             }
+        } else if (trimmedLine.startsWith("libdir=")) {
+            QString str = QString::fromUtf8(TextLines::mid(trimmedLine, 8, trimmedLine.length() - 9));
+            if (str.startsWith(QStringLiteral("=")))
+                str = str.mid(1);
+
+            return context.isOldLibDir(str.replace(QStringLiteral("\\\\"), QStringLiteral("\\")));
         }
-        f.close();
-    }
 
-    return false;
+        return false;
+    });
 }
 
 REGISTER_PATCHER(LaPatcher)
@@ -1,9 +1,18 @@
 // SPDX-License-Identifier: Unlicense
 
-#include "argument.h"
+#include "commit.h"
+#include "contentcache.h"
+#include "fileindex.h"
+#include "kernels.h"
 #include "patch.h"
+#include "patchcontext.h"
+#include "ruletable.h"
+#include "textlines.h"
+#include "trace.h"
 #include <QDir>
 
+#include <cstring>
+
 class PcPatcher : public Patcher
 {
     Q_OBJECT
@@ -12,14 +21,10 @@ public:
     Q_INVOKABLE PcPatcher();
     ~PcPatcher() override;
 
-    QStringList findFileToPatch() const override;
-    bool patchFile(const QString &file) const override;
-
-    bool shouldPatch(const QString &file) const;
+    QStringList findFileToPatch(const PatchContext &context) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
 
-    void patchQt5(const QString &str, char *arr, const QDir &newDir) const;
-    void patchQt4MinGW(const QString &str, char *arr, const QDir &newDir, const QString &fBaseName) const;
-    void patchQt4Unix(const QString &str, char *arr, const QDir &newDir, const QString &fBaseName) const;
+    bool shouldPatch(const PatchContext &context, const QString &file) const;
 };
 
 PcPatcher::PcPatcher()
@@ -30,31 +35,25 @@ PcPatcher::~PcPatcher()
 {
 }
 
-QStringList PcPatcher::findFileToPatch() const
+QStringList PcPatcher::findFileToPatch(const PatchContext &context) const
 {
     // patch lib/pkgconfig/Qt*.pc if pkg-config is enabled, otherwise patch nothing
     // Note that pkg-config is not supported on MSVC
-    if (!ArgumentsAndSettings::crossMkspec().contains(QStringLiteral("msvc"))) {
-        QDir pcDir(ArgumentsAndSettings::qtDir());
-        if (!pcDir.cd(QStringLiteral("lib")))
-            return QStringList();
-        if (!pcDir.cd(QStringLiteral("pkgconfig")))
-            return QStringList();
-
-        pcDir.setFilter(QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot | QDir::Readable);
-        pcDir.setNameFilters({QStringLiteral("Qt*.pc"), QStringLiteral("phonon.pc")});
-        if (ArgumentsAndSettings::qtQVersion().majorVersion() == 5)
-            pcDir.setNameFilters({QStringLiteral("Qt5*.pc"), QStringLiteral("Enginio.pc")});
+    if (!context.msvc) {
+        QStringList nameFilters;
+        if (context.majorVersion == 5)
+            nameFilters = QStringList {QStringLiteral("Qt5*.pc"), QStringLiteral("Enginio.pc")};
         else
-            pcDir.setNameFilters({QStringLiteral("Qt*.pc"), QStringLiteral("phonon.pc")});
+            nameFilters = QStringList {QStringLiteral("Qt*.pc"), QStringLiteral("phonon.pc")};
         QStringList r;
-        QStringList l = pcDir.entryList();
+        QStringList l = fileIndex().entryList(QStringLiteral("lib/pkgconfig"), nameFilters, FileIndex::Files | FileIndex::NoSymLinks);
         foreach (const QString &f, l) {
-            if ((ArgumentsAndSettings::qtQVersion().majorVersion() == 4) && f.startsWith(QStringLiteral("Qt5")))
+            QString fileName = f.mid(f.lastIndexOf(QLatin1Char('/')) + 1);
+            if ((context.majorVersion == 4) && fileName.startsWith(QStringLiteral("Qt5")))
                 continue;
 
-            if (shouldPatch(f))
-                r << (QStringLiteral("lib/pkgconfig/") + f);
+            if (shouldPatch(context, fileName))
+                r << f;
         }
         return r;
     }
@@ -62,200 +61,214 @@ QStringList PcPatcher::findFileToPatch() const
     return QStringList();
 }
 
-bool PcPatcher::patchFile(const QString &file) const
+namespace {
+
+enum PcValue
 {
-    QDir qtDir(ArgumentsAndSettings::qtDir());
-    QDir newDir(ArgumentsAndSettings::newDir());
+    // newDir with native separators, backslashes doubled
+    EscapedNativeNewDir,
+    // newDir with native separators
+    NativeNewDir,
+    // newDir + text with '/' separators
+    NewDirPath,
+    // text as is, usually relative to ${prefix}
+    Text,
+    Cflags,
+    LibsPrivate,
+};
 
-    QFile f(qtDir.absoluteFilePath(file));
-    if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QByteArray toWrite;
-        char arr[10000];
-        while (f.readLine(arr, 9999) > 0) {
-            QString str = QString::fromUtf8(arr);
-            str = str.trimmed();
-            if (ArgumentsAndSettings::qtQVersion().majorVersion() == 5) {
-                patchQt5(str, arr, newDir);
-            } else if (ArgumentsAndSettings::qtQVersion().majorVersion() == 4) {
-                // Why MinGW versions and Linux versions are different........
-                if (ArgumentsAndSettings::crossMkspec().startsWith(QStringLiteral("win32-")))
-                    patchQt4MinGW(str, arr, newDir, QFileInfo(f).baseName());
-                else
-                    patchQt4Unix(str, arr, newDir, QFileInfo(f).baseName());
-            }
-            toWrite.append(arr);
-        }
-        f.close();
+struct PcRule
+{
+    // including the '=' or ':' after it
+    const char *key;
+    PcValue value;
+    const char *text;
+    // Qt4 has an include dir per module
+    bool appendBaseName;
+};
 
-        f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-        f.write(toWrite);
-        f.close();
-    } else
-        return false;
+// clang-format off
+const PcRule qt5Rules[] = {
+    {"prefix=", EscapedNativeNewDir, "", false},
+    {"libdir=", Text, "${prefix}/lib", false},
+    {"includedir=", Text, "${prefix}/include", false},
+};
 
-    return true;
-}
+// Why MinGW versions and Linux versions are different........
+const PcRule qt4MinGWRules[] = {
+    {"prefix=", NativeNewDir, "", false},
+    {"libdir=", NewDirPath, "/lib", false},
+    {"includedir=", NewDirPath, "/include/", true},
+    {"moc_location=", NewDirPath, "/bin/moc", false},
+    {"uic_location=", NewDirPath, "/bin/uic", false},
+    {"rcc_location=", NewDirPath, "/bin/rcc", false},
+    {"lupdate_location=", NewDirPath, "/bin/lupdate", false},
+    {"lrelease_location=", NewDirPath, "/bin/lrelease", false},
+    {"Cflags:", Cflags, "", false},
+};
+
+const PcRule qt4UnixRules[] = {
+    {"prefix=", NewDirPath, "", false},
+    {"libdir=", Text, "${prefix}/lib", false},
+    {"includedir=", Text, "${prefix}/include/", true},
+    {"moc_location=", Text, "${prefix}/bin/moc", false},
+    {"uic_location=", Text, "${prefix}/bin/uic", false},
+    {"rcc_location=", Text, "${prefix}/bin/rcc", false},
+    {"lupdate_location=", Text, "${prefix}/bin/lupdate", false},
+    {"lrelease_location=", Text, "${prefix}/bin/lrelease", false},
+    {"Libs.private:", LibsPrivate, "", false},
+    {"Cflags:", Cflags, "", false},
+};
+// clang-format on
 
-bool PcPatcher::shouldPatch(const QString &file) const
+const RuleTable<PcRule> *pcRules(const PatchContext &context)
 {
-    QDir pcDir(ArgumentsAndSettings::qtDir());
-    if (!pcDir.cd(QStringLiteral("lib")))
-        return false;
-    if (!pcDir.cd(QStringLiteral("pkgconfig")))
-        return false;
+    static const RuleTable<PcRule> qt5(qt5Rules);
+    static const RuleTable<PcRule> qt4MinGW(qt4MinGWRules);
+    static const RuleTable<PcRule> qt4Unix(qt4UnixRules);
 
-    QDir oldDir(ArgumentsAndSettings::oldDir());
-
-    QFile f(pcDir.absoluteFilePath(file));
-    if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        char arr[10000];
-        while (f.readLine(arr, 9999) > 0) {
-            QString str = QString::fromUtf8(arr);
-            str = str.trimmed();
-            if (str.startsWith(QStringLiteral("prefix="))) {
-                str = str.mid(7).trimmed();
-                if (QDir(QString(str).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldDir) {
-                    f.close();
-                    return true;
-                }
-            }
-        }
-        f.close();
-    }
+    if (context.majorVersion == 5)
+        return &qt5;
+    else if (context.majorVersion == 4)
+        return context.win32 ? &qt4MinGW : &qt4Unix;
 
-    return false;
+    return nullptr;
 }
 
-void PcPatcher::patchQt5(const QString &_str, char *arr, const QDir &newDir) const
+// "prefix=..." or "Cflags: ...", the key includes the separator
+QByteArray pcKey(const QByteArray &line)
 {
-    QString str = _str;
-    if (str.startsWith(QStringLiteral("prefix="))) {
-        str = QStringLiteral("prefix=") + QDir::toNativeSeparators(newDir.absolutePath()).replace(QStringLiteral("\\"), QStringLiteral("\\\\")) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("libdir=")))
-        strcpy(arr, "libdir=${prefix}/lib\n");
-    else if (str.startsWith(QStringLiteral("includedir=")))
-        strcpy(arr, "includedir=${prefix}/include\n");
+    const char *data = line.constData();
+    for (int i = 0; i < line.size(); ++i) {
+        if (data[i] == '=' || data[i] == ':')
+            return QByteArray::fromRawData(data, i + 1);
+    }
+
+    return QByteArray();
 }
 
-void PcPatcher::patchQt4MinGW(const QString &_str, char *arr, const QDir &newDir, const QString &fBaseName) const
+QByteArray patchQt4Cflags(const PatchContext &context, const QByteArray &value)
 {
-    QString str = _str;
-    if (str.startsWith(QStringLiteral("prefix="))) {
-        str = QStringLiteral("prefix=") + QDir::toNativeSeparators(newDir.absolutePath()) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("libdir="))) {
-        str = QStringLiteral("libdir=") + QDir::fromNativeSeparators(newDir.absolutePath() + QStringLiteral("/lib")) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("includedir="))) {
-        str = QStringLiteral("includedir=") + QDir::fromNativeSeparators(newDir.absolutePath() + QStringLiteral("/include/") + fBaseName) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("moc_location="))) {
-        str = QStringLiteral("moc_location=") + QDir::fromNativeSeparators(newDir.absolutePath() + QStringLiteral("/bin/moc")) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("uic_location="))) {
-        str = QStringLiteral("uic_location=") + QDir::fromNativeSeparators(newDir.absolutePath() + QStringLiteral("/bin/uic")) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("rcc_location="))) {
-        str = QStringLiteral("rcc_location=") + QDir::fromNativeSeparators(newDir.absolutePath() + QStringLiteral("/bin/rcc")) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("lupdate_location="))) {
-        str = QStringLiteral("lupdate_location=") + QDir::fromNativeSeparators(newDir.absolutePath() + QStringLiteral("/bin/lupdate")) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("lrelease_location="))) {
-        str = QStringLiteral("lrelease_location=") + QDir::fromNativeSeparators(newDir.absolutePath() + QStringLiteral("/bin/lrelease")) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("Cflags:"))) {
-        str = str.mid(7);
-#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
-        QStringList l = str.split(QStringLiteral(" "), QString::SkipEmptyParts);
-#else
-        QStringList l = str.split(QStringLiteral(" "), Qt::SkipEmptyParts);
-#endif
-        QStringList r;
-        foreach (const QString &m, l) {
-            QString n = m;
-            if (n.startsWith(QStringLiteral("-I"))) {
-                QDir newIncludeDir(ArgumentsAndSettings::newDir() + QStringLiteral("/include"));
-                QDir oldIncludeDir(ArgumentsAndSettings::oldDir() + QStringLiteral("/include"));
-                if (QDir(n.mid(2)).isAbsolute() && QDir(n.mid(2)).absolutePath() == oldIncludeDir.absolutePath())
-                    n = QStringLiteral("-I") + QDir::fromNativeSeparators(newIncludeDir.absolutePath());
+    return TextLines::rewriteTokens(value, TextLines::tokenize(value), [&context](const TextLines::ValueToken &token, QByteArray *replacement) -> bool {
+        if (token.text.startsWith("-I")) {
+            QString includeDir = QString::fromUtf8(TextLines::mid(token.text, 2));
+            if (QDir::isAbsolutePath(includeDir) && context.isOldIncludeDir(includeDir)) {
+                *replacement = "-I" + context.newIncludeDirPath;
+                return true;
             }
-            r << n;
         }
-        str = QStringLiteral("Cflags: ") + r.join(QLatin1Char(' ')) + QStringLiteral(" \n");
-        strcpy(arr, str.toUtf8().constData());
-    }
+        return false;
+    });
 }
 
-void PcPatcher::patchQt4Unix(const QString &_str, char *arr, const QDir &newDir, const QString &fBaseName) const
+QByteArray patchQt4LibsPrivate(const PatchContext &context, const QByteArray &value)
 {
-    QString str = _str;
-    if (str.startsWith(QStringLiteral("prefix="))) {
-        str = QStringLiteral("prefix=") + QDir::fromNativeSeparators(newDir.absolutePath()) + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("libdir=")))
-        strcpy(arr, "libdir=${prefix}/lib\n");
-    else if (str.startsWith(QStringLiteral("includedir="))) {
-        str = QStringLiteral("includedir=${prefix}/include/") + fBaseName + QStringLiteral("\n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("moc_location=")))
-        strcpy(arr, "moc_location=${prefix}/bin/moc\n");
-    else if (str.startsWith(QStringLiteral("uic_location=")))
-        strcpy(arr, "uic_location=${prefix}/bin/uic\n");
-    else if (str.startsWith(QStringLiteral("rcc_location=")))
-        strcpy(arr, "rcc_location=${prefix}/bin/rcc\n");
-    else if (str.startsWith(QStringLiteral("lupdate_location=")))
-        strcpy(arr, "lupdate_location=${prefix}/bin/lupdate\n");
-    else if (str.startsWith(QStringLiteral("lrelease_location=")))
-        strcpy(arr, "lrelease_location=${prefix}/bin/lrelease\n");
-    else if (str.startsWith(QStringLiteral("Libs.private:"))) {
-        str = str.mid(13);
-#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
-        QStringList l = str.split(QStringLiteral(" "), QString::SkipEmptyParts);
-#else
-        QStringList l = str.split(QStringLiteral(" "), Qt::SkipEmptyParts);
-#endif
-        QStringList r;
-        foreach (const QString &m, l) {
-            QString n = m;
-            QDir newLibDir(ArgumentsAndSettings::newDir() + QStringLiteral("/lib"));
-            QDir oldLibDir(ArgumentsAndSettings::oldDir() + QStringLiteral("/lib"));
-            if (n.startsWith(QStringLiteral("-L"))) {
-                if (QDir(n.mid(2).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir)
-                    n = QStringLiteral("-L") + QDir::fromNativeSeparators(newLibDir.absolutePath());
-            } else if (!n.startsWith(QStringLiteral("-l"))) {
-                QFileInfo fi(QString(n).replace(QStringLiteral("\\\\"), QStringLiteral("\\")));
-                if (fi.isAbsolute() && QDir(fi.absolutePath()) == oldLibDir) {
-                    QFileInfo fiNew(newLibDir, fi.baseName());
-                    n = QDir::fromNativeSeparators(fiNew.absoluteFilePath());
-                }
+    return TextLines::rewriteTokens(value, TextLines::tokenize(value), [&context](const TextLines::ValueToken &token, QByteArray *replacement) -> bool {
+        if (token.text.startsWith("-L")) {
+            if (context.isOldLibDir(TextLines::tokenPath(token, 2))) {
+                *replacement = "-L" + context.newLibDirPath;
+                return true;
             }
-            r << n;
-        }
-        str = QStringLiteral("Libs.private: ") + r.join(QLatin1Char(' ')) + QStringLiteral(" \n");
-        strcpy(arr, str.toUtf8().constData());
-    } else if (str.startsWith(QStringLiteral("Cflags:"))) {
-        str = str.mid(7);
-#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
-        QStringList l = str.split(QStringLiteral(" "), QString::SkipEmptyParts);
-#else
-        QStringList l = str.split(QStringLiteral(" "), Qt::SkipEmptyParts);
-#endif
-        QStringList r;
-        foreach (const QString &m, l) {
-            QString n = m;
-            if (n.startsWith(QStringLiteral("-I"))) {
-                QDir newIncludeDir(ArgumentsAndSettings::newDir() + QStringLiteral("/include"));
-                QDir oldIncludeDir(ArgumentsAndSettings::oldDir() + QStringLiteral("/include"));
-                if (QDir(n.mid(2)).isAbsolute() && QDir(n.mid(2)).absolutePath() == oldIncludeDir.absolutePath())
-                    n = QStringLiteral("-I") + QDir::fromNativeSeparators(newIncludeDir.absolutePath());
+        } else if (!token.text.startsWith("-l")) {
+            QFileInfo fi(TextLines::tokenPath(token));
+            if (fi.isAbsolute() && context.isOldLibDir(fi.absolutePath())) {
+                *replacement = context.newLibDirPath + '/' + fi.baseName().toUtf8();
+                return true;
             }
-            r << n;
         }
-        str = QStringLiteral("Cflags: ") + r.join(QLatin1Char(' ')) + QStringLiteral(" \n");
-        strcpy(arr, str.toUtf8().constData());
+        return false;
+    });
+}
+
+// line is trimmed
+bool applyRule(const PatchContext &context, const PcRule &rule, const QByteArray &line, QByteArray *replacement, const QString &fBaseName)
+{
+    QByteArray key = QByteArray::fromRawData(rule.key, static_cast<int>(::strlen(rule.key)));
+    switch (rule.value) {
+    case EscapedNativeNewDir:
+        *replacement = key + context.newDirEscapedNativePath;
+        break;
+    case NativeNewDir:
+        *replacement = key + QDir::toNativeSeparators(context.newDir).toUtf8();
+        break;
+    case NewDirPath:
+        *replacement = key + context.newDirPath + rule.text;
+        break;
+    case Text:
+        *replacement = key + rule.text;
+        break;
+    case Cflags:
+        *replacement = key + patchQt4Cflags(context, TextLines::mid(line, key.length()));
+        return true;
+    case LibsPrivate:
+        *replacement = key + patchQt4LibsPrivate(context, TextLines::mid(line, key.length()));
+        return true;
     }
+
+    if (rule.appendBaseName)
+        replacement->append(fBaseName.toUtf8());
+    return true;
+}
+
+}
+
+QByteArray PatcherKernels::patchPc(const PatchContext &context, const QString &fileName, const QByteArray &content)
+{
+    const RuleTable<PcRule> *rules = pcRules(context);
+    if (rules == nullptr)
+        return content;
+
+    QString fBaseName = QFileInfo(fileName).baseName();
+    return TextLines::rewrite(content, [&](const QByteArray &line, QByteArray *replacement) -> bool {
+        QByteArray trimmedLine = TextLines::trimmed(line);
+        const PcRule *rule = rules->find(pcKey(trimmedLine));
+        if (rule == nullptr)
+            return false;
+
+        return applyRule(context, *rule, trimmedLine, replacement, fBaseName);
+    });
+}
+
+bool PcPatcher::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
+{
+    if (pcRules(context) == nullptr)
+        return false;
+
+    QDir qtDir(context.qtDir);
+
+    QFile f(qtDir.absoluteFilePath(file));
+    QByteArray content;
+    if (contentCache().take(f.fileName(), &content)) {
+        QByteArray toWrite = PatcherKernels::patchPc(context, f.fileName(), content);
+        if (!commitFile(backup, file, content, toWrite))
+            return false;
+    } else
+        return false;
+
+    return true;
+}
+
+bool PcPatcher::shouldPatch(const PatchContext &context, const QString &file) const
+{
+    TraceSpan span("shouldPatch", metaObject()->className(), file);
+
+    if (!fileIndex().isDir(QStringLiteral("lib/pkgconfig")))
+        return false;
+
+    QDir pcDir(context.qtDir + QStringLiteral("/lib/pkgconfig"));
+
+    QByteArray content;
+    if (!contentCache().read(pcDir.absoluteFilePath(file), &content))
+        return false;
+
+    return TextLines::find(content, [&](const QByteArray &line) -> bool {
+        QByteArray trimmedLine = TextLines::trimmed(line);
+        if (trimmedLine.startsWith("prefix=")) {
+            QString str = QString::fromUtf8(TextLines::trimmed(TextLines::mid(trimmedLine, 7)));
+            return context.isOldDir(str.replace(QStringLiteral("\\\\"), QStringLiteral("\\")));
+        }
+        return false;
+    });
 }
 
 REGISTER_PATCHER(PcPatcher)
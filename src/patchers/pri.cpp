@@ -1,9 +1,38 @@
 // SPDX-License-Identifier: Unlicense
 
-#include "argument.h"
+#include "commit.h"
+#include "contentcache.h"
+#include "fileindex.h"
 #include "log.h"
 #include "patch.h"
+#include "patchcontext.h"
+#include "ruletable.h"
+#include "textlines.h"
+#include "trace.h"
 #include <QDir>
+#include <QFile>
+
+namespace {
+
+struct PriRule
+{
+    const char *key;
+    // part of the name of the .pri file the key is patched in
+    const char *file;
+    // space separated new value
+    const char *libs;
+};
+
+// Returns the rule for key if it applies to file
+const PriRule *findRule(const RuleTable<PriRule> &rules, const QString &file, const QByteArray &key)
+{
+    const PriRule *rule = rules.find(key);
+    if (rule != nullptr && file.contains(QLatin1String(rule->file)))
+        return rule;
+    return nullptr;
+}
+
+}
 
 class PriPatcher : public Patcher
 {
@@ -13,20 +42,16 @@ public:
     PriPatcher(const QString &crossMkspecStartsWith, const QStringList &fileNames);
     ~PriPatcher() override;
 
-    QStringList findFileToPatch() const override;
-    void openSSLDirWarning(const QString &file) const;
+    QStringList findFileToPatch(const PatchContext &context) const override;
+    void openSSLDirWarning(const PatchContext &context, const QString &file) const;
 
-    virtual bool shouldPatch(const QString &file) const = 0;
+    virtual bool shouldPatch(const PatchContext &context, const QString &file) const = 0;
 
 protected:
     const QString crossMkspecStartsWith;
     const QStringList fileNames;
-
-    static bool opensslDirWarningDone;
 };
 
-bool PriPatcher::opensslDirWarningDone = false;
-
 PriPatcher::PriPatcher(const QString &crossMkspecStartsWith, const QStringList &fileNames)
     : crossMkspecStartsWith(crossMkspecStartsWith)
     , fileNames(fileNames)
@@ -37,20 +62,21 @@ PriPatcher::~PriPatcher()
 {
 }
 
-QStringList PriPatcher::findFileToPatch() const
+QStringList PriPatcher::findFileToPatch(const PatchContext &context) const
 {
-    if (ArgumentsAndSettings::qtQVersion().majorVersion() != 5)
+    if (context.majorVersion != 5)
         return QStringList();
 
     // Output a warning when a linked OpenSSL is found
     // may need patch manually when OpenSSL build dir moved
-    if (!opensslDirWarningDone && QDir(ArgumentsAndSettings::qtDir()).exists(QStringLiteral("mkspecs/modules/qt_lib_network_private.pri")))
-        openSSLDirWarning(QStringLiteral("mkspecs/modules/qt_lib_network_private.pri"));
+    // checked once per run, though all pri patchers get here
+    if (fileIndex().exists(QStringLiteral("mkspecs/modules/qt_lib_network_private.pri")) && isFirstWarning(QStringLiteral("linkedOpenSSL")))
+        openSSLDirWarning(context, QStringLiteral("mkspecs/modules/qt_lib_network_private.pri"));
 
-    if (ArgumentsAndSettings::crossMkspec().startsWith(crossMkspecStartsWith)) {
+    if (context.crossMkspec.startsWith(crossMkspecStartsWith)) {
         QStringList r;
         foreach (const QString &fileName, fileNames) {
-            if (QDir(ArgumentsAndSettings::qtDir()).exists(fileName) && shouldPatch(fileName))
+            if (fileIndex().exists(fileName) && shouldPatch(context, fileName))
                 r << fileName;
         }
 
@@ -62,29 +88,25 @@ QStringList PriPatcher::findFileToPatch() const
     // original QtBinPatcher patches all .pri files, but I don't know why
 }
 
-void PriPatcher::openSSLDirWarning(const QString &file) const
+void PriPatcher::openSSLDirWarning(const PatchContext &context, const QString &file) const
 {
     if (file.contains(QStringLiteral("qt_lib_network_private"))) {
-        QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-        if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            char arr[10000];
-            while (f.readLine(arr, 9999) > 0) {
-                QString l = QString::fromUtf8(arr);
-                int equalMark = l.indexOf(QLatin1Char('='));
-                if (equalMark != -1) {
-                    QString key = l.left(equalMark).trimmed();
-                    QString value = l.mid(equalMark + 1).trimmed();
-                    if (key == QStringLiteral("QMAKE_LIBS_OPENSSL") && !value.isEmpty()) {
-                        QBPLOGW(QString(QStringLiteral("Warning: Seems like you are using linked OpenSSL. "
-                                                       "Since we can\'t detect the path where you put OpenSSL in, "
-                                                       "you should probably manually modify %1 after you moved OpenSSL."))
-                                    .arg(f.fileName()));
-                        opensslDirWarningDone = true;
-                        return;
-                    }
-                }
-            }
+        // read without caching, no patcher may take it from the cache later
+        QFile f(QDir(context.qtDir).absoluteFilePath(file));
+        if (f.open(QIODevice::ReadOnly)) {
+            QByteArray content = f.readAll();
             f.close();
+            bool linked = TextLines::find(content, [](const QByteArray &line) -> bool {
+                QByteArray key;
+                QByteArray value;
+                return TextLines::splitAssignment(line, &key, &value) && key == "QMAKE_LIBS_OPENSSL" && !value.isEmpty();
+            });
+            if (linked) {
+                QBPLOGW(QString(QStringLiteral("Warning: Seems like you are using linked OpenSSL. "
+                                               "Since we can\'t detect the path where you put OpenSSL in, "
+                                               "you should probably manually modify %1 after you moved OpenSSL."))
+                            .arg(QDir(context.qtDir).absoluteFilePath(file)));
+            }
         }
     }
 }
@@ -97,8 +119,8 @@ public:
     Q_INVOKABLE PriPatcherAndroid();
     ~PriPatcherAndroid() override;
 
-    bool shouldPatch(const QString &file) const override;
-    bool patchFile(const QString &file) const override;
+    bool shouldPatch(const PatchContext &context, const QString &file) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
 };
 
 PriPatcherAndroid::PriPatcherAndroid()
@@ -110,25 +132,37 @@ PriPatcherAndroid::~PriPatcherAndroid()
 {
 }
 
-bool PriPatcherAndroid::shouldPatch(const QString &file) const
+namespace {
+
+// clang-format off
+const PriRule androidRules[] = {
+    {"QMAKE_LIBS_OPENGL_ES2", "qt_lib_gui_private", "-lGLESv2"},
+    {"QMAKE_LIBS_EGL", "qt_lib_gui_private", "-lEGL"},
+};
+// clang-format on
+
+const RuleTable<PriRule> &androidRuleTable()
+{
+    static const RuleTable<PriRule> table(androidRules);
+    return table;
+}
+
+}
+
+bool PriPatcherAndroid::shouldPatch(const PatchContext &context, const QString &file) const
 {
+    TraceSpan span("shouldPatch", metaObject()->className(), file);
+
     if (file.contains(QStringLiteral("qt_lib_gui_private"))) {
-        QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-        if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            char arr[10000];
-            while (f.readLine(arr, 9999) > 0) {
-                QString l = QString::fromUtf8(arr);
-                int equalMark = l.indexOf(QLatin1Char('='));
-                if (equalMark != -1) {
-                    QString key = l.left(equalMark).trimmed();
-                    QString value = l.mid(equalMark + 1).trimmed();
-                    if ((key == QStringLiteral("QMAKE_LIBS_OPENGL_ES2") || key == QStringLiteral("QMAKE_LIBS_EGL")) && !value.startsWith(QStringLiteral("-l"))) {
-                        f.close();
-                        return true;
-                    }
-                }
-            }
-            f.close();
+        QByteArray content;
+        if (contentCache().read(QDir(context.qtDir).absoluteFilePath(file), &content)) {
+            return TextLines::find(content, [&file](const QByteArray &line) -> bool {
+                QByteArray key;
+                QByteArray value;
+                if (!TextLines::splitAssignment(line, &key, &value))
+                    return false;
+                return findRule(androidRuleTable(), file, key) != nullptr && !value.startsWith("-l");
+            });
         }
     } else
         return false;
@@ -136,36 +170,28 @@ bool PriPatcherAndroid::shouldPatch(const QString &file) const
     return false;
 }
 
-bool PriPatcherAndroid::patchFile(const QString &file) const
+bool PriPatcherAndroid::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
 {
     if (file.contains(QStringLiteral("qt_lib_gui_private"))) {
-        QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-        if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QByteArray toWrite;
-            char arr[10000];
-            while (f.readLine(arr, 9999) > 0) {
-                QString l = QString::fromUtf8(arr);
-                int equalMark = l.indexOf(QLatin1Char('='));
-                if (equalMark != -1) {
-                    QString key = l.left(equalMark).trimmed();
-                    QString value = l.mid(equalMark + 1).trimmed();
-                    if (key == QStringLiteral("QMAKE_LIBS_OPENGL_ES2")) {
-                        value = QStringLiteral("-lGLESv2");
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    } else if (key == QStringLiteral("QMAKE_LIBS_EGL")) {
-                        value = QStringLiteral("-lEGL");
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    }
-                }
-                toWrite.append(arr);
-            }
-            f.close();
-
-            f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-            f.write(toWrite);
-            f.close();
+        QFile f(QDir(context.qtDir).absoluteFilePath(file));
+        QByteArray content;
+        if (contentCache().take(f.fileName(), &content)) {
+            QByteArray toWrite = TextLines::rewrite(content, [&file](const QByteArray &line, QByteArray *replacement) -> bool {
+                QByteArray key;
+                QByteArray value;
+                if (!TextLines::splitAssignment(line, &key, &value))
+                    return false;
+
+                const PriRule *rule = findRule(androidRuleTable(), file, key);
+                if (rule == nullptr)
+                    return false;
+
+                *replacement = key + " = " + rule->libs;
+                return true;
+            });
+
+            if (!commitFile(backup, file, content, toWrite))
+                return false;
         } else
             return false;
     } else
@@ -182,10 +208,10 @@ public:
     Q_INVOKABLE PriPatcherWin32();
     ~PriPatcherWin32() override;
 
-    bool shouldPatch(const QString &file) const override;
-    bool patchFile(const QString &file) const override;
+    bool shouldPatch(const PatchContext &context, const QString &file) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
 
-    QString addPrefixSuffix(const QString &libName) const;
+    QString addPrefixSuffix(const PatchContext &context, const QString &libName) const;
 };
 
 PriPatcherWin32::PriPatcherWin32()
@@ -199,212 +225,90 @@ PriPatcherWin32::~PriPatcherWin32()
 {
 }
 
-bool PriPatcherWin32::shouldPatch(const QString &file) const
+namespace {
+
+// clang-format off
+const PriRule win32Rules[] = {
+    {"QMAKE_LIBS_NETWORK", "qt_lib_network_private", "ws2_32"},
+
+    {"QMAKE_LIBS_DXGUID", "qt_lib_gui_private", "dxguid"},
+    {"QMAKE_LIBS_D3D9", "qt_lib_gui_private", "d3d9"},
+    {"QMAKE_LIBS_DXGI", "qt_lib_gui_private", "dxgi"},
+    {"QMAKE_LIBS_DXGI1_2", "qt_lib_gui_private", "dxgi"},
+    {"QMAKE_LIBS_D3D11", "qt_lib_gui_private", "d3d11"},
+    {"QMAKE_LIBS_D3D11_1", "qt_lib_gui_private", "d3d11"},
+    {"QMAKE_LIBS_D2D1", "qt_lib_gui_private", "d2d1"},
+    {"QMAKE_LIBS_D2D1_1", "qt_lib_gui_private", "d2d1"},
+    {"QMAKE_LIBS_DWRITE", "qt_lib_gui_private", "dwrite"},
+    {"QMAKE_LIBS_DWRITE_1", "qt_lib_gui_private", "dwrite"},
+    {"QMAKE_LIBS_DWRITE_2", "qt_lib_gui_private", "dwrite"},
+
+    {"QMAKE_LIBS_DIRECTSHOW", "qt_lib_multimedia_private", "strmiids dmoguids uuid msdmo ole32 oleaut32"},
+    {"QMAKE_LIBS_WMF", "qt_lib_multimedia_private", "strmiids dmoguids uuid msdmo ole32 oleaut32 Mf Mfuuid Mfplat Propsys"},
+};
+// clang-format on
+
+const RuleTable<PriRule> &win32RuleTable()
+{
+    static const RuleTable<PriRule> table(win32Rules);
+    return table;
+}
+
+}
+
+bool PriPatcherWin32::shouldPatch(const PatchContext &context, const QString &file) const
 {
+    TraceSpan span("shouldPatch", metaObject()->className(), file);
+
     // Seems Qt 5.12 needs to do such patch
     // Qt 5.9 does not have these stuff
     // I have not built Qt 5.10/5.11, so I can't confirm
     // All of my builds of Qt 5.13 have been removed, I can't confirm either
     // Qt 5.14 has this problem fixed(Since QQtPatcher won't support Qt 5.14, I will not test)
-    if (ArgumentsAndSettings::qtQVersion().minorVersion() >= 10 && ArgumentsAndSettings::qtQVersion().minorVersion() <= 13) {
-        if (file.contains(QStringLiteral("qt_lib_network_private"))) {
-            QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-            if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                char arr[10000];
-                while (f.readLine(arr, 9999) > 0) {
-                    QString l = QString::fromUtf8(arr);
-                    int equalMark = l.indexOf(QLatin1Char('='));
-                    if (equalMark != -1) {
-                        QString key = l.left(equalMark).trimmed();
-                        if (key == QStringLiteral("QMAKE_LIBS_NETWORK")) {
-                            f.close();
-                            return true;
-                        }
-                    }
-                }
-                f.close();
-            }
-        } else if (file.contains(QStringLiteral("qt_lib_gui_private"))) {
-            QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-            if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                char arr[10000];
-                while (f.readLine(arr, 9999) > 0) {
-                    QString l = QString::fromUtf8(arr);
-                    int equalMark = l.indexOf(QLatin1Char('='));
-                    if (equalMark != -1) {
-                        QString key = l.left(equalMark).trimmed();
-                        if ((key == QStringLiteral("QMAKE_LIBS_DXGUID")) || (key == QStringLiteral("QMAKE_LIBS_D3D9")) || (key == QStringLiteral("QMAKE_LIBS_DXGI"))
-                            || (key == QStringLiteral("QMAKE_LIBS_D3D11")) || (key == QStringLiteral("QMAKE_LIBS_D2D1")) || (key == QStringLiteral("QMAKE_LIBS_D2D1_1"))
-                            || (key == QStringLiteral("QMAKE_LIBS_DXGI1_2")) || (key == QStringLiteral("QMAKE_LIBS_D3D11_1")) || (key == QStringLiteral("QMAKE_LIBS_DWRITE"))
-                            || (key == QStringLiteral("QMAKE_LIBS_DWRITE_1")) || (key == QStringLiteral("QMAKE_LIBS_DWRITE_2"))) {
-                            f.close();
-                            return true;
-                        }
-                    }
-                }
-                f.close();
-            }
-        } else if (file.contains(QStringLiteral("qt_lib_multimedia_private"))) {
-            QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-            if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                char arr[10000];
-                while (f.readLine(arr, 9999) > 0) {
-                    QString l = QString::fromUtf8(arr);
-                    int equalMark = l.indexOf(QLatin1Char('='));
-                    if (equalMark != -1) {
-                        QString key = l.left(equalMark).trimmed();
-                        if ((key == QStringLiteral("QMAKE_LIBS_WMF")) || (key == QStringLiteral("QMAKE_LIBS_DIRECTSHOW"))) {
-                            f.close();
-                            return true;
-                        }
-                    }
-                }
-                f.close();
-            }
-        } else
-            return false;
+    if (context.minorVersion >= 10 && context.minorVersion <= 13) {
+        QByteArray content;
+        if (contentCache().read(QDir(context.qtDir).absoluteFilePath(file), &content)) {
+            return TextLines::find(content, [&file](const QByteArray &line) -> bool {
+                QByteArray key;
+                QByteArray value;
+                return TextLines::splitAssignment(line, &key, &value) && findRule(win32RuleTable(), file, key) != nullptr;
+            });
+        }
     }
     return false;
 }
 
-bool PriPatcherWin32::patchFile(const QString &file) const
+bool PriPatcherWin32::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
 {
-    if (file.contains(QStringLiteral("qt_lib_network_private"))) {
-        QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-        if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QByteArray toWrite;
-            char arr[10000];
-            while (f.readLine(arr, 9999) > 0) {
-                QString l = QString::fromUtf8(arr);
-                int equalMark = l.indexOf(QLatin1Char('='));
-                if (equalMark != -1) {
-                    QString key = l.left(equalMark).trimmed();
-                    QString value = l.mid(equalMark + 1).trimmed();
-                    if (key == QStringLiteral("QMAKE_LIBS_NETWORK")) {
-                        value = addPrefixSuffix(QStringLiteral("ws2_32"));
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    }
-                }
-                toWrite.append(arr);
-            }
-            f.close();
+    QFile f(QDir(context.qtDir).absoluteFilePath(file));
+    QByteArray content;
+    if (!contentCache().take(f.fileName(), &content))
+        return false;
 
-            f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-            f.write(toWrite);
-            f.close();
-        } else
+    QByteArray toWrite = TextLines::rewrite(content, [this, &context, &file](const QByteArray &line, QByteArray *replacement) -> bool {
+        QByteArray key;
+        QByteArray value;
+        if (!TextLines::splitAssignment(line, &key, &value))
             return false;
-    } else if (file.contains(QStringLiteral("qt_lib_gui_private"))) {
-        QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-        if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QByteArray toWrite;
-            char arr[10000];
-            while (f.readLine(arr, 9999) > 0) {
-                QString l = QString::fromUtf8(arr);
-                int equalMark = l.indexOf(QLatin1Char('='));
-                if (equalMark != -1) {
-                    QString key = l.left(equalMark).trimmed();
-                    QString value = l.mid(equalMark + 1).trimmed();
-                    if (key == QStringLiteral("QMAKE_LIBS_DXGUID")) {
-                        value = addPrefixSuffix(QStringLiteral("dxguid"));
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    } else if (key == QStringLiteral("QMAKE_LIBS_D3D9")) {
-                        value = addPrefixSuffix(QStringLiteral("d3d9"));
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    } else if ((key == QStringLiteral("QMAKE_LIBS_DXGI")) || (key == QStringLiteral("QMAKE_LIBS_DXGI1_2"))) {
-                        value = addPrefixSuffix(QStringLiteral("dxgi"));
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    } else if ((key == QStringLiteral("QMAKE_LIBS_D3D11")) || (key == QStringLiteral("QMAKE_LIBS_D3D11_1"))) {
-                        value = addPrefixSuffix(QStringLiteral("d3d11"));
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    } else if ((key == QStringLiteral("QMAKE_LIBS_D2D1")) || (key == QStringLiteral("QMAKE_LIBS_D2D1_1"))) {
-                        value = addPrefixSuffix(QStringLiteral("d2d1"));
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    } else if ((key == QStringLiteral("QMAKE_LIBS_DWRITE")) || (key == QStringLiteral("QMAKE_LIBS_DWRITE_1")) || (key == QStringLiteral("QMAKE_LIBS_DWRITE_2"))) {
-                        value = addPrefixSuffix(QStringLiteral("dwrite"));
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    }
-                }
-                toWrite.append(arr);
-            }
-            f.close();
 
-            f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-            f.write(toWrite);
-            f.close();
-        } else
+        const PriRule *rule = findRule(win32RuleTable(), file, key);
+        if (rule == nullptr)
             return false;
-    } else if (file.contains(QStringLiteral("qt_lib_multimedia_private"))) {
-        QFile f(QDir(ArgumentsAndSettings::qtDir()).absoluteFilePath(file));
-        if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QByteArray toWrite;
-            char arr[10000];
-            while (f.readLine(arr, 9999) > 0) {
-                QString l = QString::fromUtf8(arr);
-                int equalMark = l.indexOf(QLatin1Char('='));
-                if (equalMark != -1) {
-                    QString key = l.left(equalMark).trimmed();
-                    QString value = l.mid(equalMark + 1).trimmed();
-                    if (key == QStringLiteral("QMAKE_LIBS_DIRECTSHOW")) {
-                        // clang-format off
-                        QStringList values {
-                            addPrefixSuffix(QStringLiteral("strmiids")),
-                            addPrefixSuffix(QStringLiteral("dmoguids")),
-                            addPrefixSuffix(QStringLiteral("uuid")),
-                            addPrefixSuffix(QStringLiteral("msdmo")),
-                            addPrefixSuffix(QStringLiteral("ole32")),
-                            addPrefixSuffix(QStringLiteral("oleaut32")),
-                        };
-                        // clang-format on
-                        value = values.join(QStringLiteral(" "));
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    } else if (key == QStringLiteral("QMAKE_LIBS_WMF")) {
-                        // clang-format off
-                        QStringList values {
-                            addPrefixSuffix(QStringLiteral("strmiids")),
-                            addPrefixSuffix(QStringLiteral("dmoguids")),
-                            addPrefixSuffix(QStringLiteral("uuid")),
-                            addPrefixSuffix(QStringLiteral("msdmo")),
-                            addPrefixSuffix(QStringLiteral("ole32")),
-                            addPrefixSuffix(QStringLiteral("oleaut32")),
-                            addPrefixSuffix(QStringLiteral("Mf")),
-                            addPrefixSuffix(QStringLiteral("Mfuuid")),
-                            addPrefixSuffix(QStringLiteral("Mfplat")),
-                            addPrefixSuffix(QStringLiteral("Propsys")),
-                        };
-                        // clang-format on
-                        value = values.join(QStringLiteral(" "));
-                        l = key + QStringLiteral(" = ") + value + QStringLiteral("\n");
-                        strcpy(arr, l.toUtf8().constData());
-                    }
-                }
-                toWrite.append(arr);
-            }
-            f.close();
 
-            f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-            f.write(toWrite);
-            f.close();
-        } else
-            return false;
-    } else
-        return false;
+        QStringList values;
+        foreach (const QByteArray &lib, QByteArray(rule->libs).split(' '))
+            values << addPrefixSuffix(context, QString::fromUtf8(lib));
+        *replacement = key + " = " + values.join(QStringLiteral(" ")).toUtf8();
+        return true;
+    });
 
-    return true;
+    return commitFile(backup, file, content, toWrite);
 }
 
-QString PriPatcherWin32::addPrefixSuffix(const QString &libName) const
+QString PriPatcherWin32::addPrefixSuffix(const PatchContext &context, const QString &libName) const
 {
     // win32-msvc and win32-g++ use different grammar. MSVC does not use -l
-    if (ArgumentsAndSettings::crossMkspec().contains(QStringLiteral("msvc")))
+    if (context.msvc)
         return libName + QStringLiteral(".lib");
     else
         return QStringLiteral("-l") + libName;
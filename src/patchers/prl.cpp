@@ -1,11 +1,18 @@
 // SPDX-License-Identifier: Unlicense
 
-#include "argument.h"
+#include "commit.h"
+#include "contentcache.h"
+#include "fileindex.h"
+#include "kernels.h"
 #include "log.h"
 #include "patch.h"
+#include "patchcontext.h"
+#include "patternmatcher.h"
+#include "textlines.h"
+#include "trace.h"
 
+#include <QAtomicInt>
 #include <QDir>
-#include <QRegularExpression>
 
 class PrlPatcher : public Patcher
 {
@@ -15,18 +22,15 @@ public:
     Q_INVOKABLE PrlPatcher();
     ~PrlPatcher() override;
 
-    QStringList findFileToPatchInternal(const QDir &dir, bool recursive = true) const;
-    QStringList findFileToPatch() const override;
-    bool patchFile(const QString &file) const override;
+    QStringList findFileToPatchInternal(const PatchContext &context, const QString &dir, bool recursive = true) const;
+    QStringList findFileToPatch(const PatchContext &context) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
 
-    QString patchQmakePrlLibs(const QDir &oldLibDir, const QDir &newLibDir, const QString &value) const;
-
-    bool shouldPatch(const QString &file) const;
-
-    QString win32AddPrefixSuffix(const QString &libName) const;
+    bool shouldPatch(const PatchContext &context, const QString &file) const;
 
 private:
-    mutable bool qt4NoBuildDirWarn;
+    // shouldPatch() is called for every .prl file, warn only once
+    mutable QAtomicInt qt4NoBuildDirWarn;
 };
 
 PrlPatcher::PrlPatcher()
@@ -38,442 +42,300 @@ PrlPatcher::~PrlPatcher()
 {
 }
 
-QStringList PrlPatcher::findFileToPatchInternal(const QDir &dir, bool recursive) const
+QStringList PrlPatcher::findFileToPatchInternal(const PatchContext &context, const QString &dir, bool recursive) const
 {
-    QDir qtDir(ArgumentsAndSettings::qtDir());
-    QDir libDir(dir);
+    QDir qtDir(context.qtDir);
 
-    libDir.setFilter(QDir::Files | QDir::NoSymLinks | QDir::NoDotAndDotDot | QDir::Readable);
-    libDir.setNameFilters({QStringLiteral("*.prl")});
     QStringList r;
-    QStringList l = libDir.entryList();
+    QStringList l = fileIndex().entryList(dir, {QStringLiteral("*.prl")}, FileIndex::Files | FileIndex::NoSymLinks, recursive);
     foreach (const QString &f, l) {
-        if (shouldPatch(dir.absoluteFilePath(f)))
-            r << qtDir.relativeFilePath(dir.absolutePath()) + QStringLiteral("/") + f;
-    }
-
-    if (recursive) {
-        libDir.setFilter(QDir::Dirs | QDir::AllDirs | QDir::NoSymLinks | QDir::NoDotAndDotDot /* | QDir::Executable */);
-        libDir.setNameFilters({});
-        QStringList l = libDir.entryList();
-        foreach (const QString &f, l) {
-            QDir subdir(libDir);
-            subdir.cd(f);
-            r.append(findFileToPatchInternal(subdir, true));
-        }
+        if (shouldPatch(context, qtDir.absoluteFilePath(f)))
+            r << f;
     }
 
     return r;
 }
 
-QStringList PrlPatcher::findFileToPatch() const
+QStringList PrlPatcher::findFileToPatch(const PatchContext &context) const
 {
     // patch **.prl
 
     QStringList ret;
+    ret.append(findFileToPatchInternal(context, QStringLiteral("lib"), false));
+    ret.append(findFileToPatchInternal(context, QStringLiteral("qml"), true));
+    ret.append(findFileToPatchInternal(context, QStringLiteral("plugins"), true));
 
-    QDir libDir(ArgumentsAndSettings::qtDir());
-    if (libDir.cd(QStringLiteral("lib")))
-        ret.append(findFileToPatchInternal(libDir, false));
-
-    QDir qmlDir(ArgumentsAndSettings::qtDir());
-    if (qmlDir.cd(QStringLiteral("qml")))
-        ret.append(findFileToPatchInternal(qmlDir, true));
+    return ret;
+}
 
-    QDir pluginDir(ArgumentsAndSettings::qtDir());
-    if (pluginDir.cd(QStringLiteral("plugins")))
-        ret.append(findFileToPatchInternal(pluginDir, true));
+namespace {
+
+// clang-format off
+const char *const win32KnownLibs[] = {
+    // libs
+    "d2d1",
+    "d3d9",
+    "dwrite",
+    "dxguid",
+    "advapi32",
+    "comdlg32",
+    "crypt32",
+    "dnsapi",
+    "dwmapi",
+    "gdi32",
+    "iphlpapi",
+    "kernel32",
+    "mpr",
+    "netapi32",
+    "ole32",
+    "oleaut32",
+    "setupapi",
+    "shell32",
+    "shlwapi",
+    "user32",
+    "userenv",
+    "uuid",
+    "uxtheme",
+    "version",
+    "winmm",
+    "winspool",
+    "ws2_32",
+
+    // plugins
+    "odbc32",
+    "strmiids",
+    "mf",
+    "mfplat",
+    "dxva2",
+    "evr",
+    "dmoguids",
+    "msdmo",
+    "propsys",
+    "imm32",
+    "wtsapi32",
+    "d3d11",
+    "dxgi",
+    "d3d12",
+    "d3dcompiler",
+    "dcomp",
+};
+// clang-format on
 
-    return ret;
+// Returns the entry of win32KnownLibs contained in baseName, or nullptr. If there are several, the last one in the list is returned.
+const char *findWin32KnownLib(const QString &baseName)
+{
+    static const PatternMatcher matcher([]() -> QList<QByteArray> {
+        QList<QByteArray> patterns;
+        for (size_t i = 0; i < sizeof(win32KnownLibs) / sizeof(win32KnownLibs[0]); ++i)
+            patterns << QByteArray(win32KnownLibs[i]);
+        return patterns;
+    }());
+
+    QByteArray name = baseName.toLower().toUtf8();
+    int found = -1;
+    foreach (const PatternMatcher::Match &m, matcher.findAll(name.constData(), name.size()))
+        found = qMax(found, m.pattern);
+
+    return found == -1 ? nullptr : win32KnownLibs[found];
 }
 
-QString PrlPatcher::patchQmakePrlLibs(const QDir &oldLibDir, const QDir &newLibDir, const QString &value) const
+QString win32AddPrefixSuffix(const PatchContext &context, const QString &libName)
 {
-    QStringList r;
-#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
-    QStringList _splitted = value.split(QStringLiteral(" "), QString::KeepEmptyParts);
-#else
-    QStringList _splitted = value.split(QStringLiteral(" "), Qt::KeepEmptyParts);
-#endif
-
-    QStringList splitted;
-    QString temp;
-    bool flag = false;
-    foreach (const QString &_split, _splitted) {
-        if (!flag) {
-            if (!_split.startsWith(QLatin1Char('"')))
-                splitted << _split;
-            else {
-                flag = true;
-                temp = _split.mid(1);
-            }
-        } else {
-            temp.append(QLatin1Char(' ')).append(_split);
-            if (_split.endsWith(QLatin1Char('"'))) {
-                flag = false;
-                splitted << temp.left(temp.length() - 1);
-                temp = QString();
-            }
-        }
-    }
+    // win32-msvc and win32-g++ use different grammar. MSVC does not use -l
+    if (context.msvc)
+        return libName + QStringLiteral(".lib");
+    else
+        return QStringLiteral("-l") + libName;
+}
 
-    static QDir buildLibDir(ArgumentsAndSettings::buildDir() + QStringLiteral("/lib"));
+QByteArray patchQmakePrlLibs(const PatchContext &context, const QByteArray &value)
+{
+    const QString newLibDirPath = QString::fromUtf8(context.newLibDirPath);
 
-    foreach (const QString &m, splitted) {
+    return TextLines::rewriteTokens(value, TextLines::tokenize(value), [&](const TextLines::ValueToken &token, QByteArray *replacement) -> bool {
+        const QString m = QString::fromUtf8(token.text);
         QString n = m;
         if (n.startsWith(QStringLiteral("-L="))) {
-            if (QDir(n.mid(3).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir)
-                n = QStringLiteral("-L=") + QDir::fromNativeSeparators(newLibDir.absolutePath());
+            if (context.isOldLibDir(TextLines::tokenPath(token, 3)))
+                n = QStringLiteral("-L=") + newLibDirPath;
             else {
-                if (!ArgumentsAndSettings::buildDir().isEmpty() && ArgumentsAndSettings::qtQVersion().majorVersion() == 4) {
-                    if (QDir(n.mid(3).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == buildLibDir)
-                        n = QStringLiteral("-L=") + QDir::fromNativeSeparators(newLibDir.absolutePath());
-                }
+                if (context.majorVersion == 4 && context.isBuildLibDir(TextLines::tokenPath(token, 3)))
+                    n = QStringLiteral("-L=") + newLibDirPath;
             }
         } else if (n.startsWith(QStringLiteral("-L"))) {
-            if (QDir(n.mid(2).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir)
-                n = QStringLiteral("-L") + QDir::fromNativeSeparators(newLibDir.absolutePath());
+            if (context.isOldLibDir(TextLines::tokenPath(token, 2)))
+                n = QStringLiteral("-L") + newLibDirPath;
             else {
-                if (!ArgumentsAndSettings::buildDir().isEmpty() && ArgumentsAndSettings::qtQVersion().majorVersion() == 4) {
-                    if (QDir(n.mid(2).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == buildLibDir)
-                        n = QStringLiteral("-L") + QDir::fromNativeSeparators(newLibDir.absolutePath());
-                }
+                if (context.majorVersion == 4 && context.isBuildLibDir(TextLines::tokenPath(token, 2)))
+                    n = QStringLiteral("-L") + newLibDirPath;
             }
         } else if (!n.startsWith(QStringLiteral("-l"))) {
-            QFileInfo fi(QString(n).replace(QStringLiteral("\\\\"), QStringLiteral("\\")));
+            QFileInfo fi(TextLines::tokenPath(token));
 
             if (fi.isAbsolute()) {
-                if (QDir(fi.absolutePath()) == oldLibDir) {
-                    QFileInfo fiNew(newLibDir, fi.fileName());
-                    if (ArgumentsAndSettings::qtQVersion().majorVersion() == 5)
-                        n = QDir::fromNativeSeparators(fiNew.absoluteFilePath());
+                if (context.isOldLibDir(fi.absolutePath())) {
+                    if (context.majorVersion == 5)
+                        n = newLibDirPath + QStringLiteral("/") + fi.fileName();
                     else
-                        n = QDir::toNativeSeparators(fiNew.absoluteFilePath()).replace(QStringLiteral("\\"), QStringLiteral("\\\\"));
+                        n = QDir::toNativeSeparators(newLibDirPath + QStringLiteral("/") + fi.fileName()).replace(QStringLiteral("\\"), QStringLiteral("\\\\"));
                 } else {
-                    if ((ArgumentsAndSettings::qtQVersion().majorVersion() == 5 && ArgumentsAndSettings::qtQVersion().minorVersion() >= 10
-                         && ArgumentsAndSettings::qtQVersion().minorVersion() <= 13)
-                        && ArgumentsAndSettings::crossMkspec().startsWith(QStringLiteral("win32-"))) {
-                        // clang-format off
-                        static QStringList knownLists {
-                            // libs
-                            QStringLiteral("d2d1"),
-                            QStringLiteral("d3d9"),
-                            QStringLiteral("dwrite"),
-                            QStringLiteral("dxguid"),
-                            QStringLiteral("advapi32"),
-                            QStringLiteral("comdlg32"),
-                            QStringLiteral("crypt32"),
-                            QStringLiteral("dnsapi"),
-                            QStringLiteral("dwmapi"),
-                            QStringLiteral("gdi32"),
-                            QStringLiteral("iphlpapi"),
-                            QStringLiteral("kernel32"),
-                            QStringLiteral("mpr"),
-                            QStringLiteral("netapi32"),
-                            QStringLiteral("ole32"),
-                            QStringLiteral("oleaut32"),
-                            QStringLiteral("setupapi"),
-                            QStringLiteral("shell32"),
-                            QStringLiteral("shlwapi"),
-                            QStringLiteral("user32"),
-                            QStringLiteral("userenv"),
-                            QStringLiteral("uuid"),
-                            QStringLiteral("uxtheme"),
-                            QStringLiteral("version"),
-                            QStringLiteral("winmm"),
-                            QStringLiteral("winspool"),
-                            QStringLiteral("ws2_32"),
-
-                            // plugins
-                            QStringLiteral("odbc32"),
-                            QStringLiteral("strmiids"),
-                            QStringLiteral("mf"),
-                            QStringLiteral("mfplat"),
-                            QStringLiteral("dxva2"),
-                            QStringLiteral("evr"),
-                            QStringLiteral("dmoguids"),
-                            QStringLiteral("msdmo"),
-                            QStringLiteral("propsys"),
-                            QStringLiteral("imm32"),
-                            QStringLiteral("wtsapi32"),
-                            QStringLiteral("d3d11"),
-                            QStringLiteral("dxgi"),
-                            QStringLiteral("d3d12"),
-                            QStringLiteral("d3dcompiler"),
-                            QStringLiteral("dcomp"),
-                        };
-                        // clang-format on
-
-                        QString baseName = QFileInfo(QString(n).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))).baseName().toLower();
-                        foreach (const QString &known, knownLists) {
-                            if (baseName.contains(known))
-                                n = win32AddPrefixSuffix(known);
-                        }
+                    if ((context.majorVersion == 5 && context.minorVersion >= 10 && context.minorVersion <= 13) && context.win32) {
+                        const char *known = findWin32KnownLib(fi.baseName());
+                        if (known != nullptr)
+                            n = win32AddPrefixSuffix(context, QString::fromUtf8(known));
                     }
                 }
             } else {
-                if (!ArgumentsAndSettings::buildDir().isEmpty() && ArgumentsAndSettings::qtQVersion().majorVersion() == 4) {
-                    if (fi.isAbsolute() && QDir(fi.absolutePath()) == buildLibDir) {
-                        QFileInfo fiNew(newLibDir, fi.fileName());
-                        n = QDir::toNativeSeparators(fiNew.absoluteFilePath()).replace(QStringLiteral("\\"), QStringLiteral("\\\\"));
-                    }
+                if (context.majorVersion == 4) {
+                    if (fi.isAbsolute() && context.isBuildLibDir(fi.absolutePath()))
+                        n = QDir::toNativeSeparators(newLibDirPath + QStringLiteral("/") + fi.fileName()).replace(QStringLiteral("\\"), QStringLiteral("\\\\"));
                 }
             }
         }
-        if (n.contains(QRegularExpression(QStringLiteral("\\s"))))
-            n = QStringLiteral("\"") + n + QStringLiteral("\"");
+        if (n == m)
+            return false;
 
-        r << n;
-    }
-    return r.join(QStringLiteral(" "));
+        *replacement = TextLines::quoted(n.toUtf8());
+        return true;
+    });
 }
 
-bool PrlPatcher::patchFile(const QString &file) const
-{
-    QDir qtDir(ArgumentsAndSettings::qtDir());
+}
 
-    QDir oldLibDir(ArgumentsAndSettings::oldDir() + QStringLiteral("/lib"));
-    QDir newLibDir(ArgumentsAndSettings::newDir() + QStringLiteral("/lib"));
-    QDir newDir(ArgumentsAndSettings::newDir());
-    QDir oldDir(ArgumentsAndSettings::oldDir());
-    QDir buildDir(ArgumentsAndSettings::buildDir());
+QByteArray PatcherKernels::patchPrl(const PatchContext &context, const QByteArray &content)
+{
+    QDir newDir(context.newDir);
+    QDir oldDir(context.oldDir);
+    QDir buildDir(context.buildDir);
 
     // It is assumed that no spaces is in the olddir prefix
-    QFile f(qtDir.absoluteFilePath(file));
-    if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QByteArray toWrite;
-        char arr[10000];
-        while (f.readLine(arr, 9999) > 0) {
-            QString l = QString::fromUtf8(arr);
-            int equalMark = l.indexOf(QLatin1Char('='));
-            if (equalMark != -1) {
-                QString key = l.left(equalMark).trimmed();
-                QString value = l.mid(equalMark + 1).trimmed();
-                if (key == QStringLiteral("QMAKE_PRL_LIBS")) {
-                    value = patchQmakePrlLibs(oldLibDir, newLibDir, value);
-                    l = QStringLiteral("QMAKE_PRL_LIBS = ") + value + QStringLiteral("\n");
-                    strcpy(arr, l.toUtf8().constData());
-                } else if (key == QStringLiteral("QMAKE_PRL_BUILD_DIR")) {
-                    if (ArgumentsAndSettings::qtQVersion().majorVersion() == 4) {
-                        QString rp = oldDir.relativeFilePath(value);
-                        if (rp.contains(QStringLiteral(".."))) {
-                            if (!ArgumentsAndSettings::buildDir().isEmpty())
-                                rp = buildDir.relativeFilePath(value);
-                        }
+    return TextLines::rewrite(content, [&](const QByteArray &line, QByteArray *replacement) -> bool {
+        QByteArray key;
+        QByteArray value;
+        if (!TextLines::splitAssignment(line, &key, &value))
+            return false;
+
+        if (key == "QMAKE_PRL_LIBS") {
+            *replacement = "QMAKE_PRL_LIBS = " + patchQmakePrlLibs(context, value);
+            return true;
+        } else if (key == "QMAKE_PRL_BUILD_DIR") {
+            if (context.majorVersion == 4) {
+                QString v = QString::fromUtf8(value);
+                QString rp = oldDir.relativeFilePath(v);
+                if (rp.contains(QStringLiteral(".."))) {
+                    if (!context.buildDir.isEmpty())
+                        rp = buildDir.relativeFilePath(v);
+                }
 
-                        if (!rp.contains(QStringLiteral(".."))) {
-                            value = QDir::fromNativeSeparators(QDir::cleanPath(newDir.absolutePath() + QStringLiteral("/") + rp));
-                            l = QStringLiteral("QMAKE_PRL_BUILD_DIR = ") + value + QStringLiteral("\n");
-                            strcpy(arr, l.toUtf8().constData());
-                        }
-                    }
+                if (!rp.contains(QStringLiteral(".."))) {
+                    *replacement = "QMAKE_PRL_BUILD_DIR = " + QDir::fromNativeSeparators(QDir::cleanPath(newDir.absolutePath() + QStringLiteral("/") + rp)).toUtf8();
+                    return true;
                 }
             }
-
-            toWrite.append(arr);
         }
-        f.close();
 
-        f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-        f.write(toWrite);
-        f.close();
+        return false;
+    });
+}
+
+bool PrlPatcher::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
+{
+    QDir qtDir(context.qtDir);
+
+    QFile f(qtDir.absoluteFilePath(file));
+    QByteArray content;
+    if (contentCache().take(f.fileName(), &content)) {
+        QByteArray toWrite = PatcherKernels::patchPrl(context, content);
+        if (!commitFile(backup, file, content, toWrite))
+            return false;
     } else
         return false;
 
     return true;
 }
 
-bool PrlPatcher::shouldPatch(const QString &file) const
+bool PrlPatcher::shouldPatch(const PatchContext &context, const QString &file) const
 {
-    QDir libDir(ArgumentsAndSettings::qtDir());
-    if (!libDir.cd(QStringLiteral("lib")))
+    TraceSpan span("shouldPatch", metaObject()->className(), file);
+
+    if (!fileIndex().isDir(QStringLiteral("lib")))
         return false;
 
-    QDir oldLibDir(ArgumentsAndSettings::oldDir() + QStringLiteral("/lib"));
-    QDir oldDir(ArgumentsAndSettings::oldDir());
-    QDir buildLibDir;
-    QDir buildDir;
-    if (!ArgumentsAndSettings::buildDir().isEmpty()) {
-        buildDir = QDir(ArgumentsAndSettings::buildDir());
-        buildLibDir = QDir(ArgumentsAndSettings::buildDir() + QStringLiteral("/lib"));
-    }
+    QDir oldDir(context.oldDir);
+    QDir buildDir(context.buildDir);
 
     // it is assumed that no spaces is in the olddir prefix
 
-    QFile f(file);
-    if (f.exists() && f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        char arr[10000];
-        while (f.readLine(arr, 9999) > 0) {
-            QString l = QString::fromUtf8(arr);
-            int equalMark = l.indexOf(QLatin1Char('='));
-            if (equalMark != -1) {
-                QString key = l.left(equalMark).trimmed();
-                QString value = l.mid(equalMark + 1).trimmed();
-                if (key == QStringLiteral("QMAKE_PRL_LIBS")) {
-#if QT_VERSION < QT_VERSION_CHECK(5, 15, 0)
-                    QStringList _splitted = value.split(QStringLiteral(" "), QString::KeepEmptyParts);
-#else
-                    QStringList _splitted = value.split(QStringLiteral(" "), Qt::KeepEmptyParts);
-#endif
-
-                    QStringList splitted;
-                    QString temp;
-                    bool flag = false;
-                    foreach (const QString &_split, _splitted) {
-                        if (!flag) {
-                            if (!_split.startsWith(QLatin1Char('"')))
-                                splitted << _split;
-                            else {
-                                flag = true;
-                                temp = _split.mid(1);
-                            }
-                        } else {
-                            temp.append(QLatin1Char(' ')).append(_split);
-                            if (_split.endsWith(QLatin1Char('"'))) {
-                                flag = false;
-                                splitted << temp.left(temp.length() - 1);
-                                temp = QString();
-                            }
+    QByteArray content;
+    if (!contentCache().read(file, &content))
+        return false;
+
+    return TextLines::find(content, [&](const QByteArray &line) -> bool {
+        QByteArray key;
+        QByteArray rawValue;
+        if (TextLines::splitAssignment(line, &key, &rawValue)) {
+            if (key == "QMAKE_PRL_LIBS") {
+                foreach (const TextLines::ValueToken &token, TextLines::tokenize(rawValue)) {
+                    QString n = QString::fromUtf8(token.text);
+                    if (n.startsWith(QStringLiteral("-L="))) {
+                        if (context.isOldLibDir(TextLines::tokenPath(token, 3))) {
+                            return true;
+                        }
+                    } else if (n.startsWith(QStringLiteral("-L"))) {
+                        if (context.isOldLibDir(TextLines::tokenPath(token, 2))) {
+                            return true;
+                        }
+                    } else if (!n.startsWith(QStringLiteral("-l"))) {
+                        // Seems Qt 5.12 needs to do such patch
+                        // Qt 5.9 does not have these stuff
+                        // I have not built Qt 5.10/5.11, so I can't confirm
+                        // All of my builds of Qt 5.13 have been removed, I can't confirm either
+                        // Qt 5.14 has this problem fixed(Since QQtPatcher won't support Qt 5.14, I will not test)
+                        if ((context.majorVersion == 5 && context.minorVersion >= 10 && context.minorVersion <= 13) && context.win32) {
+                            if (findWin32KnownLib(QFileInfo(TextLines::tokenPath(token)).baseName()) != nullptr)
+                                return true;
                         }
-                    }
 
-                    foreach (const QString &m, splitted) {
-                        QString n = m;
+                        if (context.isOldLibDir(QFileInfo(TextLines::tokenPath(token)).absolutePath())) {
+                            return true;
+                        }
+                    } else if (context.majorVersion == 4 && !context.buildDir.isEmpty()) {
                         if (n.startsWith(QStringLiteral("-L="))) {
-                            if (QDir(n.mid(3).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir) {
-                                f.close();
+                            if (context.isBuildLibDir(TextLines::tokenPath(token, 3))) {
                                 return true;
                             }
                         } else if (n.startsWith(QStringLiteral("-L"))) {
-                            if (QDir(n.mid(2).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == oldLibDir) {
-                                f.close();
+                            if (context.isBuildLibDir(TextLines::tokenPath(token, 2))) {
                                 return true;
                             }
                         } else if (!n.startsWith(QStringLiteral("-l"))) {
-                            // Seems Qt 5.12 needs to do such patch
-                            // Qt 5.9 does not have these stuff
-                            // I have not built Qt 5.10/5.11, so I can't confirm
-                            // All of my builds of Qt 5.13 have been removed, I can't confirm either
-                            // Qt 5.14 has this problem fixed(Since QQtPatcher won't support Qt 5.14, I will not test)
-                            if ((ArgumentsAndSettings::qtQVersion().majorVersion() == 5 && ArgumentsAndSettings::qtQVersion().minorVersion() >= 10
-                                 && ArgumentsAndSettings::qtQVersion().minorVersion() <= 13)
-                                && ArgumentsAndSettings::crossMkspec().startsWith(QStringLiteral("win32-"))) {
-                                // clang-format off
-                                static QStringList knownLists {
-                                    // libs
-                                    QStringLiteral("d2d1"),
-                                    QStringLiteral("d3d9"),
-                                    QStringLiteral("dwrite"),
-                                    QStringLiteral("dxguid"),
-                                    QStringLiteral("advapi32"),
-                                    QStringLiteral("comdlg32"),
-                                    QStringLiteral("crypt32"),
-                                    QStringLiteral("dnsapi"),
-                                    QStringLiteral("dwmapi"),
-                                    QStringLiteral("gdi32"),
-                                    QStringLiteral("iphlpapi"),
-                                    QStringLiteral("kernel32"),
-                                    QStringLiteral("mpr"),
-                                    QStringLiteral("netapi32"),
-                                    QStringLiteral("ole32"),
-                                    QStringLiteral("oleaut32"),
-                                    QStringLiteral("setupapi"),
-                                    QStringLiteral("shell32"),
-                                    QStringLiteral("shlwapi"),
-                                    QStringLiteral("user32"),
-                                    QStringLiteral("userenv"),
-                                    QStringLiteral("uuid"),
-                                    QStringLiteral("uxtheme"),
-                                    QStringLiteral("version"),
-                                    QStringLiteral("winmm"),
-                                    QStringLiteral("winspool"),
-                                    QStringLiteral("ws2_32"),
-
-                                    // plugins
-                                    QStringLiteral("odbc32"),
-                                    QStringLiteral("strmiids"),
-                                    QStringLiteral("mf"),
-                                    QStringLiteral("mfplat"),
-                                    QStringLiteral("dxva2"),
-                                    QStringLiteral("evr"),
-                                    QStringLiteral("dmoguids"),
-                                    QStringLiteral("msdmo"),
-                                    QStringLiteral("propsys"),
-                                    QStringLiteral("imm32"),
-                                    QStringLiteral("wtsapi32"),
-                                    QStringLiteral("d3d11"),
-                                    QStringLiteral("dxgi"),
-                                    QStringLiteral("d3d12"),
-                                    QStringLiteral("d3dcompiler"),
-                                    QStringLiteral("dcomp"),
-                                };
-                                // clang-format on
-                                QString baseName = QFileInfo(QString(n).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))).baseName().toLower();
-                                foreach (const QString &known, knownLists) {
-                                    if (baseName.contains(known)) {
-                                        f.close();
-                                        return true;
-                                    }
-                                }
-                            }
-
-                            if (QDir(QFileInfo(QString(n).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))).absolutePath()) == oldLibDir) {
-                                f.close();
+                            if (context.isBuildLibDir(QFileInfo(TextLines::tokenPath(token)).absolutePath())) {
                                 return true;
                             }
-                        } else if (ArgumentsAndSettings::qtQVersion().majorVersion() == 4 && !ArgumentsAndSettings::buildDir().isEmpty()) {
-                            if (n.startsWith(QStringLiteral("-L="))) {
-                                if (QDir(n.mid(3).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == buildLibDir) {
-                                    f.close();
-                                    return true;
-                                }
-                            } else if (n.startsWith(QStringLiteral("-L"))) {
-                                if (QDir(n.mid(2).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))) == buildLibDir) {
-                                    f.close();
-                                    return true;
-                                }
-                            } else if (!n.startsWith(QStringLiteral("-l"))) {
-                                if (QDir(QFileInfo(QString(n).replace(QStringLiteral("\\\\"), QStringLiteral("\\"))).absolutePath()) == buildLibDir) {
-                                    f.close();
-                                    return true;
-                                }
-                            }
                         }
                     }
-                } else if (key == QStringLiteral("QMAKE_PRL_BUILD_DIR")) {
-                    if (ArgumentsAndSettings::qtQVersion().majorVersion() == 4) {
-                        if (!oldDir.relativeFilePath(value).contains(QStringLiteral(".."))) {
-                            f.close();
+                }
+            } else if (key == "QMAKE_PRL_BUILD_DIR") {
+                if (context.majorVersion == 4) {
+                    QString value = QString::fromUtf8(rawValue);
+                    if (!oldDir.relativeFilePath(value).contains(QStringLiteral(".."))) {
+                        return true;
+                    } else if (!context.buildDir.isEmpty()) {
+                        if (!buildDir.relativeFilePath(value).contains(QStringLiteral(".."))) {
                             return true;
-                        } else if (!ArgumentsAndSettings::buildDir().isEmpty()) {
-                            if (!buildDir.relativeFilePath(value).contains(QStringLiteral(".."))) {
-                                f.close();
-                                return true;
-                            }
-                        } else {
-                            if (!qt4NoBuildDirWarn) {
-                                qt4NoBuildDirWarn = true;
-                                QBPLOGW(QStringLiteral(
-                                    "Your build of Qt seems just built, due to bug in Qt build system, you should provide a config file which provides a build-dir."));
-                            }
+                        }
+                    } else {
+                        if (qt4NoBuildDirWarn.testAndSetRelaxed(0, 1)) {
+                            QBPLOGW(QStringLiteral(
+                                "Your build of Qt seems just built, due to bug in Qt build system, you should provide a config file which provides a build-dir."));
                         }
                     }
                 }
             }
         }
-        f.close();
-    }
-
-    return false;
-}
 
-QString PrlPatcher::win32AddPrefixSuffix(const QString &libName) const
-{
-    // win32-msvc and win32-g++ use different grammar. MSVC does not use -l
-    if (ArgumentsAndSettings::crossMkspec().contains(QStringLiteral("msvc")))
-        return libName + QStringLiteral(".lib");
-    else
-        return QStringLiteral("-l") + libName;
+        return false;
+    });
 }
 
 REGISTER_PATCHER(PrlPatcher)
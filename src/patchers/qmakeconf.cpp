@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: Unlicense
 
-#include "argument.h"
+#include "commit.h"
+#include "fileindex.h"
 #include "patch.h"
+#include "patchcontext.h"
 #include <QDir>
 
 class QMakeConfPatcher : public Patcher
@@ -12,8 +14,8 @@ public:
     Q_INVOKABLE QMakeConfPatcher();
     ~QMakeConfPatcher() override;
 
-    QStringList findFileToPatch() const override;
-    bool patchFile(const QString &file) const override;
+    QStringList findFileToPatch(const PatchContext &context) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
 };
 
 QMakeConfPatcher::QMakeConfPatcher()
@@ -24,33 +26,33 @@ QMakeConfPatcher::~QMakeConfPatcher()
 {
 }
 
-QStringList QMakeConfPatcher::findFileToPatch() const
+QStringList QMakeConfPatcher::findFileToPatch(const PatchContext &context) const
 {
     // This is a patcher only for QTBUG-27593 in Qt4
-    if (ArgumentsAndSettings::qtQVersion().majorVersion() != 4)
+    if (context.majorVersion != 4)
         return QStringList();
 
-    QDir qtDir(ArgumentsAndSettings::qtDir());
-    if (qtDir.exists(QStringLiteral("mkspecs/default/qmake.conf")))
+    if (fileIndex().exists(QStringLiteral("mkspecs/default/qmake.conf")))
         return {QStringLiteral("mkspecs/default/qmake.conf")};
 
     return QStringList();
 }
 
-bool QMakeConfPatcher::patchFile(const QString &file) const
+bool QMakeConfPatcher::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
 {
     QString str = QString(QStringLiteral("QMAKESPEC_ORIGINAL=%1/mkspecs/%2\n"
                                          "\n"
                                          "include(../%2/qmake.conf)\n"))
-                      .arg(ArgumentsAndSettings::newDir())
-                      .arg(ArgumentsAndSettings::crossMkspec());
+                      .arg(context.newDir)
+                      .arg(context.crossMkspec);
 
-    QFile f(file);
-    f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-    f.write(str.toUtf8());
+    QFile f(QDir(context.qtDir).absoluteFilePath(file));
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+    QByteArray original = f.readAll();
     f.close();
 
-    return true;
+    return commitFile(backup, file, original, str.toUtf8());
 }
 
 REGISTER_PATCHER(QMakeConfPatcher)
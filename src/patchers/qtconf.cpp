@@ -1,7 +1,9 @@
 // SPDX-License-Identifier: Unlicense
 
-#include "argument.h"
+#include "backup.h"
+#include "fileindex.h"
 #include "patch.h"
+#include "patchcontext.h"
 #include <QDir>
 
 class QtConfPatcher : public Patcher
@@ -12,8 +14,8 @@ public:
     Q_INVOKABLE QtConfPatcher();
     ~QtConfPatcher() override;
 
-    QStringList findFileToPatch() const override;
-    bool patchFile(const QString &file) const override;
+    QStringList findFileToPatch(const PatchContext &context) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
 };
 
 QtConfPatcher::QtConfPatcher()
@@ -24,23 +26,24 @@ QtConfPatcher::~QtConfPatcher()
 {
 }
 
-QStringList QtConfPatcher::findFileToPatch() const
+QStringList QtConfPatcher::findFileToPatch(const PatchContext &context) const
 {
     // remove bin/qt.conf if exists in Qt5.
-    if (ArgumentsAndSettings::qtQVersion().majorVersion() != 5)
+    if (context.majorVersion != 5)
         return QStringList();
 
-    QDir qtDir(ArgumentsAndSettings::qtDir());
-    if (qtDir.exists(QStringLiteral("bin/qt.conf")))
+    if (fileIndex().exists(QStringLiteral("bin/qt.conf")))
         return {QStringLiteral("bin/qt.conf")};
 
     return QStringList();
 }
 
-bool QtConfPatcher::patchFile(const QString &file) const
+bool QtConfPatcher::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
 {
-    QDir qtDir(ArgumentsAndSettings::qtDir());
+    QDir qtDir(context.qtDir);
     if (qtDir.exists(file)) {
+        if (!backup.backupOneFile(file))
+            return false;
         qtDir.remove(file);
         return true;
     }
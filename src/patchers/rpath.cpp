@@ -0,0 +1,194 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "backup.h"
+#include "elf.h"
+#include "fileindex.h"
+#include "log.h"
+#include "manifest.h"
+#include "patch.h"
+#include "patchcontext.h"
+#include <QDir>
+#include <QFile>
+#include <QMap>
+#include <QPair>
+#include <QSet>
+
+// Rewrites the RPATH and RUNPATH of ELF libraries, plugins and executables, which point at lib of the old dir in shared builds.
+// Entries in the old dir are made relative to $ORIGIN, so they are correct wherever the Qt dir is moved later, and are hardly ever longer than before.
+class RpathPatcher : public Patcher
+{
+    Q_OBJECT
+
+public:
+    Q_INVOKABLE RpathPatcher();
+    ~RpathPatcher() override;
+
+    QStringList findFileToPatch(const PatchContext &context) const override;
+    bool patchFile(const PatchContext &context, const QString &file, Backup &backup) const override;
+
+    QByteArray rewriteRunPath(const PatchContext &context, const QString &file, const QByteArray &value) const;
+};
+
+RpathPatcher::RpathPatcher()
+{
+}
+
+RpathPatcher::~RpathPatcher()
+{
+}
+
+QStringList RpathPatcher::findFileToPatch(const PatchContext &context) const
+{
+    // ELF is not used on Windows and macOS, and Qt for Android does not set run paths
+    if (context.win32 || context.android || context.crossMkspec.startsWith(QStringLiteral("macx")))
+        return QStringList();
+
+    // files which are not ELF files, such as scripts in bin, are skipped when patching
+    const FileIndex &qtDir = fileIndex();
+    QStringList r;
+    r << qtDir.entryList(QStringLiteral("lib"), {QStringLiteral("*.so"), QStringLiteral("*.so.*")}, FileIndex::Files | FileIndex::NoSymLinks);
+    r << qtDir.entryList(QStringLiteral("plugins"), {QStringLiteral("*.so")}, FileIndex::Files | FileIndex::NoSymLinks, true);
+    r << qtDir.entryList(QStringLiteral("qml"), {QStringLiteral("*.so")}, FileIndex::Files | FileIndex::NoSymLinks, true);
+    r << qtDir.entryList(QStringLiteral("bin"), QStringList(), FileIndex::Files | FileIndex::NoSymLinks);
+    r << qtDir.entryList(QStringLiteral("libexec"), QStringList(), FileIndex::Files | FileIndex::NoSymLinks);
+
+    return r;
+}
+
+// $ORIGIN relative form of each entry in the old dir, other entries are kept
+QByteArray RpathPatcher::rewriteRunPath(const PatchContext &context, const QString &file, const QByteArray &value) const
+{
+    QDir qtDir(context.qtDir);
+    QDir origin(QFileInfo(qtDir.absoluteFilePath(file)).absolutePath());
+    QString oldDir = QDir::cleanPath(context.oldDir);
+
+    QList<QByteArray> entries = value.split(':');
+    for (QList<QByteArray>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        QString entry = QString::fromUtf8(*it);
+        if (!entry.startsWith(QLatin1Char('/')))
+            continue;
+
+        QByteArray canonical = PatchContext::canonicalPath(entry);
+        if (canonical != context.canonicalOldDir && !canonical.startsWith(context.canonicalOldDir + '/'))
+            continue;
+
+        QString target = qtDir.absolutePath() + QDir::cleanPath(entry).mid(oldDir.length());
+        QString relative = origin.relativeFilePath(target);
+        *it = (relative.isEmpty() || relative == QStringLiteral(".")) ? QByteArray("$ORIGIN") : ("$ORIGIN/" + relative.toUtf8());
+    }
+
+    return entries.join(':');
+}
+
+bool RpathPatcher::patchFile(const PatchContext &context, const QString &file, Backup &backup) const
+{
+    QDir qtDir(context.qtDir);
+    QFile elfFile(qtDir.absoluteFilePath(file));
+    if (!elfFile.exists()) {
+        QBPLOGE(QString(QStringLiteral("file %1 is not found during patching.")).arg(elfFile.fileName()));
+        return false;
+    }
+
+    // Everything in bin and libexec is listed, including scripts and read only helpers.
+    // The file is only opened for writing when one of its run paths is really changed, so these never fail the run.
+    if (!elfFile.open(QIODevice::ReadOnly)) {
+        QBPLOGW(QString(QStringLiteral("file %1 is not readable, its run paths are left unchanged.")).arg(elfFile.fileName()));
+        return true;
+    }
+    if (elfFile.peek(4) != QByteArray("\x7f" "ELF", 4)) {
+        QBPLOGV([&]() { return QString(QStringLiteral("RpathPatcher: %1 is not an ELF file, skipped.")).arg(file); });
+        return true;
+    }
+
+    qint64 size = elfFile.size();
+    QByteArray buffer;
+    uchar *mapped = elfFile.map(0, size);
+    const char *data = reinterpret_cast<const char *>(mapped);
+    if (mapped == nullptr) {
+        buffer = elfFile.readAll();
+        data = buffer.constData();
+        size = buffer.size();
+    }
+
+    QVector<Elf::RunPath> paths;
+    bool isElf = Elf::readRunPaths(data, size, &paths);
+
+    // DT_RPATH and DT_RUNPATH may share a string
+    typedef QPair<Elf::RunPath, QByteArray> Change;
+    QSet<qint64> rewritten;
+    QList<Change> changes;
+    QMap<qint64, QByteArray> replaced;
+    foreach (const Elf::RunPath &path, paths) {
+        if (rewritten.contains(path.offset))
+            continue;
+        rewritten.insert(path.offset);
+
+        QByteArray newValue = rewriteRunPath(context, file, path.value);
+        if (newValue == path.value)
+            continue;
+
+        QByteArray replacement = Elf::rewritten(path, newValue);
+        if (replacement.isEmpty()) {
+            QBPLOGW(QString(QStringLiteral("%1 of %2 is left unchanged, %3 does not fit in the %4 bytes of the old one."))
+                        .arg(QString::fromUtf8(path.runPath ? "RUNPATH" : "RPATH"))
+                        .arg(file)
+                        .arg(QString::fromUtf8(newValue))
+                        .arg(path.value.length()));
+            continue;
+        }
+
+        changes << qMakePair(path, replacement);
+        replaced.insert(path.offset, replacement);
+        QBPLOGV([&]() {
+            return QString(QStringLiteral("RpathPatcher: %1 of %2: %3 -> %4"))
+                .arg(QString::fromUtf8(path.runPath ? "RUNPATH" : "RPATH"))
+                .arg(file)
+                .arg(QString::fromUtf8(path.value))
+                .arg(QString::fromUtf8(newValue));
+        });
+    }
+
+    // Hashed for the manifest while the content is still in memory. Only the changed files, as only the dynamic section of the others is read.
+    if (!changes.isEmpty())
+        Manifest::setContentHash(file, Manifest::hashOf(data, size, replaced));
+
+    if (mapped != nullptr)
+        elfFile.unmap(mapped);
+    elfFile.close();
+
+    if (!isElf) {
+        QBPLOGV([&]() { return QString(QStringLiteral("RpathPatcher: %1 is broken, skipped.")).arg(file); });
+        return true;
+    }
+
+    if (changes.isEmpty())
+        return true;
+
+    if (!elfFile.open(QIODevice::ReadWrite)) {
+        QBPLOGE(QString(QStringLiteral("file %1 is not writable during patching.")).arg(elfFile.fileName()));
+        return false;
+    }
+
+    // every range is journaled before the first byte of the file is written
+    foreach (const Change &change, changes) {
+        if (!backup.backupRange(file, change.first.offset, change.first.value)) {
+            elfFile.close();
+            return false;
+        }
+    }
+
+    foreach (const Change &change, changes) {
+        if (!elfFile.seek(change.first.offset) || elfFile.write(change.second) != change.second.length()) {
+            elfFile.close();
+            QBPLOGE(QString(QStringLiteral("file %1 is not writable during patching.")).arg(elfFile.fileName()));
+            return false;
+        }
+    }
+    elfFile.close();
+
+    return true;
+}
+
+REGISTER_PATCHER(RpathPatcher)
+
+#include "rpath.moc"
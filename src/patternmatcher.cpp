@@ -0,0 +1,88 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "patternmatcher.h"
+#include <QHash>
+
+#include <algorithm>
+#include <cstring>
+
+struct PatternMatcherPrivate
+{
+    QByteArray prefix;
+    bool firstBytes[256];
+    // distinct lengths of patterns, ascending
+    QVector<int> lengths;
+    QHash<QByteArray, int> lookup;
+};
+
+PatternMatcher::PatternMatcher(const QList<QByteArray> &patterns)
+    : d(new PatternMatcherPrivate)
+{
+    std::fill(d->firstBytes, d->firstBytes + 256, false);
+
+    for (int i = 0; i < patterns.length(); ++i) {
+        const QByteArray &pattern = patterns.at(i);
+        if (pattern.isEmpty() || d->lookup.contains(pattern))
+            continue;
+
+        if (d->lookup.isEmpty())
+            d->prefix = pattern;
+        else {
+            int common = 0;
+            while (common < d->prefix.length() && common < pattern.length() && d->prefix.at(common) == pattern.at(common))
+                ++common;
+            d->prefix.truncate(common);
+        }
+
+        d->lookup.insert(pattern, i);
+        d->firstBytes[static_cast<uchar>(pattern.at(0))] = true;
+        if (!d->lengths.contains(pattern.length()))
+            d->lengths << pattern.length();
+    }
+
+    std::sort(d->lengths.begin(), d->lengths.end());
+}
+
+PatternMatcher::~PatternMatcher()
+{
+    delete d;
+}
+
+QVector<PatternMatcher::Match> PatternMatcher::findAll(const char *data, qint64 size) const
+{
+    QVector<Match> r;
+    if (d->lookup.isEmpty())
+        return r;
+
+    const char *p = data;
+    const char *end = data + size;
+    while (p < end) {
+        if (!d->prefix.isEmpty()) {
+            p = static_cast<const char *>(memchr(p, d->prefix.at(0), end - p));
+            if (p == nullptr)
+                break;
+            if (end - p < d->prefix.length() || memcmp(p, d->prefix.constData(), d->prefix.length()) != 0) {
+                ++p;
+                continue;
+            }
+        } else if (!d->firstBytes[static_cast<uchar>(*p)]) {
+            ++p;
+            continue;
+        }
+
+        foreach (int length, d->lengths) {
+            if (end - p < length)
+                break;
+            QHash<QByteArray, int>::const_iterator it = d->lookup.constFind(QByteArray::fromRawData(p, length));
+            if (it != d->lookup.constEnd()) {
+                Match m;
+                m.offset = p - data;
+                m.pattern = it.value();
+                r << m;
+            }
+        }
+        ++p;
+    }
+
+    return r;
+}
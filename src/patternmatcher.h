@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPPATTERNMATCHER_H
+#define QQBPPATTERNMATCHER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QVector>
+
+struct PatternMatcherPrivate;
+
+// Finds occurrences of several byte patterns in one linear pass.
+// Candidate positions are found by searching the prefix shared by all patterns (such as "qt_") with memchr,
+// each candidate is then looked up once per distinct pattern length in a hash table.
+// So the cost of a scan does not grow with the number of patterns.
+class PatternMatcher
+{
+public:
+    struct Match
+    {
+        qint64 offset;
+        int pattern; // index in the list passed to constructor
+    };
+
+    explicit PatternMatcher(const QList<QByteArray> &patterns);
+    ~PatternMatcher();
+
+    QVector<Match> findAll(const char *data, qint64 size) const;
+
+private:
+    Q_DISABLE_COPY(PatternMatcher)
+    PatternMatcherPrivate *d;
+};
+
+Q_DECLARE_TYPEINFO(PatternMatcher::Match, Q_PRIMITIVE_TYPE);
+
+#endif
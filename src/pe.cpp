@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "pe.h"
+#include <QtEndian>
+
+namespace {
+
+// struct IMAGE_FILE_HEADER, following the "PE\0\0" signature
+const qint64 fileHeaderSize = 20;
+// struct IMAGE_SECTION_HEADER
+const qint64 sectionHeaderSize = 40;
+
+quint16 read16(const char *p)
+{
+    return qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(p));
+}
+
+quint32 read32(const char *p)
+{
+    return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(p));
+}
+
+}
+
+bool Pe::readSections(const char *data, qint64 size, QVector<Section> *sections)
+{
+    sections->clear();
+
+    // the DOS header, e_lfanew is the offset of the PE signature
+    if (size < 64 || data[0] != 'M' || data[1] != 'Z')
+        return false;
+    qint64 pe = read32(data + 0x3c);
+    if (pe > size - 4 - fileHeaderSize || data[pe] != 'P' || data[pe + 1] != 'E' || data[pe + 2] != '\0' || data[pe + 3] != '\0')
+        return false;
+
+    const char *fileHeader = data + pe + 4;
+    quint16 count = read16(fileHeader + 2);
+    quint16 optionalHeaderSize = read16(fileHeader + 16);
+    qint64 table = pe + 4 + fileHeaderSize + optionalHeaderSize;
+    if (table + count * sectionHeaderSize > size)
+        return false;
+
+    for (quint16 i = 0; i < count; ++i) {
+        const char *h = data + table + i * sectionHeaderSize;
+        // SizeOfRawData and PointerToRawData, uninitialized data has none
+        quint32 rawSize = read32(h + 16);
+        quint32 rawOffset = read32(h + 20);
+        if (rawSize == 0 || rawOffset == 0)
+            continue;
+        // the raw size is rounded up to the file alignment, which may go past the end of the last section
+        if (rawOffset > size)
+            return false;
+
+        Section s;
+        s.name = QByteArray(h, static_cast<int>(qstrnlen(h, 8)));
+        s.offset = rawOffset;
+        s.size = qMin<qint64>(rawSize, size - rawOffset);
+        *sections << s;
+    }
+
+    return true;
+}
@@ -0,0 +1,27 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPPE_H
+#define QQBPPE_H
+
+#include <QByteArray>
+#include <QVector>
+
+// Reads the section table of PE files: executables and DLLs of Windows, 32 and 64 bit.
+namespace Pe {
+
+struct Section
+{
+    // up to 8 bytes, e.g. ".rdata"
+    QByteArray name;
+    // where the content is in the file
+    qint64 offset;
+    qint64 size;
+};
+
+// The sections having content in the file, in the order of the section table.
+// Returns false if data is not a PE file, or a section is out of bounds.
+bool readSections(const char *data, qint64 size, QVector<Section> *sections);
+
+}
+
+#endif
@@ -0,0 +1,58 @@
+# SPDX-License-Identifier: Unlicense
+
+# everything but main(), shared with the benchmarks
+
+SOURCES += \
+        $$PWD/log.cpp \
+        $$PWD/argument.cpp \
+        $$PWD/archive.cpp \
+        $$PWD/backup.cpp \
+        $$PWD/batch.cpp \
+        $$PWD/commit.cpp \
+        $$PWD/contentcache.cpp \
+        $$PWD/elf.cpp \
+        $$PWD/fileindex.cpp \
+        $$PWD/macho.cpp \
+        $$PWD/manifest.cpp \
+        $$PWD/patch.cpp \
+        $$PWD/patchcontext.cpp \
+        $$PWD/pe.cpp \
+        $$PWD/patternmatcher.cpp \
+        $$PWD/qtinfo.cpp \
+        $$PWD/textlines.cpp \
+        $$PWD/trace.cpp \
+        $$PWD/verify.cpp \
+        $$PWD/patchers/binary.cpp \
+        $$PWD/patchers/cmake.cpp \
+        $$PWD/patchers/la.cpp \
+        $$PWD/patchers/pc.cpp \
+        $$PWD/patchers/pri.cpp \
+        $$PWD/patchers/prl.cpp \
+        $$PWD/patchers/qtconf.cpp \
+        $$PWD/patchers/qmakeconf.cpp \
+        $$PWD/patchers/rpath.cpp
+
+HEADERS += \
+        $$PWD/log.h \
+        $$PWD/argument.h \
+        $$PWD/archive.h \
+        $$PWD/backup.h \
+        $$PWD/batch.h \
+        $$PWD/commit.h \
+        $$PWD/contentcache.h \
+        $$PWD/elf.h \
+        $$PWD/fileindex.h \
+        $$PWD/macho.h \
+        $$PWD/manifest.h \
+        $$PWD/patch.h \
+        $$PWD/patchcontext.h \
+        $$PWD/pe.h \
+        $$PWD/patternmatcher.h \
+        $$PWD/qtinfo.h \
+        $$PWD/ruletable.h \
+        $$PWD/textlines.h \
+        $$PWD/trace.h \
+        $$PWD/verify.h \
+        $$PWD/patchers/kernels.h
+
+INCLUDEPATH += $$PWD
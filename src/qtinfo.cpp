@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "qtinfo.h"
+#include "log.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTextStream>
+
+#include <cstring>
+
+namespace {
+
+// the value of a "qt_xxxxpath=" block, which is NUL terminated
+QString embeddedPath(const QByteArray &data, const char *key)
+{
+    int keyLength = static_cast<int>(::strlen(key));
+    int pos = data.indexOf(key);
+    if (pos == -1)
+        return QString();
+
+    int begin = pos + keyLength;
+    int end = data.indexOf('\0', begin);
+    if (end == -1)
+        return QString();
+
+    return QString::fromLocal8Bit(data.constData() + begin, end - begin);
+}
+
+QString readPrefix(const QString &qmakeBinary)
+{
+    QFile f(qmakeBinary);
+    if (!f.open(QIODevice::ReadOnly))
+        return QString();
+
+    qint64 size = f.size();
+    uchar *mapped = f.map(0, size);
+    QByteArray buffer;
+    QByteArray data;
+    if (mapped != nullptr)
+        data = QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), static_cast<int>(size));
+    else {
+        buffer = f.readAll();
+        data = buffer;
+    }
+
+    // same as QT_INSTALL_PREFIX reported by qmake, the extprefix of cross builds takes precedence
+    QString r = embeddedPath(data, "qt_epfxpath=");
+    if (r.isEmpty())
+        r = embeddedPath(data, "qt_prfxpath=");
+
+    data.clear();
+    if (mapped != nullptr)
+        f.unmap(mapped);
+
+    return r;
+}
+
+// "KEY = value" in a .pri file
+QString priValue(const QString &priFile, const QString &key)
+{
+    QFile f(priFile);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+        return QString();
+
+    QTextStream ts(&f);
+    while (!ts.atEnd()) {
+        QString line = ts.readLine();
+        int eq = line.indexOf(QLatin1Char('='));
+        // "KEY += value" is not matched, as the key is followed by '+'
+        if (eq != -1 && line.left(eq).trimmed() == key)
+            return line.mid(eq + 1).trimmed();
+    }
+
+    return QString();
+}
+
+// Qt5CoreConfigExtrasMkspecDir.cmake records the target mkspec as an include dir, e.g. "${_qt5Core_install_prefix}/.//mkspecs/linux-g++"
+QString cmakeMkspec(const QDir &qtDir)
+{
+    QFile f(qtDir.absoluteFilePath(QStringLiteral("lib/cmake/Qt5Core/Qt5CoreConfigExtrasMkspecDir.cmake")));
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+        return QString();
+
+    QString content = QString::fromUtf8(f.readAll());
+    int pos = content.indexOf(QStringLiteral("mkspecs/"));
+    if (pos == -1)
+        return QString();
+
+    pos += 8;
+    int end = pos;
+    while (end < content.length() && content.at(end) != QLatin1Char('\"') && content.at(end) != QLatin1Char(')') && !content.at(end).isSpace())
+        ++end;
+
+    return content.mid(pos, end - pos);
+}
+
+// Qt4 records the mkspec in mkspecs/default, which is a symlink on Unix, or contains a qmake.conf with QMAKESPEC_ORIGINAL on Windows
+QString defaultMkspec(const QDir &qtDir)
+{
+    QFileInfo fi(qtDir.absoluteFilePath(QStringLiteral("mkspecs/default")));
+    if (fi.isSymLink())
+        return QFileInfo(fi.symLinkTarget()).fileName();
+
+    if (fi.isDir()) {
+        QString original = priValue(qtDir.absoluteFilePath(QStringLiteral("mkspecs/default/qmake.conf")), QStringLiteral("QMAKESPEC_ORIGINAL"));
+        if (!original.isEmpty())
+            return QFileInfo(original).fileName();
+    }
+
+    return QString();
+}
+
+}
+
+QtInfo detectQtInfo(const QString &qtDir_, const QString &qmakeProgram)
+{
+    QDir qtDir(qtDir_);
+    QtInfo r;
+
+    QString prefix = readPrefix(qtDir.absoluteFilePath(qmakeProgram));
+    if (!prefix.isEmpty())
+        r.installPrefix = QDir(prefix).absolutePath();
+
+    r.qtVersion = priValue(qtDir.absoluteFilePath(QStringLiteral("mkspecs/qconfig.pri")), QStringLiteral("QT_VERSION"));
+
+    r.crossMkspec = cmakeMkspec(qtDir);
+    if (r.crossMkspec.isEmpty())
+        r.crossMkspec = defaultMkspec(qtDir);
+
+    // mkspecs/qdevice.pri is only generated for cross builds, whose host mkspec is recorded nowhere but in qmake
+    if (!qtDir.exists(QStringLiteral("mkspecs/qdevice.pri")))
+        r.hostMkspec = r.crossMkspec;
+
+    QBPLOGV(QString(QStringLiteral("detectQtInfo: QT_VERSION: %1, QT_INSTALL_PREFIX: %2, QMAKE_SPEC: %3, QMAKE_XSPEC: %4"))
+                .arg(r.qtVersion)
+                .arg(r.installPrefix)
+                .arg(r.hostMkspec)
+                .arg(r.crossMkspec));
+
+    return r;
+}
@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPQTINFO_H
+#define QQBPQTINFO_H
+
+#include <QString>
+
+// the values of qmake -query which are used by patchers
+struct QtInfo
+{
+    QString qtVersion; // QT_VERSION
+    QString installPrefix; // QT_INSTALL_PREFIX
+    QString hostMkspec; // QMAKE_SPEC
+    QString crossMkspec; // QMAKE_XSPEC
+};
+
+// Reads the values from the files of the Qt build, without starting qmake:
+// the prefix embedded in the qmake binary, QT_VERSION in mkspecs/qconfig.pri, and the mkspec recorded by CMake config files or mkspecs/default.
+// Values which can't be found are left empty.
+QtInfo detectQtInfo(const QString &qtDir, const QString &qmakeProgram);
+
+#endif
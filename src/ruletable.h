@@ -0,0 +1,37 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPRULETABLE_H
+#define QQBPRULETABLE_H
+
+#include <QByteArray>
+#include <QHash>
+
+#include <cstring>
+
+// Looks up rewriting rules declared as a static array, keyed by their "key" member (a const char *).
+// The table is hashed once when constructed, usually as a function local static, so finding the rule of a line costs one hash of its key
+// regardless of the number of rules. Adding a rule is adding an entry to the array.
+template<typename Rule>
+class RuleTable
+{
+public:
+    template<int N>
+    explicit RuleTable(const Rule (&rules)[N])
+    {
+        lookup.reserve(N);
+        for (int i = 0; i < N; ++i)
+            lookup.insert(QByteArray::fromRawData(rules[i].key, static_cast<int>(::strlen(rules[i].key))), &rules[i]);
+    }
+
+    // nullptr if there is no rule for key
+    const Rule *find(const QByteArray &key) const
+    {
+        return lookup.value(key, nullptr);
+    }
+
+private:
+    Q_DISABLE_COPY(RuleTable)
+    QHash<QByteArray, const Rule *> lookup;
+};
+
+#endif
@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "textlines.h"
+
+#include <cstring>
+
+namespace {
+
+bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// Finds the line starting at pos. Returns the length of the line without the line ending, *next is the start of the next line.
+int nextLine(const char *data, int size, int pos, int *next)
+{
+    const char *nl = static_cast<const char *>(::memchr(data + pos, '\n', size - pos));
+    if (nl == nullptr) {
+        *next = size;
+        return size - pos;
+    }
+
+    int end = static_cast<int>(nl - data);
+    *next = end + 1;
+    // "\r\n", the '\r' is part of the line ending
+    if (end > pos && data[end - 1] == '\r')
+        --end;
+    return end - pos;
+}
+
+}
+
+bool TextLines::find(const QByteArray &content, const std::function<bool(const QByteArray &line)> &visitor)
+{
+    const char *data = content.constData();
+    int size = content.size();
+    int pos = 0;
+    while (pos < size) {
+        int next = 0;
+        int length = nextLine(data, size, pos, &next);
+        if (visitor(QByteArray::fromRawData(data + pos, length)))
+            return true;
+        pos = next;
+    }
+
+    return false;
+}
+
+QByteArray TextLines::rewrite(const QByteArray &content, const std::function<bool(const QByteArray &line, QByteArray *replacement)> &rewriter)
+{
+    const char *data = content.constData();
+    int size = content.size();
+    QByteArray r;
+    // start of the lines not copied to r yet
+    int copiedUntil = 0;
+    bool replaced = false;
+
+    int pos = 0;
+    while (pos < size) {
+        int next = 0;
+        int length = nextLine(data, size, pos, &next);
+        QByteArray replacement;
+        if (rewriter(QByteArray::fromRawData(data + pos, length), &replacement)) {
+            if (!replaced) {
+                r.reserve(size + replacement.size());
+                replaced = true;
+            }
+            r.append(data + copiedUntil, pos - copiedUntil);
+            r.append(replacement);
+            // line ending
+            r.append(data + pos + length, next - pos - length);
+            copiedUntil = next;
+        }
+        pos = next;
+    }
+
+    if (!replaced)
+        return content;
+
+    r.append(data + copiedUntil, size - copiedUntil);
+    return r;
+}
+
+QByteArray TextLines::trimmed(const QByteArray &view)
+{
+    const char *data = view.constData();
+    int begin = 0;
+    int end = view.size();
+    while (begin < end && isSpace(data[begin]))
+        ++begin;
+    while (end > begin && isSpace(data[end - 1]))
+        --end;
+
+    return QByteArray::fromRawData(data + begin, end - begin);
+}
+
+QByteArray TextLines::mid(const QByteArray &view, int pos, int length)
+{
+    int size = view.size();
+    if (pos >= size)
+        return QByteArray();
+    if (length < 0 || pos + length > size)
+        length = size - pos;
+
+    return QByteArray::fromRawData(view.constData() + pos, length);
+}
+
+bool TextLines::splitAssignment(const QByteArray &line, QByteArray *key, QByteArray *value)
+{
+    int equalMark = line.indexOf('=');
+    if (equalMark == -1)
+        return false;
+
+    *key = trimmed(QByteArray::fromRawData(line.constData(), equalMark));
+    *value = trimmed(mid(line, equalMark + 1));
+    return true;
+}
+
+QVector<TextLines::ValueToken> TextLines::tokenize(const QByteArray &value)
+{
+    QVector<ValueToken> r;
+    const char *data = value.constData();
+    int size = value.size();
+
+    int pos = 0;
+    while (pos < size) {
+        if (data[pos] == ' ' || data[pos] == '\t') {
+            ++pos;
+            continue;
+        }
+
+        ValueToken token;
+        token.begin = pos;
+        token.quoted = false;
+        token.escaped = false;
+        bool inQuote = false;
+        while (pos < size) {
+            char c = data[pos];
+            if (c == '\\') {
+                token.escaped = true;
+                // the escaped character never ends the token or toggles quoting
+                pos += 2;
+                continue;
+            }
+            if (c == '"')
+                inQuote = !inQuote;
+            else if (!inQuote && (c == ' ' || c == '\t'))
+                break;
+            ++pos;
+        }
+        // an escape at the very end may have stepped over the end
+        token.end = qMin(pos, size);
+        pos = token.end;
+
+        int length = token.end - token.begin;
+        if (length >= 2 && data[token.begin] == '"' && data[token.end - 1] == '"') {
+            token.quoted = true;
+            token.text = QByteArray::fromRawData(data + token.begin + 1, length - 2);
+        } else
+            token.text = QByteArray::fromRawData(data + token.begin, length);
+
+        r << token;
+    }
+
+    return r;
+}
+
+QString TextLines::tokenPath(const ValueToken &token, int pos)
+{
+    QString r = QString::fromUtf8(mid(token.text, pos));
+    if (token.escaped)
+        r.replace(QStringLiteral("\\\\"), QStringLiteral("\\"));
+    return r;
+}
+
+QByteArray TextLines::rewriteTokens(const QByteArray &value, const QVector<ValueToken> &tokens,
+                                    const std::function<bool(const ValueToken &token, QByteArray *replacement)> &rewriter)
+{
+    QByteArray r;
+    int copiedUntil = 0;
+    bool replaced = false;
+
+    foreach (const ValueToken &token, tokens) {
+        QByteArray replacement;
+        if (rewriter(token, &replacement)) {
+            if (!replaced) {
+                r.reserve(value.size() + replacement.size());
+                replaced = true;
+            }
+            r.append(value.constData() + copiedUntil, token.begin - copiedUntil);
+            r.append(replacement);
+            copiedUntil = token.end;
+        }
+    }
+
+    if (!replaced)
+        return value;
+
+    r.append(value.constData() + copiedUntil, value.size() - copiedUntil);
+    return r;
+}
+
+QByteArray TextLines::quoted(const QByteArray &text)
+{
+    foreach (char c, text) {
+        if (isSpace(c))
+            return '"' + text + '"';
+    }
+
+    return text;
+}
@@ -0,0 +1,61 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPTEXTLINES_H
+#define QQBPTEXTLINES_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+// Line-oriented access to the content of text files, shared by the text patchers.
+// Lines are passed as QByteArray::fromRawData views of the content without the line ending, so nothing is copied and there is no limit on line length.
+// The views are only valid during the callback.
+namespace TextLines {
+
+// Calls visitor for each line until it returns true. Returns whether it returned true.
+bool find(const QByteArray &content, const std::function<bool(const QByteArray &line)> &visitor);
+
+// Calls rewriter for each line. If it returns true, the line is replaced by *replacement, the original line ending is kept.
+// Other lines are kept byte for byte. If no line is replaced, content itself is returned.
+QByteArray rewrite(const QByteArray &content, const std::function<bool(const QByteArray &line, QByteArray *replacement)> &rewriter);
+
+// views, without copying
+QByteArray trimmed(const QByteArray &view);
+QByteArray mid(const QByteArray &view, int pos, int length = -1);
+
+// Splits "key = value" into trimmed views. Returns false if there is no '='.
+bool splitAssignment(const QByteArray &line, QByteArray *key, QByteArray *value);
+
+// A token of a value list in qmake (QMAKE_PRL_LIBS), libtool (dependency_libs) or pkg-config (Libs, Cflags) files.
+// Tokens are separated by spaces or tabs, double quotes group a token containing spaces, and a backslash escapes the next character.
+struct ValueToken
+{
+    // view of the token, without the quotes if the whole token is quoted
+    QByteArray text;
+    // the token as written is value.mid(begin, end - begin), quotes included
+    int begin;
+    int end;
+    bool quoted;
+    // contains a backslash, so doubled backslashes may need unescaping
+    bool escaped;
+};
+
+// Tokenizes value in a single pass. The tokens are views of value.
+QVector<ValueToken> tokenize(const QByteArray &value);
+
+// The text of token from pos as a path, with doubled backslashes unescaped
+QString tokenPath(const ValueToken &token, int pos = 0);
+
+// Rebuilds value, replacing the tokens for which rewriter returns true by *replacement. Separators and other tokens are kept byte for byte.
+// If no token is replaced, value itself is returned.
+QByteArray rewriteTokens(const QByteArray &value, const QVector<ValueToken> &tokens,
+                         const std::function<bool(const ValueToken &token, QByteArray *replacement)> &rewriter);
+
+// Encloses text in double quotes if it contains whitespace
+QByteArray quoted(const QByteArray &text);
+
+}
+
+#endif
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "trace.h"
+#include "log.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+
+namespace {
+
+struct TraceEvent
+{
+    const char *category;
+    const char *name;
+    QString file;
+    qint64 bytes;
+    qint64 begin;
+    qint64 end;
+    int tid;
+};
+
+QElapsedTimer timer;
+QString traceFile;
+// guards events and threadIds, spans end on worker threads of step4
+QMutex mutex;
+QVector<TraceEvent> events;
+// small numbers are easier to read in the viewer than thread handles, the main thread is 1
+QHash<Qt::HANDLE, int> threadIds;
+
+QJsonObject metadataEvent(const QString &name, int tid, const QString &value)
+{
+    QJsonObject ob;
+    ob.insert(QStringLiteral("name"), name);
+    ob.insert(QStringLiteral("ph"), QStringLiteral("M"));
+    ob.insert(QStringLiteral("pid"), QCoreApplication::applicationPid());
+    ob.insert(QStringLiteral("tid"), tid);
+    ob.insert(QStringLiteral("args"), QJsonObject {{QStringLiteral("name"), value}});
+    return ob;
+}
+
+void save()
+{
+    Trace::enabled.storeRelease(0);
+
+    QMutexLocker locker(&mutex);
+    qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray traceEvents;
+    traceEvents << metadataEvent(QStringLiteral("process_name"), 0, QStringLiteral("QQtPatcher"));
+    for (QHash<Qt::HANDLE, int>::const_iterator it = threadIds.constBegin(); it != threadIds.constEnd(); ++it)
+        traceEvents << metadataEvent(QStringLiteral("thread_name"), it.value(), it.value() == 1 ? QStringLiteral("main") : QString(QStringLiteral("worker %1")).arg(it.value() - 1));
+
+    foreach (const TraceEvent &e, events) {
+        QJsonObject ob;
+        ob.insert(QStringLiteral("cat"), QString::fromUtf8(e.category));
+        ob.insert(QStringLiteral("name"), QString::fromUtf8(e.name));
+        ob.insert(QStringLiteral("ph"), QStringLiteral("X"));
+        ob.insert(QStringLiteral("ts"), e.begin);
+        ob.insert(QStringLiteral("dur"), e.end - e.begin);
+        ob.insert(QStringLiteral("pid"), pid);
+        ob.insert(QStringLiteral("tid"), e.tid);
+
+        QJsonObject args;
+        if (!e.file.isEmpty())
+            args.insert(QStringLiteral("file"), e.file);
+        if (e.bytes != -1)
+            args.insert(QStringLiteral("bytes"), e.bytes);
+        if (!args.isEmpty())
+            ob.insert(QStringLiteral("args"), args);
+
+        traceEvents << ob;
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("traceEvents"), traceEvents);
+    root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+    QFile f(traceFile);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate) || f.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) == -1)
+        QBPLOGW(QString(QStringLiteral("Unable to write trace file %1")).arg(traceFile));
+    else
+        QBPLOGV(QString(QStringLiteral("%1 spans are saved to trace file %2")).arg(events.size()).arg(traceFile));
+
+    events.clear();
+    threadIds.clear();
+}
+
+}
+
+QAtomicInt Trace::enabled(0);
+
+void Trace::start(const QString &fileName)
+{
+    traceFile = fileName;
+    threadIds.insert(QThread::currentThreadId(), 1);
+    timer.start();
+    enabled.storeRelease(1);
+    qAddPostRoutine(save);
+}
+
+qint64 Trace::now()
+{
+    return timer.nsecsElapsed() / 1000;
+}
+
+void Trace::record(const char *category, const char *name, const QString &file, qint64 bytes, qint64 begin)
+{
+    qint64 end = now();
+
+    QMutexLocker locker(&mutex);
+    QHash<Qt::HANDLE, int>::const_iterator it = threadIds.constFind(QThread::currentThreadId());
+    int tid = (it != threadIds.constEnd()) ? it.value() : *threadIds.insert(QThread::currentThreadId(), threadIds.size() + 1);
+    events.append(TraceEvent {category, name, file, bytes, begin, end, tid});
+}
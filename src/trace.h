@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPTRACE_H
+#define QQBPTRACE_H
+
+#include <QAtomicInt>
+#include <QString>
+
+// Records where the time of a run goes as spans, which are saved in Chrome trace event format so they can be opened in Perfetto or chrome://tracing.
+// Nothing is recorded unless start() is called, a TraceSpan then costs one atomic load.
+namespace Trace {
+
+// Starts recording. The spans are kept in memory and saved to fileName when QCoreApplication is destroyed.
+void start(const QString &fileName);
+
+extern QAtomicInt enabled;
+inline bool isEnabled()
+{
+    return enabled.loadAcquire() != 0;
+}
+
+// microseconds since start()
+qint64 now();
+void record(const char *category, const char *name, const QString &file, qint64 bytes, qint64 begin);
+
+}
+
+// Records the time from its construction to its destruction, on the thread it is constructed on.
+// category and name must outlive the recording, string literals and class names from QMetaObject are fine.
+class TraceSpan
+{
+public:
+    TraceSpan(const char *category, const char *name, const QString &file = QString())
+        : category(category)
+        , name(name)
+        , bytes(-1)
+        , begin(-1)
+    {
+        if (Trace::isEnabled()) {
+            this->file = file;
+            begin = Trace::now();
+        }
+    }
+
+    ~TraceSpan()
+    {
+        if (begin != -1)
+            Trace::record(category, name, file, bytes, begin);
+    }
+
+    void setBytes(qint64 bytes)
+    {
+        this->bytes = bytes;
+    }
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+
+    const char *category;
+    const char *name;
+    QString file;
+    // -1 if unknown
+    qint64 bytes;
+    // -1 if not recording
+    qint64 begin;
+};
+
+#endif
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "verify.h"
+#include "fileindex.h"
+#include "patchcontext.h"
+#include "patternmatcher.h"
+#include "trace.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// '/' separated, plus native and escaped native forms for Windows
+QList<QByteArray> pathForms(const QString &path, bool win32)
+{
+    QByteArray forward = QDir::fromNativeSeparators(path).toUtf8();
+    QList<QByteArray> r {forward};
+    if (win32) {
+        QByteArray native = forward;
+        native.replace('/', '\\');
+        QByteArray escaped = native;
+        escaped.replace("\\", "\\\\");
+        r << native << escaped;
+    }
+    return r;
+}
+
+bool isFileNameChar(char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.' || c == '+';
+}
+
+struct ScanState
+{
+    QDir qtDir;
+    QList<QByteArray> needles;
+    QList<QByteArray> newForms;
+    PatternMatcher *matcher;
+
+    QMutex mutex;
+    Verify::Result result;
+};
+
+class ScanJob : public QRunnable
+{
+public:
+    ScanJob(ScanState *state, const QString &path)
+        : state(state)
+        , path(path)
+    {
+    }
+
+    void run() override
+    {
+        TraceSpan span("verify", "scan", path);
+
+        QFile f(state->qtDir.absoluteFilePath(path));
+        if (!f.open(QIODevice::ReadOnly))
+            return;
+
+        qint64 size = f.size();
+        span.setBytes(size);
+        uchar *mapped = (size > 0) ? f.map(0, size) : nullptr;
+        QByteArray buffer;
+        const char *data = reinterpret_cast<const char *>(mapped);
+        if (mapped == nullptr) {
+            buffer = f.readAll();
+            data = buffer.constData();
+            size = buffer.size();
+        }
+
+        QVector<Verify::Hit> hits;
+        foreach (const PatternMatcher::Match &m, state->matcher->findAll(data, size)) {
+            const QByteArray &needle = state->needles.at(m.pattern);
+            qint64 end = m.offset + needle.length();
+            if (end < size && isFileNameChar(data[end]))
+                continue;
+
+            bool isNewDir = false;
+            foreach (const QByteArray &n, state->newForms) {
+                if (m.offset + n.length() <= size && ::memcmp(data + m.offset, n.constData(), static_cast<size_t>(n.length())) == 0) {
+                    isNewDir = true;
+                    break;
+                }
+            }
+            if (isNewDir)
+                continue;
+
+            Verify::Hit hit;
+            hit.path = path;
+            hit.offset = m.offset;
+            hit.needle = needle;
+            hits << hit;
+        }
+
+        if (mapped != nullptr)
+            f.unmap(mapped);
+
+        QMutexLocker locker(&state->mutex);
+        ++state->result.files;
+        state->result.bytes += size;
+        state->result.hits << hits;
+    }
+
+private:
+    ScanState *state;
+    QString path;
+};
+
+}
+
+QList<QByteArray> Verify::needles(const PatchContext &context)
+{
+    return pathForms(context.oldDir, context.win32);
+}
+
+Verify::Result Verify::scan(const PatchContext &context, const QStringList &skippedDirs)
+{
+    ScanState state;
+    state.qtDir = QDir(context.qtDir);
+    state.needles = needles(context);
+    // e.g. old dir /opt/Qt and new dir /opt/Qt-relocated
+    if (context.newDir.startsWith(context.oldDir))
+        state.newForms = pathForms(context.newDir, context.win32);
+
+    QStringList roots = state.qtDir.entryList(QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+    FileIndex index;
+    index.build(context.qtDir, roots);
+
+    QStringList skipped;
+    foreach (const QString &dir, skippedDirs) {
+        QString relative = state.qtDir.relativeFilePath(QDir(dir).absolutePath());
+        if (!relative.startsWith(QStringLiteral("..")) && !QDir::isAbsolutePath(relative))
+            skipped << (relative + QLatin1Char('/'));
+    }
+
+    QList<const FileIndexEntry *> files = index.select([&skipped](const FileIndexEntry &e) {
+        if (e.type != FileIndexEntry::File || e.symLink || e.size == 0)
+            return false;
+        foreach (const QString &s, skipped) {
+            if (e.path.startsWith(s))
+                return false;
+        }
+        return true;
+    });
+    typedef QPair<qint64, QString> SizeAndPath;
+    QVector<SizeAndPath> targets;
+    foreach (const FileIndexEntry *e, files)
+        targets << qMakePair(e->size, e->path);
+
+    // files directly in the Qt dir are not below any root, e.g. a qt.conf or a license file naming the build dir
+    foreach (const QFileInfo &fi, state.qtDir.entryInfoList(QDir::Files | QDir::Hidden | QDir::NoSymLinks)) {
+        if (fi.size() > 0)
+            targets << qMakePair(fi.size(), fi.fileName());
+    }
+
+    // largest first, so that the pool does not end up waiting for a big library started last
+    std::sort(targets.begin(), targets.end(), [](const SizeAndPath &a, const SizeAndPath &b) {
+        return a.first > b.first;
+    });
+
+    PatternMatcher matcher(state.needles);
+    state.matcher = &matcher;
+
+    QThreadPool *pool = QThreadPool::globalInstance();
+    foreach (const SizeAndPath &target, targets)
+        pool->start(new ScanJob(&state, target.second));
+    pool->waitForDone();
+
+    std::sort(state.result.hits.begin(), state.result.hits.end(), [](const Hit &a, const Hit &b) {
+        return a.path < b.path || (a.path == b.path && a.offset < b.offset);
+    });
+    return state.result;
+}
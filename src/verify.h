@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: Unlicense
+
+#ifndef QQBPVERIFY_H
+#define QQBPVERIFY_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+struct PatchContext;
+
+// Checks a patched Qt dir for references to the old dir which are left behind.
+namespace Verify {
+
+struct Hit
+{
+    // relative to Qt dir, separated by '/'
+    QString path;
+    qint64 offset;
+    // the form of the old dir found, one of needles()
+    QByteArray needle;
+};
+
+struct Result
+{
+    int files;
+    qint64 bytes;
+    // sorted by path and offset
+    QVector<Hit> hits;
+
+    Result()
+        : files(0)
+        , bytes(0)
+    {
+    }
+};
+
+// The old dir as it may be written: with '/', and for Windows also with native separators and with doubled backslashes.
+QList<QByteArray> needles(const PatchContext &context);
+
+// Searches every file of the Qt dir, those directly in it included, in parallel using the global thread pool. Symlinks and the files under skippedDirs (absolute) are not searched.
+// An occurrence followed by a character of a file name, such as "/opt/Qt5" for "/opt/Qt", is not a hit, nor is one which is the start of the new dir.
+Result scan(const PatchContext &context, const QStringList &skippedDirs);
+
+}
+
+#endif
@@ -0,0 +1,19 @@
+# SPDX-License-Identifier: Unlicense
+
+QT -= gui
+QT += testlib
+
+CONFIG += c++11 console testcase
+CONFIG -= app_bundle
+TARGET = tst_macho
+
+DEFINES += QT_DEPRECATED_WARNINGS QT_DISABLE_DEPRECATED_BEFORE=0x070000 QT_NO_CAST_FROM_ASCII
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+        tst_macho.cpp \
+        ../../src/macho.cpp
+
+HEADERS += \
+        ../../src/macho.h
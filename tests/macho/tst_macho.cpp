@@ -0,0 +1,371 @@
+// SPDX-License-Identifier: Unlicense
+
+#include "macho.h"
+#include <QtEndian>
+#include <QtTest>
+
+// The fixtures are thin and fat Mach-O files built in memory: a header followed by dylib load commands and some content.
+// Install names are changed in place by MachO::renamed(), the same as BinaryPatcher does for Qt 4 on macOS.
+
+namespace {
+
+// from <mach-o/loader.h> and <mach-o/fat.h>
+const quint32 MH_MAGIC = 0xfeedface;
+const quint32 MH_MAGIC_64 = 0xfeedfacf;
+const quint32 FAT_MAGIC = 0xcafebabe;
+const quint32 MH_DYLIB = 0x6;
+const quint32 LC_LOAD_DYLIB = 0xc;
+const quint32 LC_ID_DYLIB = 0xd;
+const quint32 LC_UUID = 0x1b;
+
+const char idName[] = "/home/builder/Qt-4.8.7/lib/QtGui.framework/Versions/4/QtGui";
+const char loadName[] = "/home/builder/Qt-4.8.7/lib/QtCore.framework/Versions/4/QtCore";
+// room for each name, the terminating '\0' included
+const int capacity = 72;
+
+void append32(QByteArray *a, quint32 v, bool bigEndian)
+{
+    uchar b[4];
+    if (bigEndian)
+        qToBigEndian(v, b);
+    else
+        qToLittleEndian(v, b);
+    a->append(reinterpret_cast<const char *>(b), 4);
+}
+
+void set32(QByteArray *a, int offset, quint32 v, bool bigEndian = false)
+{
+    uchar *b = reinterpret_cast<uchar *>(a->data() + offset);
+    if (bigEndian)
+        qToBigEndian(v, b);
+    else
+        qToLittleEndian(v, b);
+}
+
+// struct dylib_command followed by the name padded with '\0'
+QByteArray dylibCommand(quint32 command, const QByteArray &name, bool bigEndian)
+{
+    QByteArray r;
+    append32(&r, command, bigEndian);
+    append32(&r, 24 + capacity, bigEndian);
+    // name.offset, timestamp, current_version, compatibility_version
+    append32(&r, 24, bigEndian);
+    append32(&r, 2, bigEndian);
+    append32(&r, 0x40800, bigEndian);
+    append32(&r, 0x40800, bigEndian);
+    r.append(name);
+    r.append(QByteArray(capacity - name.length(), '\0'));
+    return r;
+}
+
+// a command which is not a dylib command, to be skipped
+QByteArray uuidCommand(bool bigEndian)
+{
+    QByteArray r;
+    append32(&r, LC_UUID, bigEndian);
+    append32(&r, 24, bigEndian);
+    r.append(QByteArray(16, '\x5a'));
+    return r;
+}
+
+QByteArray thin(bool is64, bool bigEndian)
+{
+    QList<QByteArray> commands {dylibCommand(LC_ID_DYLIB, idName, bigEndian), uuidCommand(bigEndian), dylibCommand(LC_LOAD_DYLIB, loadName, bigEndian)};
+    QByteArray allCommands;
+    foreach (const QByteArray &c, commands)
+        allCommands.append(c);
+
+    // struct mach_header(_64)
+    QByteArray r;
+    append32(&r, is64 ? MH_MAGIC_64 : MH_MAGIC, bigEndian);
+    // cputype and cpusubtype, not checked
+    append32(&r, is64 ? 0x01000007 : 18, bigEndian);
+    append32(&r, 3, bigEndian);
+    append32(&r, MH_DYLIB, bigEndian);
+    append32(&r, commands.length(), bigEndian);
+    append32(&r, allCommands.length(), bigEndian);
+    // flags
+    append32(&r, 0x100085, bigEndian);
+    if (is64)
+        append32(&r, 0, bigEndian);
+
+    r.append(allCommands);
+    // the content, which holds the keys
+    r.append(QByteArray(256, '\xcc'));
+    return r;
+}
+
+// images aligned to 16 bytes
+QByteArray fat(const QList<QByteArray> &images)
+{
+    const int headerSize = 8 + 20 * images.length();
+    QByteArray r;
+    append32(&r, FAT_MAGIC, true);
+    append32(&r, images.length(), true);
+
+    int offset = (headerSize + 15) & ~15;
+    foreach (const QByteArray &image, images) {
+        // struct fat_arch: cputype, cpusubtype, offset, size, align
+        append32(&r, 7, true);
+        append32(&r, 3, true);
+        append32(&r, offset, true);
+        append32(&r, image.length(), true);
+        append32(&r, 4, true);
+        offset += (image.length() + 15) & ~15;
+    }
+
+    foreach (const QByteArray &image, images) {
+        r.append(QByteArray(((r.length() + 15) & ~15) - r.length(), '\0'));
+        r.append(image);
+    }
+    return r;
+}
+
+QVector<MachO::DylibCommand> read(const QByteArray &data, bool *ok)
+{
+    QVector<MachO::DylibCommand> commands;
+    *ok = MachO::readDylibCommands(data.constData(), data.length(), &commands);
+    return commands;
+}
+
+}
+
+class TestMachO : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void readThin_data();
+    void readThin();
+    void readFat();
+    void rename_data();
+    void rename();
+    void renameDoesNotFit();
+    void notMachO_data();
+    void notMachO();
+    void malformed_data();
+    void malformed();
+};
+
+void TestMachO::readThin_data()
+{
+    QTest::addColumn<bool>("is64");
+    QTest::addColumn<bool>("bigEndian");
+
+    QTest::newRow("x86") << false << false;
+    QTest::newRow("x86_64") << true << false;
+    QTest::newRow("ppc") << false << true;
+    QTest::newRow("ppc64") << true << true;
+}
+
+void TestMachO::readThin()
+{
+    QFETCH(bool, is64);
+    QFETCH(bool, bigEndian);
+
+    QByteArray data = thin(is64, bigEndian);
+    QVERIFY(MachO::isMachO(data.constData(), data.length()));
+
+    bool ok = false;
+    QVector<MachO::DylibCommand> commands = read(data, &ok);
+    QVERIFY(ok);
+    QCOMPARE(commands.length(), 2);
+
+    QCOMPARE(commands.at(0).command, LC_ID_DYLIB);
+    QVERIFY(commands.at(0).isId());
+    QCOMPARE(commands.at(0).name, QByteArray(idName));
+    QCOMPARE(commands.at(1).command, LC_LOAD_DYLIB);
+    QVERIFY(!commands.at(1).isId());
+    QCOMPARE(commands.at(1).name, QByteArray(loadName));
+
+    foreach (const MachO::DylibCommand &c, commands) {
+        QCOMPARE(c.nameCapacity, qint64(capacity));
+        QCOMPARE(data.mid(static_cast<int>(c.nameOffset), c.name.length()), c.name);
+    }
+}
+
+void TestMachO::readFat()
+{
+    QByteArray x86_64 = thin(true, false);
+    QByteArray ppc = thin(false, true);
+    QByteArray data = fat({x86_64, ppc});
+    QVERIFY(MachO::isMachO(data.constData(), data.length()));
+
+    bool ok = false;
+    QVector<MachO::DylibCommand> commands = read(data, &ok);
+    QVERIFY(ok);
+    // in file order, the commands of each architecture
+    QCOMPARE(commands.length(), 4);
+    QCOMPARE(commands.at(0).name, QByteArray(idName));
+    QCOMPARE(commands.at(1).name, QByteArray(loadName));
+    QCOMPARE(commands.at(2).name, QByteArray(idName));
+    QCOMPARE(commands.at(3).name, QByteArray(loadName));
+
+    // offsets are in the fat file, not in the architecture
+    QVERIFY(commands.at(2).nameOffset > x86_64.length());
+    foreach (const MachO::DylibCommand &c, commands)
+        QCOMPARE(data.mid(static_cast<int>(c.nameOffset), c.name.length()), c.name);
+}
+
+void TestMachO::rename_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("thin") << thin(true, false);
+    QTest::newRow("thin big endian") << thin(false, true);
+    QTest::newRow("fat") << fat({thin(true, false), thin(false, true)});
+}
+
+void TestMachO::rename()
+{
+    QFETCH(QByteArray, data);
+
+    const QByteArray newId("/opt/Qt/lib/QtGui.framework/Versions/4/QtGui");
+    const QByteArray newLoad("/opt/Qt/lib/QtCore.framework/Versions/4/QtCore");
+
+    bool ok = false;
+    QVector<MachO::DylibCommand> commands = read(data, &ok);
+    QVERIFY(ok);
+
+    QByteArray patched = data;
+    foreach (const MachO::DylibCommand &c, commands) {
+        QByteArray replacement = MachO::renamed(c, c.isId() ? newId : newLoad);
+        // padded to the whole room, so the old name does not show after the new one
+        QCOMPARE(qint64(replacement.length()), c.nameCapacity);
+        patched.replace(static_cast<int>(c.nameOffset), replacement.length(), replacement);
+    }
+    QCOMPARE(patched.length(), data.length());
+
+    QVector<MachO::DylibCommand> renamed = read(patched, &ok);
+    QVERIFY(ok);
+    QCOMPARE(renamed.length(), commands.length());
+    for (int i = 0; i < renamed.length(); ++i) {
+        QCOMPARE(renamed.at(i).name, renamed.at(i).isId() ? newId : newLoad);
+        QCOMPARE(renamed.at(i).nameOffset, commands.at(i).nameOffset);
+        QCOMPARE(renamed.at(i).nameCapacity, commands.at(i).nameCapacity);
+    }
+}
+
+void TestMachO::renameDoesNotFit()
+{
+    QByteArray data = thin(true, false);
+    bool ok = false;
+    QVector<MachO::DylibCommand> commands = read(data, &ok);
+    QVERIFY(ok);
+    const MachO::DylibCommand &c = commands.first();
+
+    // the terminating '\0' must fit as well
+    QByteArray longest(capacity - 1, 'a');
+    QByteArray replacement = MachO::renamed(c, longest);
+    QCOMPARE(replacement.length(), capacity);
+    QCOMPARE(replacement.left(capacity - 1), longest);
+    QCOMPARE(replacement.at(capacity - 1), '\0');
+
+    QVERIFY(MachO::renamed(c, QByteArray(capacity, 'a')).isEmpty());
+    QVERIFY(MachO::renamed(c, QByteArray(capacity * 2, 'a')).isEmpty());
+}
+
+void TestMachO::notMachO_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QTest::newRow("empty") << QByteArray();
+    QTest::newRow("ar archive") << (QByteArray("!<arch>\n__.SYMDEF SORTED      0           0     0     644     8         `\n") + QByteArray(8, '\0'));
+    QTest::newRow("ELF") << (QByteArray("\x7f" "ELF\x02\x01\x01", 7) + QByteArray(57, '\0'));
+    QTest::newRow("script") << QByteArray("#!/bin/sh\nexec \"$(dirname \"$0\")/qmake.real\" \"$@\"\n");
+}
+
+void TestMachO::notMachO()
+{
+    QFETCH(QByteArray, data);
+
+    QVERIFY(!MachO::isMachO(data.constData(), data.length()));
+    bool ok = true;
+    QVERIFY(read(data, &ok).isEmpty());
+    QVERIFY(!ok);
+}
+
+void TestMachO::malformed_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    // offsets in a 64 bit little endian file: ncmds at 16, sizeofcmds at 20, the first command at 32 with its size at 36 and name offset at 40
+    const QByteArray good = thin(true, false);
+    const int commandsSize = good.length() - 32 - 256;
+
+    QTest::newRow("truncated header") << good.left(20);
+    QTest::newRow("truncated load commands") << good.left(32 + commandsSize - 8);
+
+    QByteArray d = good;
+    set32(&d, 20, 0x7fffffff);
+    QTest::newRow("sizeofcmds past the end") << d;
+
+    d = good;
+    set32(&d, 16, 4);
+    QTest::newRow("more commands than sizeofcmds holds") << d;
+
+    d = good;
+    set32(&d, 36, 0);
+    QTest::newRow("command size 0") << d;
+
+    d = good;
+    set32(&d, 36, commandsSize + 8);
+    QTest::newRow("command past sizeofcmds") << d;
+
+    d = good;
+    set32(&d, 36, 16);
+    set32(&d, 20, 16);
+    set32(&d, 16, 1);
+    QTest::newRow("dylib command too small") << d;
+
+    d = good;
+    set32(&d, 40, 8);
+    QTest::newRow("name offset in the command header") << d;
+
+    d = good;
+    set32(&d, 40, 24 + capacity);
+    QTest::newRow("name offset past the command") << d;
+
+    QByteArray f = fat({thin(true, false), thin(false, true)});
+    QTest::newRow("truncated fat file") << f.left(f.length() - 100);
+
+    d = f;
+    set32(&d, 4, 0, true);
+    QTest::newRow("fat file without architectures") << d;
+
+    d = f;
+    set32(&d, 4, 3, true);
+    QTest::newRow("more architectures than the fat header holds") << d;
+
+    d = f;
+    set32(&d, 8 + 8, 0xfffffff0, true);
+    QTest::newRow("architecture offset past the end") << d;
+
+    d = f;
+    set32(&d, 8 + 12, f.length(), true);
+    QTest::newRow("architecture size past the end") << d;
+
+    d = f;
+    set32(&d, 8 + 8, 4, true);
+    QTest::newRow("architecture is not an image") << d;
+
+    // Java class files start with FAT_MAGIC too, followed by their version
+    QByteArray javaClass;
+    append32(&javaClass, FAT_MAGIC, true);
+    append32(&javaClass, 52, true);
+    javaClass.append(QByteArray(64, '\0'));
+    QTest::newRow("Java class file") << javaClass;
+}
+
+void TestMachO::malformed()
+{
+    QFETCH(QByteArray, data);
+
+    bool ok = true;
+    read(data, &ok);
+    QVERIFY(!ok);
+}
+
+QTEST_GUILESS_MAIN(TestMachO)
+
+#include "tst_macho.moc"
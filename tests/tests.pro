@@ -0,0 +1,9 @@
+# SPDX-License-Identifier: Unlicense
+
+# Unit tests of the parsers of untrusted input, run them using "make check".
+# tst_macho reads thin and fat Mach-O files built in memory, so it runs on any platform.
+
+TEMPLATE = subdirs
+
+SUBDIRS = \
+        macho